@@ -1,15 +1,457 @@
 #include "../code_1/KNNClassifier.h"
 #include "../code_1/FeatureExtractor.h"
 #include "../code_1/EmailReader.h"
+#include "../code_1/ModelSnapshot.h"
+#include "../code_1/ClassificationServer.h"
+#include "../code_1/Metrics.h"
+#include "../code_1/TrainingCondenser.h"
+#include "../code_1/CrossValidator.h"
+#include "../code_1/FeatureHasher.h"
+#include "../code_1/TfidfVectorizer.h"
 #include <iostream>
 #include <string>
 #include <algorithm>
 #include <limits>
+#include <memory>
+#include <filesystem>
+#include <csignal>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
+// Loads a model snapshot trained with N features on the current training files into the
+// classifier. Returns false if there is no such snapshot or it cannot be used.
+static bool loadSnapshot(const string& snapshotPath, uint64_t fingerprint, int N, KNNClassifier& classifier, vector<string>& topFeatures) {
+    if (!filesystem::exists(snapshotPath)) {
+        return false;
+    }
+    try {
+        ModelSnapshot snapshot(snapshotPath);
+        if (snapshot.N() != N || snapshot.sourceFingerprint() != fingerprint) {
+            return false;
+        }
+        // The training set does not depend on k, so the classifier's own k is kept.
+        topFeatures = snapshot.vocabulary();
+        classifier.trainPacked(snapshot.packedRows(), snapshot.rowCount(), snapshot.featureCount(), snapshot.labels());
+        cout << "Loaded model snapshot " << snapshotPath << " (" << snapshot.rowCount() << " training emails, " << topFeatures.size() << " features)\n";
+        return true;
+    } catch (const runtime_error& error) {
+        cout << "Ignoring model snapshot: " << error.what() << "\n";
+        return false;
+    }
+}
+
+// Trains the classifier with N top features. Unless snapshotPath is empty, a snapshot saved
+// there by an earlier run skips reading the training files and extracting their features; it
+// is keyed by N and by the training files' size and mtime. Otherwise the model is trained from
+// the CSVs and, with a snapshotPath, saved there.
+// With a reduction, the training set is deduplicated (and edited/condensed as requested) before
+// training; snapshots hold the full training set, so they are neither loaded nor saved then.
+// With a hasher, the emails are vectorized by hashing instead of against top features (pruned
+// to the balanced top N buckets if pruneHashed); snapshots hold a vocabulary, so they are
+// bypassed too and topFeatures is left empty. Without a hasher the emails are read into the
+// reader's training corpus and counted and vectorized from their token ids.
+static void trainModel(int k, int N, const string& spamFilePath, const string& hamFilePath, EmailReader& reader, FeatureExtractor& featureExtractor, ThreadPool& pool, KNNClassifier& classifier, vector<string>& topFeatures, const string& snapshotPath, const TrainingCondenser::Options* reduction = nullptr, FeatureHasher* hasher = nullptr, bool pruneHashed = true) {
+    bool useSnapshot = !snapshotPath.empty() && reduction == nullptr && hasher == nullptr;
+    uint64_t fingerprint = useSnapshot ? ModelSnapshot::fingerprintFiles({spamFilePath, hamFilePath}) : 0;
+    if (useSnapshot && loadSnapshot(snapshotPath, fingerprint, N, classifier, topFeatures)) {
+        return;
+    }
+
+    vector<bool> labels;
+
+    // Extracting top features and preparing training data for the classifier.
+    vector<vector<double>> features;
+    if (hasher != nullptr) {
+        reader.readTrainingEmails();
+        const vector<pair<pair<string, string>, bool>>& trainingData = reader.getTrainingData();
+        topFeatures.clear();
+        if (pruneHashed) {
+            hasher->pruneBalanced(trainingData, N, &pool);
+        }
+        features = hasher->extractBatch(trainingData, &pool);
+        cout << "Hashed features into " << hasher->dimensions() << " of " << hasher->buckets() << " buckets\n";
+        for (const auto& data : trainingData) {
+            labels.push_back(data.second);
+        }
+    } else {
+        reader.readTrainingCorpus();
+        const CorpusStore& corpus = reader.getTrainingCorpus();
+        topFeatures = featureExtractor.extractBalancedTopFeatures(corpus, N, &pool);
+        features = featureExtractor.extractFeaturesBatch(corpus, topFeatures, &pool);
+        labels = corpus.labels();
+    }
+
+    if (reduction != nullptr) {
+        TrainingCondenser::Result reduced = TrainingCondenser(*reduction, &pool).reduce(features, labels);
+        classifier.train(reduced.features, reduced.labels, reduced.weights);
+        cout << "Reduced " << reduced.inputRows << " training emails to " << reduced.features.size() << " prototypes ("
+             << reduced.uniqueRows << " unique, " << reduced.editedRows << " after editing, compression " << reduced.compressionRatio() << "x)\n";
+        return;
+    }
+    classifier.train(features, labels);
+    if (!useSnapshot) {
+        return;
+    }
+
+    // Save the trained model for the next start.
+    try {
+        ModelSnapshot::write(snapshotPath, k, N, topFeatures, features, labels, fingerprint);
+    } catch (const exception& error) {
+        cout << "Could not save model snapshot: " << error.what() << "\n";
+    }
+}
+
+// Trains the classifier on TF-IDF vectors of word, bigram and character n-gram features for
+// cosine-similarity search. There is no top-feature selection, so N plays no part, and no
+// snapshot is loaded or saved.
+static void trainTfidfModel(EmailReader& reader, ThreadPool& pool, KNNClassifier& classifier, TfidfVectorizer& vectorizer) {
+    reader.readTrainingEmails();
+    const vector<pair<pair<string, string>, bool>>& trainingData = reader.getTrainingData();
+
+    vectorizer.fit(trainingData, &pool);
+    vector<SparseVector> rows = vectorizer.transformBatch(trainingData, &pool);
+    vector<bool> labels;
+    size_t entries = 0;
+    for (size_t i = 0; i < trainingData.size(); ++i) {
+        labels.push_back(trainingData[i].second);
+        entries += rows[i].size();
+    }
+    classifier.trainSparse(rows, labels);
+    cout << "TF-IDF vectors over " << vectorizer.keptFeatures() << " of " << vectorizer.dimensions() << " feature ids, "
+         << (rows.empty() ? 0.0 : static_cast<double>(entries) / rows.size()) << " per email\n";
+}
+
+// Server being run, for the signal handler.
+static ClassificationServer* activeServer = nullptr;
+
+// SIGINT / SIGTERM: let the server finish the queued emails and exit.
+static void stopServer(int) {
+    if (activeServer != nullptr) {
+        activeServer->requestStop();
+    }
+}
+
+// Parses a comma-separated list of positive integers such as "1,3,5". Returns false if the
+// list is empty or malformed.
+static bool parseGrid(const string& text, vector<int>& values) {
+    values.clear();
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        char* end = nullptr;
+        long value = strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value < 1 || value > numeric_limits<int>::max()) {
+            return false;
+        }
+        values.push_back(static_cast<int>(value));
+    }
+    return !values.empty();
+}
+
+// Cross-validates every (k, N) of the grids on the training files and prints one line per
+// configuration, then the most accurate one.
+static int runTuning(const string& spamFilePath, const string& hamFilePath, int folds, const vector<int>& kGrid, const vector<int>& nGrid, KNNClassifier::Voting voting, ThreadPool& pool, ostream& out) {
+    EmailReader reader(spamFilePath, hamFilePath, "");
+    CrossValidator::Report report;
+    try {
+        reader.readTrainingEmails();
+        CrossValidator validator(reader.getTrainingData(), folds, &pool);
+        report = validator.sweep(kGrid, nGrid, voting);
+    } catch (const exception& error) {
+        cerr << error.what() << "\n";
+        return 1;
+    }
+
+    cerr << folds << "-fold cross-validation of " << reader.getTrainingData().size() << " emails; features counted, selected and vectorized in "
+         << report.preparationMilliseconds << " ms\n";
+    ios::fmtflags flags = out.flags();
+    out << left << setw(6) << "k" << setw(7) << "N" << setw(10) << "accuracy" << setw(11) << "precision" << setw(9) << "recall"
+        << setw(12) << "search ms" << "vote ms" << "\n" << fixed;
+    const CrossValidator::Result* best = nullptr;
+    for (const auto& result : report.results) {
+        out << setw(6) << result.k << setw(7) << result.N << setprecision(4) << setw(10) << result.accuracy()
+            << setw(11) << result.precision() << setw(9) << result.recall() << setprecision(2) << setw(12)
+            << result.searchMilliseconds << result.voteMilliseconds << "\n";
+        if (best == nullptr || result.accuracy() > best->accuracy()) {
+            best = &result;
+        }
+    }
+    out << "Best: k = " << best->k << ", N = " << best->N << " (accuracy " << setprecision(4) << best->accuracy() << ")\n";
+    out.flags(flags);
+    return 0;
+}
+
+// Command-line modes, for pipelines and job schedulers:
+//   run_app_1 --classify FILE [--output FILE] [--format csv|jsonl] [--no-header]
+//   run_app_1 --serve | --socket PATH [--max-batch B] [--max-delay-us D]
+//   run_app_1 --tune [--folds F] [--k-grid 1,3,5] [--n-grid 50,150]
+// common: [--spam FILE] [--ham FILE] [--k K] [--n N] [--voting majority|weighted]
+//         [--reduce dedupe|enn|cnn|enn+cnn] [--hash-bits B [--no-hash-pruning]] [--tfidf]
+//         [--threads T] [--metrics FILE|-] [--snapshot PATH]
+// --tfidf classifies by cosine similarity of TF-IDF vectors (--hash-bits then sets their
+// feature ids, 8 to 24 bits) instead of binary top-N features. --snapshot loads the model
+// from PATH when it was saved with the same N and training files, and otherwise saves it
+// there after training; without it no snapshot is read or written.
+// Reads "subject,message" CSV records (from FILE, "-" for stdin, from stdin with --serve, or
+// from each connection to the Unix socket) and writes one verdict per email in input order.
+// The input is streamed, so a batch file of any size is classified in bounded memory. Stdout
+// carries only verdicts; every other message goes to stderr. --tune prints its table on stdout
+// instead of serving.
+static int runCommandLine(int argc, char* argv[], string spamFilePath, string hamFilePath, const string& testFilePath) {
+    const string usage =
+        "Usage: run_app_1 --classify FILE [--output FILE] [--format csv|jsonl] [--no-header]\n"
+        "       run_app_1 --serve | --socket PATH [--max-batch B] [--max-delay-us D]\n"
+        "       run_app_1 --tune [--folds F] [--k-grid 1,3,5] [--n-grid 50,150]\n"
+        "  common options: [--spam FILE] [--ham FILE] [--k K] [--n N] [--voting majority|weighted]\n"
+        "                  [--reduce dedupe|enn|cnn|enn+cnn] [--hash-bits B [--no-hash-pruning]] [--tfidf]\n"
+        "                  [--threads T] [--metrics FILE|-] [--snapshot PATH]\n";
+    int k = 5;
+    int N = 150;
+    size_t threads = 0;
+    KNNClassifier::Voting voting = KNNClassifier::Majority;
+    bool reduce = false;
+    int hashBits = 0;
+    bool pruneHashed = true;
+    bool tfidf = false;
+    TrainingCondenser::Options reduction;
+    string socketPath;
+    string inputPath;
+    string outputPath;
+    string snapshotPath;
+    bool serve = false;
+    bool tune = false;
+    int folds = 5;
+    vector<int> kGrid = { 1, 3, 5, 7, 9 };
+    vector<int> nGrid = { 50, 100, 150, 200, 300 };
+    bool header = true;
+    ClassificationServer::Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (flag == "--serve") {
+            serve = true;
+        } else if (flag == "--socket" && hasValue) {
+            socketPath = argv[++i];
+            serve = true;
+        } else if (flag == "--tune") {
+            tune = true;
+        } else if (flag == "--folds" && hasValue) {
+            folds = atoi(argv[++i]);
+        } else if ((flag == "--k-grid" || flag == "--n-grid") && hasValue) {
+            if (!parseGrid(argv[++i], flag == "--k-grid" ? kGrid : nGrid)) {
+                cerr << "A grid must be a comma-separated list of positive numbers: " << argv[i] << "\n";
+                return 2;
+            }
+        } else if (flag == "--classify" && hasValue) {
+            inputPath = argv[++i];
+        } else if (flag == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else if (flag == "--snapshot" && hasValue) {
+            snapshotPath = argv[++i];
+        } else if (flag == "--format" && hasValue) {
+            string format = argv[++i];
+            if (format == "csv") {
+                options.format = ClassificationServer::Format::Csv;
+            } else if (format == "jsonl") {
+                options.format = ClassificationServer::Format::Jsonl;
+            } else {
+                cerr << "Unknown output format: " << format << "\n";
+                return 2;
+            }
+        } else if (flag == "--no-header") {
+            header = false;
+        } else if (flag == "--spam" && hasValue) {
+            spamFilePath = argv[++i];
+        } else if (flag == "--ham" && hasValue) {
+            hamFilePath = argv[++i];
+        } else if (flag == "--k" && hasValue) {
+            k = atoi(argv[++i]);
+        } else if (flag == "--n" && hasValue) {
+            N = atoi(argv[++i]);
+        } else if (flag == "--voting" && hasValue) {
+            string scheme = argv[++i];
+            if (scheme == "majority") {
+                voting = KNNClassifier::Majority;
+            } else if (scheme == "weighted") {
+                voting = KNNClassifier::DistanceWeighted;
+            } else {
+                cerr << "Unknown voting scheme: " << scheme << "\n";
+                return 2;
+            }
+        } else if (flag == "--reduce" && hasValue) {
+            string stages = argv[++i];
+            if (stages != "dedupe" && stages != "enn" && stages != "cnn" && stages != "enn+cnn") {
+                cerr << "Unknown training-set reduction: " << stages << "\n";
+                return 2;
+            }
+            reduce = true;
+            reduction.edit = stages == "enn" || stages == "enn+cnn";
+            reduction.condense = stages == "cnn" || stages == "enn+cnn";
+        } else if (flag == "--hash-bits" && hasValue) {
+            hashBits = atoi(argv[++i]);
+            if (hashBits < 1 || hashBits > 24) {
+                cerr << "--hash-bits must be between 1 and 24.\n";
+                return 2;
+            }
+        } else if (flag == "--no-hash-pruning") {
+            pruneHashed = false;
+        } else if (flag == "--tfidf") {
+            tfidf = true;
+        } else if (flag == "--threads" && hasValue) {
+            threads = static_cast<size_t>(atoi(argv[++i]));
+        } else if (flag == "--max-batch" && hasValue) {
+            options.maxBatch = static_cast<size_t>(atoi(argv[++i]));
+        } else if (flag == "--max-delay-us" && hasValue) {
+            options.maxDelay = chrono::microseconds(atoi(argv[++i]));
+        } else {
+            cerr << "Unknown or incomplete option: " << flag << "\n" << usage;
+            return 2;
+        }
+    }
+    if (serve + !inputPath.empty() + tune != 1) {
+        cerr << usage;
+        return 2;
+    }
+    if (tfidf && (reduce || tune)) {
+        cerr << "--tfidf cannot be combined with --reduce or --tune.\n";
+        return 2;
+    }
+    if (!snapshotPath.empty() && (tune || reduce || hashBits > 0 || tfidf)) {
+        cerr << "--snapshot cannot be combined with --tune, --reduce, --hash-bits or --tfidf.\n";
+        return 2;
+    }
+    if (tfidf && hashBits > 0 && hashBits < 8) {
+        cerr << "--hash-bits must be at least 8 with --tfidf.\n";
+        return 2;
+    }
+    if (tune) {
+        // The table is the only thing on stdout, as with verdicts.
+        streambuf* standardOutput = cout.rdbuf(cerr.rdbuf());
+        ostream table(standardOutput);
+        ThreadPool pool(threads);
+        int status = runTuning(spamFilePath, hamFilePath, folds, kGrid, nGrid, voting, pool, table);
+        cout.rdbuf(standardOutput);
+        return status;
+    }
+    if (k <= 0 || k % 2 == 0 || N <= 0) {
+        cerr << "k must be a positive, odd number and N a positive number.\n";
+        return 2;
+    }
+
+    // A batch file is read as fast as it can be parsed, so batches are cut by size; the
+    // dataset files start with a header record.
+    int inFd = 0;
+    int outFd = 1;
+    if (!serve) {
+        options.skipHeader = header;
+        if (inputPath != "-" && (inFd = ::open(inputPath.c_str(), O_RDONLY)) < 0) {
+            cerr << "Failed to open file: " << inputPath << "\n";
+            return 1;
+        }
+        if (!outputPath.empty() && (outFd = ::open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+            cerr << "Failed to open file: " << outputPath << "\n";
+            return 1;
+        }
+    }
+
+    // Keep stdout for verdicts: progress messages from training go to stderr.
+    streambuf* standardOutput = cout.rdbuf(cerr.rdbuf());
+
+    EmailReader reader(spamFilePath, hamFilePath, testFilePath);
+    FeatureExtractor featureExtractor;
+    ThreadPool pool(threads);
+    KNNClassifier classifier(k);
+    classifier.setVoting(voting);
+    vector<string> topFeatures;
+    unique_ptr<FeatureHasher> hasher(hashBits > 0 && !tfidf ? new FeatureHasher(hashBits) : nullptr);
+    TfidfVectorizer::Options tfidfOptions;
+    if (hashBits > 0) {
+        tfidfOptions.bits = hashBits;
+    }
+    unique_ptr<TfidfVectorizer> vectorizer(tfidf ? new TfidfVectorizer(tfidfOptions) : nullptr);
+    int status = 0;
+    try {
+        if (vectorizer) {
+            trainTfidfModel(reader, pool, classifier, *vectorizer);
+        } else {
+            trainModel(k, N, spamFilePath, hamFilePath, reader, featureExtractor, pool, classifier, topFeatures, snapshotPath, reduce ? &reduction : nullptr, hasher.get(), pruneHashed);
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << "\n";
+        status = 1;
+    }
 
-int main() {
+    unique_ptr<ClassificationServer> serverOwner(vectorizer ? new ClassificationServer(classifier, *vectorizer, &pool, options)
+                                                 : hasher ? new ClassificationServer(classifier, *hasher, &pool, options)
+                                                          : new ClassificationServer(classifier, topFeatures, &pool, options));
+    ClassificationServer& server = *serverOwner;
+    auto start = chrono::steady_clock::now();
+    if (status == 0) {
+        activeServer = &server;
+        signal(SIGPIPE, SIG_IGN);
+        // Without SA_RESTART, so a blocking call interrupted by the signal returns EINTR.
+        struct sigaction stop = {};
+        stop.sa_handler = stopServer;
+        sigemptyset(&stop.sa_mask);
+        sigaction(SIGINT, &stop, nullptr);
+        sigaction(SIGTERM, &stop, nullptr);
+        try {
+            if (socketPath.empty()) {
+                server.serveStream(inFd, outFd);
+            } else {
+                cerr << "Listening on " << socketPath << "\n";
+                server.serveSocket(socketPath);
+            }
+        } catch (const exception& error) {
+            cerr << error.what() << "\n";
+            status = 1;
+        }
+        activeServer = nullptr;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (inFd > 0) {
+        ::close(inFd);
+    }
+    if (outFd > 1 && ::close(outFd) != 0) {
+        cerr << "Failed to write file: " << outputPath << "\n";
+        status = 1;
+    }
+
+    if (status == 0) {
+        ClassificationServer::Stats stats = server.stats();
+        cerr << "Classified " << stats.emails << " emails in " << stats.batches << " batches (mean " << stats.meanBatchSize
+             << ") in " << seconds << " s, latency p50 " << stats.p50Milliseconds << " ms, p99 " << stats.p99Milliseconds
+             << " ms, max " << stats.maxMilliseconds << " ms\n";
+    }
+    cout.rdbuf(standardOutput);
+    return status;
+}
+
+// Dumps the per-stage metrics: "-" prints the table on the given stream, any other path gets
+// the JSON form. Nothing happens without a path.
+static void dumpMetrics(const string& metricsPath, ostream& table) {
+    if (metricsPath.empty()) {
+        return;
+    }
+    if (metricsPath == "-") {
+        Metrics::global().print(table);
+        return;
+    }
+    try {
+        Metrics::global().writeJsonFile(metricsPath);
+    } catch (const runtime_error& error) {
+        cerr << error.what() << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
     // File paths for training and test data.
     string spamFilePath = "../training/spam.csv";
     string hamFilePath = "../training/ham.csv";
@@ -17,19 +459,40 @@ int main() {
     int k; // Variables for KNN parameter and number of features.
     int N;
 
+    // --metrics PATH dumps the per-stage metrics when the program ends, in every mode (to
+    // stderr in the non-interactive ones, whose stdout carries verdicts). Any other
+    // command-line option selects a non-interactive mode.
+    string metricsPath;
+    vector<char*> arguments(argv, argv + argc);
+    for (size_t i = 1; i + 1 < arguments.size();) {
+        if (string(arguments[i]) == "--metrics") {
+            metricsPath = arguments[i + 1];
+            arguments.erase(arguments.begin() + i, arguments.begin() + i + 2);
+        } else {
+            ++i;
+        }
+    }
+    if (arguments.size() > 1) {
+        int status = runCommandLine(static_cast<int>(arguments.size()), arguments.data(), spamFilePath, hamFilePath, testFilePath);
+        dumpMetrics(metricsPath, cerr);
+        return status;
+    }
+
     cout << "Welcome to the Email Classifier System\n";
 
     // Initializing reader and classifier objects.
     EmailReader reader(spamFilePath, hamFilePath, testFilePath);
     KNNClassifier classifier(0);
     vector<string> topFeatures; // To store top features.
-    vector<pair<string, string>> testData; // To store test data.
+    const CorpusStore& testCorpus = reader.getTestCorpus(); // Test emails, owned by the reader.
     vector<vector<double>> testDataFeatures; // To store feature vectors for each test email.
-    vector<pair<pair<string, string>, bool>> trainingData; // To store training data.
     
     // Create an instance of FeatureExtractor
     FeatureExtractor featureExtractor;
 
+    // Worker pool shared by feature extraction and classification (one worker per hardware thread).
+    ThreadPool pool;
+
     // Initialize or reinitialize the classifier.
     auto initializeClassifier = [&]() {
         do {
@@ -72,33 +535,17 @@ int main() {
 
         // Clearing previous test data and features.
         topFeatures.clear();
-        testData.clear();
         testDataFeatures.clear();
-        reader.readTrainingEmails();
-        trainingData = reader.getTrainingData();
-
-        vector<vector<double>> features;
-        vector<bool> labels;
 
-        // Extracting top features and preparing training data for the classifier.
-        topFeatures = featureExtractor.extractBalancedTopFeatures(trainingData, N);
-        for (const auto& data : trainingData) {
-            features.push_back(featureExtractor.extractFeatures(data.first.first, data.first.second, topFeatures));
-            labels.push_back(data.second);
-        }
-          
-        classifier.train(features, labels);
-        reader.readTestEmails();
-        testData = reader.getTestData();
+        trainModel(k, N, spamFilePath, hamFilePath, reader, featureExtractor, pool, classifier, topFeatures, "knn_model_N" + to_string(N) + ".bin");
+        reader.readTestCorpus();
     };
 
     // Initialize the classifier with user inputs.
     initializeClassifier();
 
     // Extracting features from each test email.
-    for (const auto& email : testData) {
-        testDataFeatures.push_back(featureExtractor.extractFeatures(email.first, email.second, topFeatures));
-    }
+    testDataFeatures = featureExtractor.extractFeaturesBatch(testCorpus, topFeatures, &pool);
 
     int choice = 0;
     // Interactive menu to use the classifier.
@@ -131,22 +578,27 @@ int main() {
         switch (choice) {
             case 1: { // Classify each test email and output results.
                 cout << "Classifying...\n";
-                for (int i = 0; i < testDataFeatures.size(); ++i) {
-                    bool isSpam = classifier.predict(testDataFeatures[i]);
-                    cout << "Subject: " << testData[i].first << "\n";
-                    cout << "Classification: " << (isSpam ? "Spam" : "Ham") << endl;
+                // One blocked scan of the training set classifies every test email.
+                vector<Prediction> predictions = classifier.predictBatch(testDataFeatures, &pool);
+                // Feature column of every test token id, for the explanations.
+                Vocabulary vocabulary(topFeatures);
+                vector<int> columns = FeatureExtractor::featureColumns(testCorpus, vocabulary);
+                for (size_t i = 0; i < predictions.size(); ++i) {
+                    const Prediction& prediction = predictions[i];
+                    cout << "Subject: " << testCorpus.subject(i) << "\n";
+                    cout << "Classification: " << (prediction.isSpam ? "Spam" : "Ham") << endl;
                     
-                    // Prints the nearest neighbors with their calculated distance.
+                    // Prints the nearest neighbors with their calculated distance, farthest first.
                     cout << "Neighbors: " << "\n";
-                    classifier.predictAnalyze(testDataFeatures[i]);
+                    for (int n = static_cast<int>(prediction.neighborIndices.size()) - 1; n >= 0; --n) {
+                        int index = prediction.neighborIndices[n];
+                        cout << "Neighbor index: " << index << ", Distance: " << prediction.neighborDistances[n] << ", Label (Spam=1/Ham=0): " << classifier.getTrainingLabels()[index] << endl;
+                    }
 
                     // Outputting words that led to the classification.
                     cout << "Words that lead to its classification:\n";
-                    const vector<double>& emailFeatures = testDataFeatures[i];
-                    for (int j = 0; j < emailFeatures.size(); ++j) {
-                        if (emailFeatures[j] > 0) {
-                            cout << topFeatures[j] << ", ";
-                        }
+                    for (int j : FeatureExtractor::presentFeatures(testCorpus, i, columns, vocabulary)) {
+                        cout << topFeatures[j] << ", ";
                     }
                     cout << "\n" << endl;
                 }
@@ -155,8 +607,8 @@ int main() {
             case 2: { // Summarize the overall classification results.
                 cout << "Summarizing classifications...\n";
                 int spamCount = 0, hamCount = 0;
-                for (const auto& emailFeatures : testDataFeatures) {
-                    if (classifier.predict(emailFeatures)) {
+                for (const auto& prediction : classifier.predictBatch(testDataFeatures, &pool)) {
+                    if (prediction.isSpam) {
                         ++spamCount;
                     } else {
                         ++hamCount;
@@ -176,9 +628,7 @@ int main() {
             }
             case 4: { // Allow the user to change initial parameters.
                 initializeClassifier();
-                for (const auto& email : testData) {
-                    testDataFeatures.push_back(featureExtractor.extractFeatures(email.first, email.second, topFeatures));
-                }
+                testDataFeatures = featureExtractor.extractFeaturesBatch(testCorpus, topFeatures, &pool);
                 break;
             }
             case 5: // Exit the program.
@@ -189,5 +639,6 @@ int main() {
         }
     } while (choice != 5);
 
+    dumpMetrics(metricsPath, cout);
     return 0;
 }
@@ -0,0 +1,324 @@
+#include "../code_1/KNNClassifier.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/FeatureHasher.h"
+#include "../code_1/EmailReader.h"
+#include "../code_1/Tokenizer.h"
+#include "../code_1/Vocabulary.h"
+#include "../code_1/SyntheticCorpus.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Hot-path benchmarks: EmailReader parsing, tokenizing, FeatureExtractor and KNNClassifier
+// prediction over synthetic corpora of growing size.
+// Usage: run_benchmarks [--max-emails=E] [--max-features=N] [--max-cells=C] [benchmark flags]
+// Corpora go from 10^3 emails up to E (default 10^5) and feature counts from 10 up to N
+// (default 10^4), by factors of 10. Benchmarks that hold an emails x features matrix are only
+// run while emails * N <= C (default 10^7 cells), which keeps the largest one near 80 MB.
+// Every benchmark reports emails/s (items_per_second), bytes/s where input text is read, and
+// heap allocations per email (allocs_per_email).
+
+// Heap allocations made by this process, counted by the replaced global operator new.
+static atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* block = malloc(size == 0 ? 1 : size)) {
+        return block;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+namespace {
+
+// Sizes of the benchmark grid, set from the command line.
+size_t maxEmails = 100000;
+size_t maxFeatures = 10000;
+size_t maxCells = 10000000;
+
+// Synthetic mail with the generator's default shape and a seed per corpus size.
+class Corpus {
+public:
+    vector<pair<pair<string, string>, bool>> emails;
+    size_t bytes;
+
+    explicit Corpus(size_t count) : bytes(0) {
+        SyntheticCorpus::Options options;
+        options.seed = 12345 + count;
+        emails = SyntheticCorpus(options).generate(count);
+        for (const auto& email : emails) {
+            bytes += email.first.first.size() + email.first.second.size() + 2;
+        }
+    }
+
+    // Writes the spam and ham emails as dataset CSV files.
+    void writeFiles(const string& spamPath, const string& hamPath) const {
+        ofstream spamFile(spamPath, ios::binary);
+        ofstream hamFile(hamPath, ios::binary);
+        spamFile << SyntheticCorpus::header() << '\n';
+        hamFile << SyntheticCorpus::header() << '\n';
+        for (const auto& email : emails) {
+            SyntheticCorpus::writeRecord(email.second ? spamFile : hamFile, SyntheticCorpus::Email{email.first.first, email.first.second, email.second});
+        }
+    }
+};
+
+// Corpora are generated once per size and shared by the benchmarks.
+const Corpus& corpus(size_t count) {
+    static map<size_t, unique_ptr<Corpus>> corpora;
+    unique_ptr<Corpus>& entry = corpora[count];
+    if (!entry) {
+        entry.reset(new Corpus(count));
+    }
+    return *entry;
+}
+
+// Balanced top features of a corpus, also cached.
+const vector<string>& topFeatures(size_t count, size_t N) {
+    static map<pair<size_t, size_t>, vector<string>> features;
+    auto key = make_pair(count, N);
+    auto entry = features.find(key);
+    if (entry == features.end()) {
+        FeatureExtractor extractor;
+        entry = features.emplace(key, extractor.extractBalancedTopFeatures(corpus(count).emails, static_cast<int>(N))).first;
+    }
+    return entry->second;
+}
+
+// Sets the throughput counters shared by all benchmarks.
+void reportPerEmail(benchmark::State& state, size_t emails, size_t bytes, size_t allocations) {
+    size_t processed = static_cast<size_t>(state.iterations()) * emails;
+    state.SetItemsProcessed(static_cast<int64_t>(processed));
+    if (bytes > 0) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    }
+    state.counters["allocs_per_email"] = processed > 0 ? static_cast<double>(allocations) / processed : 0.0;
+}
+
+// EmailReader: parse the training CSVs into owned strings, or map them and keep views.
+void readTrainingEmails(benchmark::State& state, size_t count, bool mapped) {
+    const Corpus& data = corpus(count);
+    filesystem::path directory = filesystem::temp_directory_path();
+    string spamPath = (directory / ("knn_bench_spam_" + to_string(count) + ".csv")).string();
+    string hamPath = (directory / ("knn_bench_ham_" + to_string(count) + ".csv")).string();
+    data.writeFiles(spamPath, hamPath);
+    size_t bytes = filesystem::file_size(spamPath) + filesystem::file_size(hamPath);
+
+    // The reader reports every file it reads on cout; keep that out of the results.
+    ofstream discard;
+    streambuf* standardOutput = cout.rdbuf(discard.rdbuf());
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        EmailReader reader(spamPath, hamPath, spamPath);
+        if (mapped) {
+            reader.mapTrainingEmails();
+            benchmark::DoNotOptimize(reader.getTrainingViews().data());
+        } else {
+            reader.readTrainingEmails();
+            benchmark::DoNotOptimize(reader.getTrainingData().data());
+        }
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    cout.rdbuf(standardOutput);
+    reportPerEmail(state, count, bytes, allocations);
+    filesystem::remove(spamPath);
+    filesystem::remove(hamPath);
+}
+
+// Tokenizer: the streaming scan of the hot path, or token strings as tokenizeEmail returns them.
+void tokenize(benchmark::State& state, size_t count, bool allocateTokens) {
+    const Corpus& data = corpus(count);
+    Tokenizer tokenizer;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        uint64_t checksum = 0;
+        for (const auto& email : data.emails) {
+            if (allocateTokens) {
+                checksum += tokenizer.tokenize(email.first.first).size() + tokenizer.tokenize(email.first.second).size();
+            } else {
+                tokenizer.scan(email.first.first, [&](string_view, uint64_t hash) { checksum += hash; });
+                tokenizer.scan(email.first.second, [&](string_view, uint64_t hash) { checksum += hash; });
+            }
+        }
+        benchmark::DoNotOptimize(checksum);
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, count, data.bytes, allocations);
+}
+
+// FeatureExtractor::extractFeatures against a prebuilt vocabulary of N features.
+void extractFeatures(benchmark::State& state, size_t count, size_t N) {
+    const Corpus& data = corpus(count);
+    Vocabulary vocabulary(topFeatures(count, N));
+    FeatureExtractor extractor;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        for (const auto& email : data.emails) {
+            vector<double> features = extractor.extractFeatures(email.first.first, email.first.second, vocabulary);
+            benchmark::DoNotOptimize(features.data());
+        }
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, count, data.bytes, allocations);
+}
+
+// Bits of the hashed feature space compared with the vocabulary path.
+const int hashBits = 18;
+
+// FeatureHasher::extract into one reused buffer, pruned to N buckets like the vocabulary.
+void hashFeatures(benchmark::State& state, size_t count, size_t N) {
+    const Corpus& data = corpus(count);
+    FeatureHasher hasher(hashBits);
+    hasher.pruneBalanced(data.emails, static_cast<int>(N));
+    vector<double> features(hasher.dimensions());
+    Tokenizer tokenizer;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        for (const auto& email : data.emails) {
+            hasher.extract(email.first.first, email.first.second, tokenizer, features.data());
+            benchmark::DoNotOptimize(features.data());
+        }
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, count, data.bytes, allocations);
+}
+
+// FeatureHasher::pruneBalanced on the whole corpus (the hashed counterpart of feature selection).
+void pruneHashedFeatures(benchmark::State& state, size_t count, size_t N) {
+    const Corpus& data = corpus(count);
+    FeatureHasher hasher(hashBits);
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        hasher.pruneBalanced(data.emails, static_cast<int>(N));
+        benchmark::DoNotOptimize(hasher.dimensions());
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, count, data.bytes, allocations);
+}
+
+// FeatureExtractor::extractBalancedTopFeatures on the whole corpus.
+void extractBalancedTopFeatures(benchmark::State& state, size_t count, size_t N) {
+    const Corpus& data = corpus(count);
+    FeatureExtractor extractor;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        vector<string> features = extractor.extractBalancedTopFeatures(data.emails, static_cast<int>(N));
+        benchmark::DoNotOptimize(features.data());
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, count, data.bytes, allocations);
+}
+
+// KNNClassifier::predict (one query at a time) or predictBatch against count training emails
+// with N features. Items are queries; training happens outside the timed loop.
+void predict(benchmark::State& state, size_t count, size_t N, bool batch) {
+    const Corpus& data = corpus(count);
+    const vector<string>& features = topFeatures(count, N);
+    FeatureExtractor extractor;
+    vector<vector<double>> training = extractor.extractFeaturesBatch(data.emails, features);
+    vector<bool> labels;
+    for (const auto& email : data.emails) {
+        labels.push_back(email.second);
+    }
+    KNNClassifier classifier(5);
+    classifier.train(training, labels);
+    training.clear();
+    training.shrink_to_fit();
+
+    // Queries come from a differently seeded corpus of the same distribution.
+    const size_t queryCount = 64;
+    vector<vector<double>> queries = extractor.extractFeaturesBatch(corpus(queryCount).emails, features);
+
+    size_t allocations = 0;
+    for (auto _ : state) {
+        size_t before = allocationCount.load(memory_order_relaxed);
+        if (batch) {
+            vector<Prediction> predictions = classifier.predictBatch(queries);
+            benchmark::DoNotOptimize(predictions.data());
+        } else {
+            for (const auto& query : queries) {
+                benchmark::DoNotOptimize(classifier.predict(query));
+            }
+        }
+        allocations += allocationCount.load(memory_order_relaxed) - before;
+    }
+    reportPerEmail(state, queryCount, 0, allocations);
+    state.counters["training_emails"] = static_cast<double>(count);
+}
+
+// Registers every benchmark over the size grid.
+void registerBenchmarks() {
+    for (size_t count = 1000; count <= maxEmails; count *= 10) {
+        string emails = "/emails:" + to_string(count);
+        benchmark::RegisterBenchmark(("EmailReader/readTrainingEmails" + emails).c_str(), readTrainingEmails, count, false)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("EmailReader/mapTrainingEmails" + emails).c_str(), readTrainingEmails, count, true)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("Tokenizer/scan" + emails).c_str(), tokenize, count, false)->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("Tokenizer/tokenize" + emails).c_str(), tokenize, count, true)->Unit(benchmark::kMillisecond);
+        for (size_t N = 10; N <= maxFeatures; N *= 10) {
+            string grid = emails + "/N:" + to_string(N);
+            benchmark::RegisterBenchmark(("FeatureExtractor/extractBalancedTopFeatures" + grid).c_str(), extractBalancedTopFeatures, count, N)->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("FeatureExtractor/extractFeatures" + grid).c_str(), extractFeatures, count, N)->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("FeatureHasher/pruneBalanced" + grid).c_str(), pruneHashedFeatures, count, N)->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("FeatureHasher/extract" + grid).c_str(), hashFeatures, count, N)->Unit(benchmark::kMillisecond);
+            if (count * N <= maxCells) {
+                benchmark::RegisterBenchmark(("KNNClassifier/predict" + grid).c_str(), predict, count, N, false)->Unit(benchmark::kMicrosecond);
+                benchmark::RegisterBenchmark(("KNNClassifier/predictBatch" + grid).c_str(), predict, count, N, true)->Unit(benchmark::kMicrosecond);
+            }
+        }
+    }
+}
+
+// Reads "--name=value" as a size.
+bool parseSize(const char* argument, const char* name, size_t& value) {
+    size_t length = strlen(name);
+    if (strncmp(argument, name, length) != 0 || argument[length] != '=') {
+        return false;
+    }
+    value = static_cast<size_t>(strtod(argument + length + 1, nullptr));
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+    int remaining = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!parseSize(argv[i], "--max-emails", maxEmails) && !parseSize(argv[i], "--max-features", maxFeatures) && !parseSize(argv[i], "--max-cells", maxCells)) {
+            argv[remaining++] = argv[i];
+        }
+    }
+    if (benchmark::ReportUnrecognizedArguments(remaining, argv)) {
+        return 1;
+    }
+    registerBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
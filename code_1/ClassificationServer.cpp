@@ -0,0 +1,462 @@
+#include "ClassificationServer.h"
+#include "CsvParser.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const size_t ClassificationServer::latencyWindow;
+
+// Constructor: A connection starts with nothing outstanding.
+ClassificationServer::Connection::Connection(int inFd, int outFd, bool ownsDescriptors, bool isSocket)
+    : inFd(inFd), outFd(outFd), ownsDescriptors(ownsDescriptors), isSocket(isSocket), nextSequence(1), outstanding(0), inputDone(false) {}
+
+// Closes the descriptors of a socket connection once nothing refers to it any more.
+ClassificationServer::Connection::~Connection() {
+    if (ownsDescriptors) {
+        ::close(inFd);
+    }
+}
+
+// Constructor: Builds the vocabulary lookup once for every batch. The stop pipe never blocks,
+// so requestStop cannot stall a signal handler.
+ClassificationServer::ClassificationServer(const KNNClassifier& classifier, const vector<string>& topFeatures, ThreadPool* pool, const Options& options)
+    : classifier_(classifier), vocabulary_(topFeatures), pool_(pool), options_(options), activeReaders_(0), inputOpen_(false),
+      stopRequested_(false), emails_(0), batches_(0), maxLatency_(0), latencyCursor_(0) {
+    options_.maxBatch = max<size_t>(1, options_.maxBatch);
+    options_.maxQueued = max(options_.maxQueued, options_.maxBatch);
+    if (::pipe2(stopPipe_, O_CLOEXEC | O_NONBLOCK) != 0) {
+        throw runtime_error("Failed to create the server's stop pipe");
+    }
+}
+
+// Constructor: Vectorizes with the hasher instead of a vocabulary.
+ClassificationServer::ClassificationServer(const KNNClassifier& classifier, const FeatureHasher& hasher, ThreadPool* pool, const Options& options)
+    : ClassificationServer(classifier, vector<string>(), pool, options) {
+    hasher_.reset(new FeatureHasher(hasher));
+}
+
+// Constructor: Vectorizes with the TF-IDF vectorizer and classifies by cosine similarity.
+ClassificationServer::ClassificationServer(const KNNClassifier& classifier, const TfidfVectorizer& vectorizer, ThreadPool* pool, const Options& options)
+    : ClassificationServer(classifier, vector<string>(), pool, options) {
+    vectorizer_.reset(new TfidfVectorizer(vectorizer));
+}
+
+// Closes the stop pipe.
+ClassificationServer::~ClassificationServer() {
+    ::close(stopPipe_[0]);
+    ::close(stopPipe_[1]);
+}
+
+// One connection on the calling thread's descriptors, one batcher thread.
+void ClassificationServer::serveStream(int inFd, int outFd) {
+    {
+        lock_guard<mutex> guard(lock_);
+        inputOpen_ = true;
+        activeReaders_ = 1;
+    }
+    thread batcher(&ClassificationServer::batchLoop, this);
+
+    serveConnection(make_shared<Connection>(inFd, outFd, false, false));
+
+    {
+        lock_guard<mutex> guard(lock_);
+        inputOpen_ = false;
+    }
+    queued_.notify_all();
+    batcher.join();
+}
+
+// Accept loop: polls the listener together with the stop pipe, so a stop request is noticed
+// at once.
+void ClassificationServer::serveSocket(const string& path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Socket path is too long: " + path);
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw runtime_error("Failed to create socket: " + path);
+    }
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0) {
+        ::close(listener);
+        throw runtime_error("Failed to listen on socket: " + path);
+    }
+
+    {
+        lock_guard<mutex> guard(lock_);
+        inputOpen_ = true;
+    }
+    thread batcher(&ClassificationServer::batchLoop, this);
+    vector<thread> readers;
+
+    while (!stopRequested_.load()) {
+        pollfd waiting[2] = { {listener, POLLIN, 0}, {stopPipe_[0], POLLIN, 0} };
+        if (poll(waiting, 2, -1) <= 0 || waiting[1].revents != 0 || waiting[0].revents == 0) {
+            continue;
+        }
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        shared_ptr<Connection> connection = make_shared<Connection>(client, client, true, true);
+        {
+            lock_guard<mutex> guard(lock_);
+            ++activeReaders_;
+            connections_.erase(remove_if(connections_.begin(), connections_.end(), [](const weak_ptr<Connection>& c) { return c.expired(); }), connections_.end());
+            connections_.push_back(connection);
+        }
+        readers.emplace_back(&ClassificationServer::serveConnection, this, connection);
+    }
+
+    // Stop reading new records; emails already queued are still answered.
+    ::close(listener);
+    ::unlink(path.c_str());
+    {
+        lock_guard<mutex> guard(lock_);
+        for (const auto& weak : connections_) {
+            if (shared_ptr<Connection> connection = weak.lock()) {
+                ::shutdown(connection->inFd, SHUT_RD);
+            }
+        }
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    {
+        lock_guard<mutex> guard(lock_);
+        inputOpen_ = false;
+    }
+    queued_.notify_all();
+    batcher.join();
+}
+
+// Sets the stop flag and wakes every poll on the stop pipe. The pipe is never drained, so it
+// stays readable for readers that poll it later.
+void ClassificationServer::requestStop() {
+    stopRequested_.store(true);
+    char wake = 1;
+    ssize_t written = ::write(stopPipe_[1], &wake, 1);
+    (void)written;
+}
+
+// Percentiles over the latency ring.
+ClassificationServer::Stats ClassificationServer::stats() const {
+    lock_guard<mutex> guard(lock_);
+    Stats result;
+    result.emails = emails_;
+    result.batches = batches_;
+    result.meanBatchSize = batches_ > 0 ? static_cast<double>(emails_) / batches_ : 0.0;
+    result.maxMilliseconds = maxLatency_;
+    result.p50Milliseconds = 0.0;
+    result.p99Milliseconds = 0.0;
+    if (!latencies_.empty()) {
+        vector<double> sorted(latencies_);
+        auto percentile = [&](double p) {
+            size_t rank = min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+            nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+            return sorted[rank];
+        };
+        result.p50Milliseconds = percentile(0.50);
+        result.p99Milliseconds = percentile(0.99);
+    }
+    return result;
+}
+
+// The writer runs alongside the reader so that verdicts flow back while the client is still
+// sending.
+void ClassificationServer::serveConnection(shared_ptr<Connection> connection) {
+    thread writer(&ClassificationServer::writeConnection, this, connection);
+    readConnection(connection);
+    {
+        lock_guard<mutex> guard(connection->outputLock);
+        connection->inputDone = true;
+    }
+    connection->outputReady.notify_one();
+    writer.join();
+    if (connection->isSocket) {
+        ::shutdown(connection->outFd, SHUT_WR);
+    }
+}
+
+// Parses records as they arrive; each one is copied into a request because the parser's views
+// only live until the next chunk. The input is polled together with the stop pipe, so a stop
+// request ends a stream that is still open (stdin, a FIFO) instead of waiting on its writer.
+void ClassificationServer::readConnection(shared_ptr<Connection> connection) {
+    CsvParser parser;
+    bool header = options_.skipHeader;
+    auto enqueue = [&](const vector<string_view>& fields) {
+        if (header) {
+            header = false;
+            return;
+        }
+        Request request;
+        request.connection = connection;
+        request.sequence = connection->nextSequence++;
+        request.valid = fields.size() >= 2;
+        if (request.valid) {
+            request.subject.assign(fields[0].data(), fields[0].size());
+            request.message.assign(fields[1].data(), fields[1].size());
+            // Unquoted commas in the message split it into extra fields; join them back.
+            for (size_t f = 2; f < fields.size(); ++f) {
+                request.message += ',';
+                request.message.append(fields[f].data(), fields[f].size());
+            }
+        }
+        request.arrival = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> guard(connection->outputLock);
+            ++connection->outstanding;
+        }
+
+        unique_lock<mutex> guard(lock_);
+        drained_.wait(guard, [&] { return queue_.size() < options_.maxQueued; });
+        queue_.push_back(move(request));
+        guard.unlock();
+        queued_.notify_one();
+    };
+
+    vector<char> chunk(64 * 1024);
+    while (!stopRequested_.load()) {
+        pollfd waiting[2] = { {connection->inFd, POLLIN, 0}, {stopPipe_[0], POLLIN, 0} };
+        if (poll(waiting, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (waiting[1].revents != 0) {
+            break;
+        }
+        ssize_t count = ::read(connection->inFd, chunk.data(), chunk.size());
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        parser.feed(string_view(chunk.data(), static_cast<size_t>(count)), enqueue);
+    }
+    try {
+        parser.finish(enqueue);
+    } catch (const runtime_error& error) {
+        cerr << "Dropped incomplete record: " << error.what() << endl;
+    }
+
+    {
+        lock_guard<mutex> guard(lock_);
+        --activeReaders_;
+    }
+    queued_.notify_all();
+}
+
+// Swaps the pending verdicts out and writes them without holding the lock, so the batcher can
+// keep appending. Once the client has gone away the remaining verdicts are discarded.
+void ClassificationServer::writeConnection(shared_ptr<Connection> connection) {
+    bool connected = true;
+    string text;
+    unique_lock<mutex> guard(connection->outputLock);
+    while (true) {
+        connection->outputReady.wait(guard, [&] {
+            return !connection->pending.empty() || (connection->inputDone && connection->outstanding == 0);
+        });
+        if (connection->pending.empty()) {
+            return;
+        }
+        text.clear();
+        text.swap(connection->pending);
+        guard.unlock();
+        connected = connected && writeAll(*connection, text);
+        guard.lock();
+    }
+}
+
+// Waits for the first email of a batch, then for the batch to fill or the oldest email's
+// deadline to pass, whichever comes first.
+void ClassificationServer::batchLoop() {
+    vector<Request> batch;
+    while (true) {
+        unique_lock<mutex> guard(lock_);
+        auto inputDone = [&] { return !inputOpen_ && activeReaders_ == 0; };
+        queued_.wait(guard, [&] { return !queue_.empty() || inputDone(); });
+        if (queue_.empty()) {
+            return;
+        }
+        auto deadline = queue_.front().arrival + options_.maxDelay;
+        queued_.wait_until(guard, deadline, [&] { return queue_.size() >= options_.maxBatch || inputDone(); });
+
+        size_t count = min(options_.maxBatch, queue_.size());
+        batch.clear();
+        for (size_t i = 0; i < count; ++i) {
+            batch.push_back(move(queue_.front()));
+            queue_.pop_front();
+        }
+        guard.unlock();
+        drained_.notify_all();
+
+        processBatch(batch);
+    }
+}
+
+// Only classifying is guarded: answering must run exactly once per batch, since each verdict
+// settles one outstanding email of its connection.
+void ClassificationServer::processBatch(vector<Request>& batch) {
+    KNN_TIMED_SCOPE("server.batch");
+    vector<Prediction> predictions;
+    bool classified = false;
+    try {
+        predictions = classifyBatch(batch);
+        classified = true;
+    } catch (const exception& error) {
+        cerr << "Failed to classify a batch of " << batch.size() << " emails: " << error.what() << endl;
+    }
+    answerBatch(batch, classified ? &predictions : nullptr);
+}
+
+// Both paths vectorize on the pool with per-chunk working memory, then classify in one batch.
+vector<Prediction> ClassificationServer::classifyBatch(const vector<Request>& batch) const {
+    vector<Prediction> predictions;
+    if (vectorizer_) {
+        vector<SparseVector> vectors(batch.size());
+        auto transformRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                vectors[i] = vectorizer_->transform(batch[i].subject, batch[i].message);
+            }
+        };
+        if (pool_ != nullptr) {
+            pool_->parallelFor(batch.size(), 16, transformRange);
+        } else {
+            transformRange(0, batch.size());
+        }
+        predictions = classifier_.predictBatchSparse(vectors, pool_);
+    } else {
+        vector<vector<double>> features(batch.size());
+        auto vectorizeRange = [&](size_t begin, size_t end) {
+            FeatureExtractor extractor;
+            Tokenizer tokenizer;
+            for (size_t i = begin; i < end; ++i) {
+                if (hasher_) {
+                    features[i].resize(hasher_->dimensions());
+                    hasher_->extract(batch[i].subject, batch[i].message, tokenizer, features[i].data());
+                } else {
+                    features[i] = extractor.extractFeatures(batch[i].subject, batch[i].message, vocabulary_);
+                }
+            }
+        };
+        if (pool_ != nullptr) {
+            pool_->parallelFor(batch.size(), 16, vectorizeRange);
+        } else {
+            vectorizeRange(0, batch.size());
+        }
+        predictions = classifier_.predictBatch(features, pool_);
+    }
+    return predictions;
+}
+
+// Verdicts are collected per connection (a batch may mix several clients), keeping each
+// connection's arrival order, and handed to its writer in one piece.
+void ClassificationServer::answerBatch(vector<Request>& batch, const vector<Prediction>* predictions) {
+    struct Output {
+        Connection* connection;
+        size_t count;
+        string text;
+    };
+    vector<Output> output;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Connection* connection = batch[i].connection.get();
+        auto entry = find_if(output.begin(), output.end(), [&](const Output& o) { return o.connection == connection; });
+        if (entry == output.end()) {
+            output.push_back(Output{connection, 0, string()});
+            entry = output.end() - 1;
+        }
+        ++entry->count;
+        formatVerdict(batch[i], predictions != nullptr ? &(*predictions)[i] : nullptr, entry->text);
+    }
+    for (auto& entry : output) {
+        {
+            lock_guard<mutex> guard(entry.connection->outputLock);
+            entry.connection->pending += entry.text;
+            entry.connection->outstanding -= entry.count;
+        }
+        entry.connection->outputReady.notify_one();
+    }
+
+    auto now = chrono::steady_clock::now();
+    lock_guard<mutex> guard(lock_);
+    ++batches_;
+    for (const auto& request : batch) {
+        double latency = chrono::duration<double, milli>(now - request.arrival).count();
+        KNN_RECORD_NANOSECONDS("server.request", static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(now - request.arrival).count()));
+        maxLatency_ = max(maxLatency_, latency);
+        if (latencies_.size() < latencyWindow) {
+            latencies_.push_back(latency);
+        } else {
+            latencies_[latencyCursor_] = latency;
+            latencyCursor_ = (latencyCursor_ + 1) % latencyWindow;
+        }
+        ++emails_;
+    }
+    batch.clear();
+}
+
+// CSV: "7,Spam". JSONL: {"sequence":7,"verdict":"Spam","spamNeighbors":4,"neighbors":5,"confidence":0.8}.
+void ClassificationServer::formatVerdict(const Request& request, const Prediction* prediction, string& out) const {
+    bool classified = request.valid && prediction != nullptr;
+    const char* verdict = !request.valid ? "Invalid" : !classified ? "Error" : prediction->isSpam ? "Spam" : "Ham";
+    if (options_.format == Format::Csv) {
+        out += to_string(request.sequence);
+        out += ',';
+        out += verdict;
+        out += '\n';
+        return;
+    }
+
+    out += "{\"sequence\":";
+    out += to_string(request.sequence);
+    out += ",\"verdict\":\"";
+    out += verdict;
+    out += '"';
+    if (classified) {
+        out += ",\"spamNeighbors\":";
+        out += to_string(prediction->spamVotes);
+        out += ",\"neighbors\":";
+        out += to_string(prediction->neighborIndices.size());
+        char confidence[32];
+        snprintf(confidence, sizeof(confidence), ",\"confidence\":%.4g", prediction->confidence);
+        out += confidence;
+    }
+    out += "}\n";
+}
+
+// Writes until done; a client that closed its end just loses its verdicts.
+bool ClassificationServer::writeAll(const Connection& connection, const string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t count = connection.isSocket
+            ? ::send(connection.outFd, text.data() + written, text.size() - written, MSG_NOSIGNAL)
+            : ::write(connection.outFd, text.data() + written, text.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
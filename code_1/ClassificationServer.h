@@ -0,0 +1,198 @@
+#ifndef CLASSIFICATIONSERVER_H
+#define CLASSIFICATIONSERVER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "KNNClassifier.h"
+#include "FeatureExtractor.h"
+#include "Vocabulary.h"
+#include "FeatureHasher.h"
+#include "TfidfVectorizer.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Non-interactive classification service for a mail pipeline.
+// Emails arrive as CSV records ("subject,message", RFC 4180 quoting, so a quoted message may
+// span lines) on stdin or on the connections of a Unix domain socket. Every connection has a
+// reader thread that parses its records into one shared queue. A single batcher thread cuts
+// the queue into micro-batches: a batch is sent as soon as it holds maxBatch emails or its
+// oldest email has waited maxDelay, so a burst is classified in large parallel batches while
+// a lone email waits at most maxDelay. Verdicts are written back to each connection in the
+// order its emails arrived, one line per email: "<sequence>,Spam" or "<sequence>,Ham"
+// (sequence numbers start at 1 per connection; a record with fewer than two fields gets
+// "<sequence>,Invalid", and an email whose batch could not be classified "<sequence>,Error").
+// The queue is bounded, so a client that sends faster than the
+// service classifies is slowed down by TCP-style backpressure instead of growing memory.
+// Each connection also has a writer thread, so a client that is slow to read its verdicts
+// only delays itself, never the batcher or the other clients.
+class ClassificationServer {
+public:
+    // How verdicts are written: "<sequence>,Spam" lines, or one JSON object per line with the
+    // neighbor vote as well.
+    enum class Format { Csv, Jsonl };
+
+    // Batching and I/O knobs.
+    struct Options {
+        // Largest number of emails classified together.
+        size_t maxBatch;
+
+        // Longest time the oldest queued email waits for its batch to fill.
+        chrono::microseconds maxDelay;
+
+        // Most emails queued before readers block.
+        size_t maxQueued;
+
+        // Verdict line format.
+        Format format;
+
+        // Whether the first record of every stream is a header to skip (as in the dataset files).
+        bool skipHeader;
+
+        Options() : maxBatch(256), maxDelay(2000), maxQueued(16384), format(Format::Csv), skipHeader(false) {}
+    };
+
+    // Counters and latency percentiles (arrival to verdict ready) of the recent emails.
+    struct Stats {
+        size_t emails;
+        size_t batches;
+        double meanBatchSize;
+        double p50Milliseconds;
+        double p99Milliseconds;
+        double maxMilliseconds;
+    };
+
+    // Constructor: Serves a trained classifier with its top features; batches are vectorized
+    // and classified on the pool when one is given.
+    ClassificationServer(const KNNClassifier& classifier, const vector<string>& topFeatures, ThreadPool* pool = nullptr, const Options& options = Options());
+
+    // Constructor: Same for a classifier trained on hashed features; emails are vectorized by a
+    // copy of the hasher.
+    ClassificationServer(const KNNClassifier& classifier, const FeatureHasher& hasher, ThreadPool* pool = nullptr, const Options& options = Options());
+
+    // Constructor: Same for a classifier trained by trainSparse on TF-IDF vectors; emails are
+    // vectorized by a copy of the fitted vectorizer.
+    ClassificationServer(const KNNClassifier& classifier, const TfidfVectorizer& vectorizer, ThreadPool* pool = nullptr, const Options& options = Options());
+
+    ~ClassificationServer();
+
+    ClassificationServer(const ClassificationServer&) = delete;
+    ClassificationServer& operator=(const ClassificationServer&) = delete;
+
+    // Classifies the records read from inFd until end of input or requestStop, writing
+    // verdicts to outFd. Returns once every record read has been answered.
+    void serveStream(int inFd, int outFd);
+
+    // Accepts connections on a Unix domain socket at path (replacing a stale socket file) and
+    // serves each one as a stream until requestStop is called. Throws runtime_error if the
+    // socket cannot be created.
+    void serveSocket(const string& path);
+
+    // Asks serveStream or serveSocket to stop reading, finish the queued emails and return.
+    // Only sets a flag and writes to a pipe, so it may be called from a signal handler.
+    void requestStop();
+
+    // Statistics since construction.
+    Stats stats() const;
+
+private:
+    // One client: the descriptors its records are read from and its verdicts written to, and
+    // the verdicts waiting for its writer thread.
+    struct Connection {
+        int inFd;
+        int outFd;
+        bool ownsDescriptors;
+        bool isSocket;
+        size_t nextSequence;
+
+        mutex outputLock;
+        condition_variable outputReady;
+        string pending;
+        size_t outstanding;
+        bool inputDone;
+
+        Connection(int inFd, int outFd, bool ownsDescriptors, bool isSocket);
+        ~Connection();
+    };
+
+    // A queued email. Holding the connection keeps it open until the verdict is handed over.
+    struct Request {
+        shared_ptr<Connection> connection;
+        size_t sequence;
+        bool valid;
+        string subject;
+        string message;
+        chrono::steady_clock::time_point arrival;
+    };
+
+    const KNNClassifier& classifier_;
+    Vocabulary vocabulary_;
+    unique_ptr<FeatureHasher> hasher_;
+    unique_ptr<TfidfVectorizer> vectorizer_;
+    ThreadPool* pool_;
+    Options options_;
+
+    // The shared queue and its bookkeeping.
+    mutable mutex lock_;
+    condition_variable queued_;
+    condition_variable drained_;
+    deque<Request> queue_;
+    size_t activeReaders_;
+    bool inputOpen_;
+    atomic<bool> stopRequested_;
+
+    // Self-pipe written by requestStop; readers and the accept loop poll its read end.
+    int stopPipe_[2];
+
+    // Statistics; latencies of the most recent emails are kept in a ring.
+    size_t emails_;
+    size_t batches_;
+    double maxLatency_;
+    vector<double> latencies_;
+    size_t latencyCursor_;
+
+    // Connections being read, so that stopping can unblock their readers.
+    vector<weak_ptr<Connection>> connections_;
+
+    // Number of recent latencies kept for the percentiles.
+    static const size_t latencyWindow = 65536;
+
+    // Serves one connection: reads it on the calling thread while a writer thread answers it,
+    // and returns once every record has been answered.
+    void serveConnection(shared_ptr<Connection> connection);
+
+    // Reads and parses one connection's records into the queue until end of input.
+    void readConnection(shared_ptr<Connection> connection);
+
+    // Writes a connection's verdicts as the batcher produces them until all are written.
+    void writeConnection(shared_ptr<Connection> connection);
+
+    // Takes batches off the queue and answers them until the input is closed and drained.
+    void batchLoop();
+
+    // Classifies and answers one batch; if classifying throws, its emails are answered Error
+    // and the server keeps serving.
+    void processBatch(vector<Request>& batch);
+
+    // Vectorizes and classifies one batch.
+    vector<Prediction> classifyBatch(const vector<Request>& batch) const;
+
+    // Hands each request's verdict to its connection's writer; predictions is null when the
+    // batch could not be classified.
+    void answerBatch(vector<Request>& batch, const vector<Prediction>* predictions);
+
+    // Appends the verdict line for one request in the configured format; prediction is
+    // ignored for an invalid request and null for one that could not be classified.
+    void formatVerdict(const Request& request, const Prediction* prediction, string& out) const;
+
+    // Writes all bytes to a descriptor; returns false if the client has gone away.
+    static bool writeAll(const Connection& connection, const string& text);
+};
+
+#endif // CLASSIFICATIONSERVER_H
@@ -0,0 +1,170 @@
+#include "CorpusStore.h"
+
+#include <limits>
+#include <stdexcept>
+
+// Constructor: Starts with no emails and an empty one-slot interning table.
+CorpusStore::CorpusStore() : slots_(1, Slot{0, -1}), mask_(0), tokenizer_() {
+    tokenOffsets_.push_back(0);
+}
+
+// Copies both fields to the end of the text buffer and records the ids of their tokens. The
+// subject and message are scanned separately, which gives the same tokens as FeatureExtractor.
+size_t CorpusStore::add(string_view subject, string_view message, bool label) {
+    if (subject.size() > numeric_limits<uint32_t>::max() || message.size() > numeric_limits<uint32_t>::max()) {
+        throw invalid_argument("Email subjects and messages must be shorter than 4 GB");
+    }
+    Record record{text_.size(), static_cast<uint32_t>(subject.size()), static_cast<uint32_t>(message.size()), tokenIds_.size()};
+    text_.append(subject);
+    text_.append(message);
+
+    auto addToken = [&](string_view token, uint64_t hash) {
+        tokenIds_.push_back(intern(token, hash));
+    };
+    tokenizer_.scan(subject, addToken);
+    tokenizer_.scan(message, addToken);
+
+    records_.push_back(record);
+    labels_.push_back(label);
+    return records_.size() - 1;
+}
+
+// Reserves the text buffer and the per-email records.
+void CorpusStore::reserve(size_t emails, size_t textBytes) {
+    text_.reserve(textBytes);
+    records_.reserve(emails);
+    labels_.reserve(emails);
+}
+
+// Swaps every buffer with an empty one so their memory is released, not just cleared.
+void CorpusStore::clear() {
+    string().swap(text_);
+    vector<Record>().swap(records_);
+    vector<bool>().swap(labels_);
+    vector<uint32_t>().swap(tokenIds_);
+    string().swap(tokenText_);
+    tokenOffsets_.assign(1, 0);
+    tokenOffsets_.shrink_to_fit();
+    vector<uint64_t>().swap(tokenHashes_);
+    vector<Slot>(1, Slot{0, -1}).swap(slots_);
+    mask_ = 0;
+}
+
+// Returns the number of emails.
+size_t CorpusStore::size() const {
+    return records_.size();
+}
+
+// The subject starts at the record's text offset.
+string_view CorpusStore::subject(size_t email) const {
+    const Record& record = records_.at(email);
+    return string_view(text_.data() + record.textOffset, record.subjectLength);
+}
+
+// The message directly follows the subject.
+string_view CorpusStore::message(size_t email) const {
+    const Record& record = records_.at(email);
+    return string_view(text_.data() + record.textOffset + record.subjectLength, record.messageLength);
+}
+
+// Returns the label of an email.
+bool CorpusStore::label(size_t email) const {
+    return labels_.at(email);
+}
+
+// Returns the labels of every email.
+const vector<bool>& CorpusStore::labels() const {
+    return labels_;
+}
+
+// An email's ids start at its record's token offset.
+const uint32_t* CorpusStore::tokens(size_t email) const {
+    return tokenIds_.data() + records_.at(email).tokenOffset;
+}
+
+// An email's ids end where the next email's begin.
+size_t CorpusStore::tokenCount(size_t email) const {
+    size_t end = email + 1 < records_.size() ? records_[email + 1].tokenOffset : tokenIds_.size();
+    return end - records_.at(email).tokenOffset;
+}
+
+// Returns the number of distinct tokens.
+size_t CorpusStore::vocabularySize() const {
+    return tokenHashes_.size();
+}
+
+// Returns the text of an interned token.
+string_view CorpusStore::token(uint32_t id) const {
+    return string_view(tokenText_.data() + tokenOffsets_.at(id), tokenOffsets_[id + 1] - tokenOffsets_[id]);
+}
+
+// Returns the hash of an interned token.
+uint64_t CorpusStore::tokenHash(uint32_t id) const {
+    return tokenHashes_.at(id);
+}
+
+// Looks the token up without interning it.
+int64_t CorpusStore::findToken(string_view token) const {
+    return slots_[findSlot(token, Tokenizer::hashToken(token))].id;
+}
+
+// Returns the bytes of stored text.
+size_t CorpusStore::textBytes() const {
+    return text_.size();
+}
+
+// Sums the capacity of every buffer.
+size_t CorpusStore::memoryBytes() const {
+    return text_.capacity() + records_.capacity() * sizeof(Record) + labels_.capacity() / 8
+        + tokenIds_.capacity() * sizeof(uint32_t) + tokenText_.capacity() + tokenOffsets_.capacity() * sizeof(uint32_t)
+        + tokenHashes_.capacity() * sizeof(uint64_t) + slots_.capacity() * sizeof(Slot);
+}
+
+// Returns the id of a known token; a new one gets the next id and its text is appended to the
+// token buffer.
+uint32_t CorpusStore::intern(string_view token, uint64_t hash) {
+    size_t position = findSlot(token, hash);
+    if (slots_[position].id >= 0) {
+        return static_cast<uint32_t>(slots_[position].id);
+    }
+    if (tokenHashes_.size() == numeric_limits<uint32_t>::max() || tokenText_.size() + token.size() > numeric_limits<uint32_t>::max()) {
+        throw runtime_error("Too many distinct tokens for the corpus store");
+    }
+
+    uint32_t id = static_cast<uint32_t>(tokenHashes_.size());
+    tokenText_.append(token);
+    tokenOffsets_.push_back(static_cast<uint32_t>(tokenText_.size()));
+    tokenHashes_.push_back(hash);
+    slots_[position] = Slot{hash, id};
+    if (tokenHashes_.size() * 2 > slots_.size()) {
+        grow();
+    }
+    return id;
+}
+
+// Probes from the hash's home slot, comparing the text only when the full hashes match.
+size_t CorpusStore::findSlot(string_view token, uint64_t hash) const {
+    size_t position = hash & mask_;
+    while (slots_[position].id >= 0) {
+        const Slot& slot = slots_[position];
+        if (slot.hash == hash && this->token(static_cast<uint32_t>(slot.id)) == token) {
+            break;
+        }
+        position = (position + 1) & mask_;
+    }
+    return position;
+}
+
+// Reinserts every id into a table twice the size; the stored hashes avoid rehashing the text.
+void CorpusStore::grow() {
+    vector<Slot> slots(slots_.size() * 2, Slot{0, -1});
+    mask_ = slots.size() - 1;
+    for (size_t id = 0; id < tokenHashes_.size(); ++id) {
+        size_t position = tokenHashes_[id] & mask_;
+        while (slots[position].id >= 0) {
+            position = (position + 1) & mask_;
+        }
+        slots[position] = Slot{tokenHashes_[id], static_cast<int64_t>(id)};
+    }
+    slots_.swap(slots);
+}
@@ -0,0 +1,118 @@
+#ifndef CORPUSSTORE_H
+#define CORPUSSTORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Tokenizer.h"
+
+using namespace std;
+
+// Arena-backed store of an email corpus. The subject and message of every email are copied
+// once into one text buffer, and an email is a fixed-size record of offsets and lengths into
+// it, so a corpus costs no allocation per email. While an email is added it is tokenized once:
+// every distinct token is interned (its text kept once in a second buffer, under a 32-bit id)
+// and the email records the ids of its tokens in text order. Feature counting and extraction
+// then work on the ids (see FeatureExtractor) without scanning or hashing the text again.
+class CorpusStore {
+public:
+    // Constructor: Creates an empty corpus.
+    CorpusStore();
+
+    // Appends an email and returns its index; label is true for spam. Throws invalid_argument
+    // for a subject or message longer than 4 GB.
+    size_t add(string_view subject, string_view message, bool label = false);
+
+    // Reserves room for emails holding textBytes bytes of subjects and messages, so the text
+    // buffer is allocated once instead of growing by copies.
+    void reserve(size_t emails, size_t textBytes);
+
+    // Removes every email and token and releases the memory.
+    void clear();
+
+    // Number of emails.
+    size_t size() const;
+
+    // Subject of an email, valid until the corpus is cleared or destroyed.
+    string_view subject(size_t email) const;
+
+    // Message of an email, valid until the corpus is cleared or destroyed.
+    string_view message(size_t email) const;
+
+    // Label of an email (true for spam).
+    bool label(size_t email) const;
+
+    // Labels of every email, in order.
+    const vector<bool>& labels() const;
+
+    // Token ids of the email's subject followed by its message, in text order; the email has
+    // tokenCount(email) of them.
+    const uint32_t* tokens(size_t email) const;
+
+    // Number of tokens of an email.
+    size_t tokenCount(size_t email) const;
+
+    // Number of distinct tokens interned.
+    size_t vocabularySize() const;
+
+    // Text of an interned token.
+    string_view token(uint32_t id) const;
+
+    // Tokenizer::hashToken of an interned token.
+    uint64_t tokenHash(uint32_t id) const;
+
+    // Id of a token, or -1 if no email contains it.
+    int64_t findToken(string_view token) const;
+
+    // Bytes of subject and message text stored.
+    size_t textBytes() const;
+
+    // Bytes held by the corpus.
+    size_t memoryBytes() const;
+
+private:
+    // Position of one email in the text buffer and in the token id list; the message directly
+    // follows the subject.
+    struct Record {
+        uint64_t textOffset;
+        uint32_t subjectLength;
+        uint32_t messageLength;
+        uint64_t tokenOffset;
+    };
+
+    // Slot of the interning table; id is -1 for an empty slot.
+    struct Slot {
+        uint64_t hash;
+        int64_t id;
+    };
+
+    string text_;
+    vector<Record> records_;
+    vector<bool> labels_;
+    vector<uint32_t> tokenIds_;
+
+    // Interned token text, token i spanning [tokenOffsets_[i], tokenOffsets_[i + 1]).
+    string tokenText_;
+    vector<uint32_t> tokenOffsets_;
+    vector<uint64_t> tokenHashes_;
+
+    // Open-addressing table from token hash to id, kept at most half full.
+    vector<Slot> slots_;
+    size_t mask_;
+
+    // Scanner reused by every add.
+    Tokenizer tokenizer_;
+
+    // Id of a token, interning it if it is new.
+    uint32_t intern(string_view token, uint64_t hash);
+
+    // Slot holding the token, or the empty slot where it belongs.
+    size_t findSlot(string_view token, uint64_t hash) const;
+
+    // Doubles the interning table.
+    void grow();
+};
+
+#endif // CORPUSSTORE_H
@@ -0,0 +1,141 @@
+#include "CrossValidator.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+// Fraction of the emails classified correctly.
+double CrossValidator::Result::accuracy() const {
+    size_t total = truePositives + falsePositives + trueNegatives + falseNegatives;
+    return total > 0 ? static_cast<double>(truePositives + trueNegatives) / total : 0.0;
+}
+
+// Fraction of the emails classified as spam that are spam.
+double CrossValidator::Result::precision() const {
+    size_t flagged = truePositives + falsePositives;
+    return flagged > 0 ? static_cast<double>(truePositives) / flagged : 1.0;
+}
+
+// Fraction of the spam emails classified as spam.
+double CrossValidator::Result::recall() const {
+    size_t spam = truePositives + falseNegatives;
+    return spam > 0 ? static_cast<double>(truePositives) / spam : 1.0;
+}
+
+// Constructor: Keeps a reference to the data; it must outlive the validator.
+CrossValidator::CrossValidator(const vector<pair<pair<string, string>, bool>>& data, int folds, ThreadPool* pool)
+    : data_(data), folds_(folds), pool_(pool) {
+    if (folds_ < 2 || static_cast<size_t>(folds_) > data_.size()) {
+        throw invalid_argument("The number of folds must be at least 2 and at most the number of emails.");
+    }
+}
+
+// Per fold: count and select once, vectorize once, then search once per N and vote once per
+// (k, N).
+CrossValidator::Report CrossValidator::sweep(const vector<int>& kValues, const vector<int>& nValues, KNNClassifier::Voting voting) const {
+    KNN_TIMED_SCOPE("crossValidator.sweep");
+    if (kValues.empty() || nValues.empty()) {
+        throw invalid_argument("The k and N grids must not be empty.");
+    }
+    vector<int> ks(kValues);
+    vector<int> ns(nValues);
+    sort(ks.begin(), ks.end());
+    ks.erase(unique(ks.begin(), ks.end()), ks.end());
+    sort(ns.begin(), ns.end(), greater<int>());
+    ns.erase(unique(ns.begin(), ns.end()), ns.end());
+    if (ks.front() < 1 || ns.back() < 1) {
+        throw invalid_argument("Every k and N must be at least 1.");
+    }
+    int largestK = ks.back();
+
+    // results[n * ks.size() + j] is configuration (ks[j], ns[n]).
+    Report report;
+    report.preparationMilliseconds = 0.0;
+    for (int N : ns) {
+        for (int k : ks) {
+            report.results.push_back(Result{ k, N, 0, 0, 0, 0, 0.0, 0.0 });
+        }
+    }
+
+    FeatureExtractor featureExtractor;
+    for (int fold = 0; fold < folds_; ++fold) {
+        auto start = chrono::steady_clock::now();
+        vector<pair<pair<string, string>, bool>> trainingData;
+        vector<pair<pair<string, string>, bool>> heldOutData;
+        for (size_t i = 0; i < data_.size(); ++i) {
+            (i % folds_ == static_cast<size_t>(fold) ? heldOutData : trainingData).push_back(data_[i]);
+        }
+        vector<bool> labels;
+        labels.reserve(trainingData.size());
+        for (const auto& email : trainingData) {
+            labels.push_back(email.second);
+        }
+
+        // Largest N first: selection ranks the count lists in place, and a smaller N only reads
+        // the head of what a larger one ranked.
+        vector<pair<string, int>> spamCounts, hamCounts;
+        featureExtractor.countTrainingWords(trainingData, pool_, spamCounts, hamCounts);
+        vector<vector<string>> featureSets;
+        vector<string> unionFeatures;
+        for (int N : ns) {
+            featureSets.push_back(featureExtractor.selectBalancedTopFeatures(spamCounts, hamCounts, N));
+            vector<string> merged;
+            set_union(unionFeatures.begin(), unionFeatures.end(), featureSets.back().begin(), featureSets.back().end(), back_inserter(merged));
+            unionFeatures.swap(merged);
+        }
+        vector<vector<double>> trainingRows = featureExtractor.extractFeaturesBatch(trainingData, unionFeatures, pool_);
+        vector<vector<double>> heldOutRows = featureExtractor.extractFeaturesBatch(heldOutData, unionFeatures, pool_);
+        report.preparationMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        for (size_t n = 0; n < ns.size(); ++n) {
+            start = chrono::steady_clock::now();
+            // Both feature lists are sorted, so the columns are found in one merge.
+            vector<size_t> columns;
+            for (size_t c = 0, f = 0; c < unionFeatures.size() && f < featureSets[n].size(); ++c) {
+                if (unionFeatures[c] == featureSets[n][f]) {
+                    columns.push_back(c);
+                    ++f;
+                }
+            }
+            KNNClassifier classifier(largestK);
+            classifier.setVoting(voting);
+            classifier.train(selectColumns(trainingRows, columns), labels);
+            vector<vector<Neighbor>> neighbors = classifier.neighborIndex().searchBatch(selectColumns(heldOutRows, columns), static_cast<size_t>(largestK), pool_);
+            double searchMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            for (size_t j = 0; j < ks.size(); ++j) {
+                Result& result = report.results[n * ks.size() + j];
+                start = chrono::steady_clock::now();
+                for (size_t q = 0; q < heldOutData.size(); ++q) {
+                    bool isSpam = classifier.vote(neighbors[q], ks[j]).isSpam;
+                    bool wasSpam = heldOutData[q].second;
+                    (isSpam ? (wasSpam ? result.truePositives : result.falsePositives) : (wasSpam ? result.falseNegatives : result.trueNegatives))++;
+                }
+                result.voteMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                result.searchMilliseconds += searchMilliseconds;
+            }
+        }
+    }
+
+    // Present the grid by ascending N.
+    vector<Result> ordered;
+    ordered.reserve(report.results.size());
+    for (size_t n = ns.size(); n-- > 0;) {
+        ordered.insert(ordered.end(), report.results.begin() + n * ks.size(), report.results.begin() + (n + 1) * ks.size());
+    }
+    report.results.swap(ordered);
+    return report;
+}
+
+// Copies the listed columns of every row.
+vector<vector<double>> CrossValidator::selectColumns(const vector<vector<double>>& rows, const vector<size_t>& columns) {
+    vector<vector<double>> selected(rows.size(), vector<double>(columns.size()));
+    for (size_t r = 0; r < rows.size(); ++r) {
+        for (size_t c = 0; c < columns.size(); ++c) {
+            selected[r][c] = rows[r][columns[c]];
+        }
+    }
+    return selected;
+}
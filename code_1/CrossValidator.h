@@ -0,0 +1,76 @@
+#ifndef CROSSVALIDATOR_H
+#define CROSSVALIDATOR_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "KNNClassifier.h"
+#include "FeatureExtractor.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// k-fold cross-validation of the classifier over a grid of (k, N), without redoing the shared
+// work for every configuration. In each fold the training words are counted once and every N
+// is selected from those counts; the emails are vectorized once against the union of the
+// selected features, and each N uses its columns, which gives the same distances as
+// vectorizing against its own features. For each N the neighbors are searched once at the
+// largest k and every smaller k votes over a prefix of the same lists.
+// Email i belongs to fold i % folds, so folds keep the spam/ham mix of data read as a spam
+// block followed by a ham block.
+class CrossValidator {
+public:
+    // Scores of one (k, N) configuration summed over the folds; spam is the positive class.
+    struct Result {
+        int k;
+        int N;
+        size_t truePositives;
+        size_t falsePositives;
+        size_t trueNegatives;
+        size_t falseNegatives;
+
+        // Time spent on this N over all folds (slicing its columns, building the index and
+        // searching at the largest k); shared by every k with this N.
+        double searchMilliseconds;
+
+        // Time spent voting this configuration over all folds.
+        double voteMilliseconds;
+
+        // Fraction of the emails classified correctly.
+        double accuracy() const;
+
+        // Fraction of the emails classified as spam that are spam (1 if none were).
+        double precision() const;
+
+        // Fraction of the spam emails classified as spam (1 if there were none).
+        double recall() const;
+    };
+
+    // Results of a sweep, ordered by N, then k.
+    struct Report {
+        vector<Result> results;
+
+        // Time spent over all folds counting words, selecting the features of every N and
+        // vectorizing the emails; shared by every configuration.
+        double preparationMilliseconds;
+    };
+
+    // Constructor: Cross-validates over labeled emails with the given number of folds; throws
+    // invalid_argument unless 2 <= folds <= number of emails.
+    CrossValidator(const vector<pair<pair<string, string>, bool>>& data, int folds, ThreadPool* pool = nullptr);
+
+    // Scores every (k, N) pair of the grids; throws invalid_argument if a grid is empty or has a
+    // value below 1. Duplicate values are scored once.
+    Report sweep(const vector<int>& kValues, const vector<int>& nValues, KNNClassifier::Voting voting = KNNClassifier::Majority) const;
+
+private:
+    const vector<pair<pair<string, string>, bool>>& data_;
+    int folds_;
+    ThreadPool* pool_;
+
+    // Copies the columns of the rows listed in columns.
+    static vector<vector<double>> selectColumns(const vector<vector<double>>& rows, const vector<size_t>& columns);
+};
+
+#endif // CROSSVALIDATOR_H
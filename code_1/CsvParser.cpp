@@ -0,0 +1,285 @@
+#include "CsvParser.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Megabytes (10^6 bytes) parsed per second.
+double CsvParser::Stats::megabytesPerSecond() const {
+    return seconds > 0 ? bytes / seconds / 1e6 : 0.0;
+}
+
+// Constructor: Creates a parser that reads streams in chunks of chunkSize bytes.
+CsvParser::CsvParser(size_t chunkSize) : chunkSize_(chunkSize == 0 ? 1 : chunkSize) {
+    reset();
+}
+
+// Parses a complete in-memory document. Fields without escaped quotes are viewed in place.
+void CsvParser::parse(string_view data, const RecordHandler& onRecord) {
+    reset();
+    auto start = chrono::steady_clock::now();
+    consume(data.data(), data.data() + data.size(), onRecord);
+    bytes_ += data.size();
+    finish(onRecord);
+    seconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Parses a stream, reading it in fixed-size chunks into one reused buffer.
+void CsvParser::parse(istream& in, const RecordHandler& onRecord) {
+    reset();
+    vector<char> chunk(chunkSize_);
+    while (in) {
+        in.read(chunk.data(), chunk.size());
+        streamsize count = in.gcount();
+        if (count <= 0) {
+            break;
+        }
+        feed(string_view(chunk.data(), static_cast<size_t>(count)), onRecord);
+    }
+    finish(onRecord);
+}
+
+// Parses a file, reading it in fixed-size chunks.
+void CsvParser::parseFile(const string& path, const RecordHandler& onRecord) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        throw runtime_error("Failed to open CSV file: " + path);
+    }
+    parse(file, onRecord);
+}
+
+// Runs the state machine over one chunk; anything still referring to the chunk afterwards is
+// copied out, because the caller may reuse the chunk's memory.
+void CsvParser::feed(string_view chunk, const RecordHandler& onRecord) {
+    auto start = chrono::steady_clock::now();
+    consume(chunk.data(), chunk.data() + chunk.size(), onRecord);
+    detachFromChunk();
+    bytes_ += chunk.size();
+    seconds_ += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Flushes the last record if the input did not end with a line break.
+void CsvParser::finish(const RecordHandler& onRecord) {
+    if (state_ == Quoted) {
+        reset();
+        throw runtime_error("CSV input ends inside a quoted field");
+    }
+    if (state_ == Unquoted || state_ == QuoteInQuoted || (state_ == FieldStart && !fields_.empty())) {
+        endField();
+        endRecord(onRecord);
+    }
+    state_ = FieldStart;
+}
+
+// Forgets any partially parsed record and resets the statistics.
+void CsvParser::reset() {
+    state_ = FieldStart;
+    pending_ = Field{ nullptr, 0, 0, false, false };
+    fields_.clear();
+    recordBuffer_.clear();
+    bytes_ = 0;
+    records_ = 0;
+    seconds_ = 0.0;
+}
+
+// Throughput figures for the most recent parse.
+CsvParser::Stats CsvParser::stats() const {
+    Stats result;
+    result.bytes = bytes_;
+    result.records = records_;
+    result.seconds = seconds_;
+    return result;
+}
+
+// The state machine. Inside a field it never steps byte by byte: it jumps straight to the
+// next character that can end the field (a delimiter, or a quote inside a quoted field).
+void CsvParser::consume(const char* p, const char* end, const RecordHandler& onRecord) {
+    while (p < end) {
+        switch (state_) {
+            case AfterCarriageReturn:
+                // "\r\n" ends one record, not two.
+                if (*p == '\n') {
+                    ++p;
+                }
+                state_ = FieldStart;
+                break;
+
+            case FieldStart:
+                if (*p == '"') {
+                    startField(++p, true);
+                    state_ = Quoted;
+                } else {
+                    startField(p, false);
+                    state_ = Unquoted;
+                }
+                break;
+
+            case Unquoted: {
+                const char* stop = findDelimiter(p, end);
+                extendField(p, stop);
+                p = stop;
+                if (p == end) {
+                    break;
+                }
+                char c = *p++;
+                endField();
+                if (c == ',') {
+                    state_ = FieldStart;
+                } else {
+                    endRecord(onRecord);
+                    state_ = c == '\r' ? AfterCarriageReturn : FieldStart;
+                }
+                break;
+            }
+
+            case Quoted: {
+                const char* stop = findQuote(p, end);
+                extendField(p, stop);
+                p = stop;
+                if (p != end) {
+                    ++p;
+                    state_ = QuoteInQuoted;
+                }
+                break;
+            }
+
+            case QuoteInQuoted: {
+                char c = *p;
+                if (c == '"') {
+                    // Escaped quote: keep one '"'. The text is no longer contiguous in the input.
+                    bufferPending();
+                    recordBuffer_.push_back('"');
+                    ++pending_.length;
+                    ++p;
+                    state_ = Quoted;
+                } else if (c == ',') {
+                    endField();
+                    ++p;
+                    state_ = FieldStart;
+                } else if (c == '\n' || c == '\r') {
+                    endField();
+                    endRecord(onRecord);
+                    ++p;
+                    state_ = c == '\r' ? AfterCarriageReturn : FieldStart;
+                } else {
+                    // Text after a closing quote is kept, as most spreadsheet tools do.
+                    bufferPending();
+                    state_ = Unquoted;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Starts a new field whose text begins at the given position.
+void CsvParser::startField(const char* position, bool quoted) {
+    pending_ = Field{ position, 0, 0, false, quoted };
+}
+
+// Adds input bytes [begin, end) to the pending field, extending the in-place view when the
+// bytes directly follow it.
+void CsvParser::extendField(const char* begin, const char* end) {
+    if (begin == end) {
+        return;
+    }
+    if (!pending_.buffered && (pending_.length == 0 || pending_.data + pending_.length == begin)) {
+        if (pending_.length == 0) {
+            pending_.data = begin;
+        }
+        pending_.length += end - begin;
+        return;
+    }
+    bufferPending();
+    recordBuffer_.append(begin, end);
+    pending_.length += end - begin;
+}
+
+// Moves the pending field's text into recordBuffer_.
+void CsvParser::bufferPending() {
+    if (pending_.buffered) {
+        return;
+    }
+    pending_.offset = recordBuffer_.size();
+    recordBuffer_.append(pending_.data == nullptr ? "" : pending_.data, pending_.length);
+    pending_.buffered = true;
+}
+
+// Finishes the pending field.
+void CsvParser::endField() {
+    fields_.push_back(pending_);
+    pending_ = Field{ nullptr, 0, 0, false, false };
+}
+
+// Hands the finished record to the handler. A blank line (one empty, unquoted field) is skipped.
+void CsvParser::endRecord(const RecordHandler& onRecord) {
+    bool blank = fields_.size() == 1 && fields_[0].length == 0 && !fields_[0].quoted;
+    if (!blank) {
+        views_.clear();
+        for (const Field& field : fields_) {
+            const char* text = field.buffered ? recordBuffer_.data() + field.offset : field.data;
+            views_.push_back(string_view(text == nullptr ? "" : text, field.length));
+        }
+        ++records_;
+        onRecord(views_);
+    }
+    fields_.clear();
+    recordBuffer_.clear();
+}
+
+// Moves every field still pointing into the current chunk into recordBuffer_.
+void CsvParser::detachFromChunk() {
+    for (Field& field : fields_) {
+        if (!field.buffered) {
+            field.offset = recordBuffer_.size();
+            recordBuffer_.append(field.data == nullptr ? "" : field.data, field.length);
+            field.buffered = true;
+        }
+    }
+    if (state_ == FieldStart || state_ == AfterCarriageReturn) {
+        return;
+    }
+    if (pending_.buffered && pending_.offset + pending_.length != recordBuffer_.size()) {
+        // Keep the pending field's text at the end of the buffer so later bytes extend it.
+        size_t offset = recordBuffer_.size();
+        recordBuffer_.append(recordBuffer_, pending_.offset, pending_.length);
+        pending_.offset = offset;
+    }
+    bufferPending();
+}
+
+// Returns the first of ',', '\n' or '\r' in [begin, end), or end. Scans 16 bytes per step.
+const char* CsvParser::findDelimiter(const char* begin, const char* end) {
+    const char* p = begin;
+#if defined(__SSE2__)
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    for (; p + 16 <= end; p += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, comma),
+                                    _mm_or_si128(_mm_cmpeq_epi8(bytes, newline), _mm_cmpeq_epi8(bytes, carriageReturn)));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == ',' || *p == '\n' || *p == '\r') {
+            return p;
+        }
+    }
+    return end;
+}
+
+// Returns the first '"' in [begin, end), or end. memchr is vectorized by the C library.
+const char* CsvParser::findQuote(const char* begin, const char* end) {
+    const void* hit = memchr(begin, '"', end - begin);
+    return hit == nullptr ? end : static_cast<const char*>(hit);
+}
@@ -0,0 +1,114 @@
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <istream>
+#include <cstddef>
+
+using namespace std;
+
+// Streaming RFC 4180 CSV parser.
+// Fields are separated by ',' and records by "\n" or "\r\n". A field that starts with '"' is
+// quoted: it may contain commas and line breaks, and "" inside it stands for one '"'.
+// Blank lines are skipped. Input can be given as one buffer or fed in chunks of any size; the
+// parser is a byte-level state machine that jumps between special characters with SIMD scans.
+// After the first few records it performs no further allocations: field text that cannot be
+// viewed in place (escaped quotes, or fields split across chunks) goes into a reused buffer.
+class CsvParser {
+public:
+    // Called once per record. The views are valid only for the duration of the call, except
+    // that views into a buffer passed to parse stay valid as long as that buffer does.
+    typedef function<void(const vector<string_view>& fields)> RecordHandler;
+
+    // Throughput figures for the most recent parse.
+    struct Stats {
+        size_t bytes;
+        size_t records;
+        double seconds;
+
+        // Megabytes (10^6 bytes) parsed per second.
+        double megabytesPerSecond() const;
+    };
+
+    // Constructor: Creates a parser that reads streams in chunks of chunkSize bytes.
+    explicit CsvParser(size_t chunkSize = 64 * 1024);
+
+    // Parses a complete in-memory document (for example a MappedFile view).
+    void parse(string_view data, const RecordHandler& onRecord);
+
+    // Parses a stream, reading it in fixed-size chunks.
+    void parse(istream& in, const RecordHandler& onRecord);
+
+    // Parses a file, reading it in fixed-size chunks; throws runtime_error if it cannot be opened.
+    void parseFile(const string& path, const RecordHandler& onRecord);
+
+    // Incremental interface: feed chunks in order, then call finish to flush the last record.
+    // Throws runtime_error from finish if the input ends inside a quoted field.
+    void feed(string_view chunk, const RecordHandler& onRecord);
+    void finish(const RecordHandler& onRecord);
+
+    // Forgets any partially parsed record and resets the statistics.
+    void reset();
+
+    // Throughput figures for the most recent parse (or the chunks fed since the last reset).
+    Stats stats() const;
+
+private:
+    // Parser states.
+    enum State { FieldStart, Unquoted, Quoted, QuoteInQuoted, AfterCarriageReturn };
+
+    // A completed field: either a view of the input or a range of recordBuffer_.
+    struct Field {
+        const char* data;
+        size_t offset;
+        size_t length;
+        bool buffered;
+        bool quoted;
+    };
+
+    size_t chunkSize_;
+    State state_;
+
+    // The field being parsed, in the same representation as a completed field.
+    Field pending_;
+
+    // Fields of the current record, the text of its buffered fields, and the views handed out.
+    vector<Field> fields_;
+    string recordBuffer_;
+    vector<string_view> views_;
+
+    // Statistics since the last reset.
+    size_t bytes_;
+    size_t records_;
+    double seconds_;
+
+    // Runs the state machine over one chunk.
+    void consume(const char* begin, const char* end, const RecordHandler& onRecord);
+
+    // Starts a new field whose text begins at the given position.
+    void startField(const char* position, bool quoted);
+
+    // Adds input bytes [begin, end) to the pending field.
+    void extendField(const char* begin, const char* end);
+
+    // Moves the pending field's text into recordBuffer_ so it no longer points into the input.
+    void bufferPending();
+
+    // Finishes the pending field / the current record.
+    void endField();
+    void endRecord(const RecordHandler& onRecord);
+
+    // Moves every field still pointing into the current chunk into recordBuffer_.
+    void detachFromChunk();
+
+    // Returns the first of ',', '\n' or '\r' in [begin, end), or end.
+    static const char* findDelimiter(const char* begin, const char* end);
+
+    // Returns the first '"' in [begin, end), or end.
+    static const char* findQuote(const char* begin, const char* end);
+};
+
+#endif // CSVPARSER_H
@@ -0,0 +1,408 @@
+#include "DistanceKernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KNN_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+namespace {
+
+typedef double (*SquaredDistanceFn)(const double*, const double*, size_t);
+typedef int (*HammingDistanceFn)(const uint64_t*, const uint64_t*, size_t);
+typedef int64_t (*DotProductInt8Fn)(const int8_t*, const int8_t*, size_t);
+typedef float (*SquaredDistanceHalfFn)(const float*, const uint16_t*, size_t);
+
+// Portable squared Euclidean distance.
+double squaredDistanceScalar(const double* email1, const double* email2, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double diff = email1[i] - email2[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Portable XOR + popcount distance.
+int hammingDistanceScalar(const uint64_t* email1, const uint64_t* email2, size_t words) {
+    int distance = 0;
+    for (size_t w = 0; w < words; ++w) {
+        distance += __builtin_popcountll(email1[w] ^ email2[w]);
+    }
+    return distance;
+}
+
+// Portable int8 dot product.
+int64_t dotProductInt8Scalar(const int8_t* email1, const int8_t* email2, size_t n) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += static_cast<int>(email1[i]) * email2[i];
+    }
+    return sum;
+}
+
+// Portable float / fp16 squared distance.
+float squaredDistanceHalfScalar(const float* email1, const uint16_t* email2, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float diff = email1[i] - DistanceKernels::halfToFloat(email2[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+#ifdef KNN_X86_KERNELS
+
+// Scalar popcount compiled for the hardware POPCNT instruction (part of every AVX2 CPU).
+__attribute__((target("popcnt")))
+int hammingDistancePopcnt(const uint64_t* email1, const uint64_t* email2, size_t words) {
+    int distance = 0;
+    for (size_t w = 0; w < words; ++w) {
+        distance += static_cast<int>(_mm_popcnt_u64(email1[w] ^ email2[w]));
+    }
+    return distance;
+}
+
+// Four doubles per step with fused multiply-add.
+__attribute__((target("avx2,fma")))
+double squaredDistanceAVX2(const double* email1, const double* email2, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(email1 + i), _mm256_loadu_pd(email2 + i));
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(email1 + i + 4), _mm256_loadu_pd(email2 + i + 4));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(email1 + i), _mm256_loadu_pd(email2 + i));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < n; ++i) {
+        double diff = email1[i] - email2[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Sixteen int8 pairs per step: sign-extended to int16, multiplied and summed pairwise into
+// int32 lanes (at most 2 * 127^2 per lane and step, so 2^20 elements cannot overflow a lane);
+// the lanes are added in 64 bits.
+__attribute__((target("avx2")))
+int64_t dotProductInt8AVX2(const int8_t* email1, const int8_t* email2, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(email1 + i)));
+        __m256i b = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(email2 + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+    }
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    int64_t sum = 0;
+    for (int32_t lane : lanes) {
+        sum += lane;
+    }
+    for (; i < n; ++i) {
+        sum += static_cast<int>(email1[i]) * email2[i];
+    }
+    return sum;
+}
+
+// Eight fp16 values per step, widened with F16C.
+__attribute__((target("avx2,fma,f16c")))
+float squaredDistanceHalfAVX2(const float* email1, const uint16_t* email2, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(email1 + i), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(email2 + i))));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(email1 + i + 8), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(email2 + i + 8))));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(email1 + i), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(email2 + i))));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    float sum = _mm_cvtss_f32(_mm_add_ss(half, _mm_movehdup_ps(half)));
+    for (; i < n; ++i) {
+        float diff = email1[i] - DistanceKernels::halfToFloat(email2[i]);
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Sums stored vector lanes by repeatedly adding the upper half onto the lower half, the same
+// order as _mm512_reduce_add_pd / _ps, whose GCC 12 versions trip -Wuninitialized.
+template <typename T, size_t Count>
+T sumLanes(T (&lanes)[Count]) {
+    for (size_t width = Count / 2; width > 0; width /= 2) {
+        for (size_t i = 0; i < width; ++i) {
+            lanes[i] += lanes[i + width];
+        }
+    }
+    return lanes[0];
+}
+
+// Eight doubles per step; the tail is handled with a masked load.
+__attribute__((target("avx512f")))
+double squaredDistanceAVX512(const double* email1, const double* email2, size_t n) {
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(email1 + i), _mm512_loadu_pd(email2 + i));
+        acc = _mm512_fmadd_pd(diff, diff, acc);
+    }
+    if (i < n) {
+        __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+        __m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, email1 + i), _mm512_maskz_loadu_pd(mask, email2 + i));
+        acc = _mm512_fmadd_pd(diff, diff, acc);
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, acc);
+    return sumLanes(lanes);
+}
+
+// Eight words per step using the AVX-512 VPOPCNTDQ vector popcount.
+__attribute__((target("avx512f,avx512vpopcntdq")))
+int hammingDistanceAVX512(const uint64_t* email1, const uint64_t* email2, size_t words) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t w = 0;
+    for (; w + 8 <= words; w += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512(email1 + w), _mm512_loadu_si512(email2 + w));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+    }
+    if (w < words) {
+        __mmask8 mask = static_cast<__mmask8>((1u << (words - w)) - 1);
+        __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, email1 + w), _mm512_maskz_loadu_epi64(mask, email2 + w));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+    }
+    alignas(64) int64_t lanes[8];
+    _mm512_store_si512(lanes, acc);
+    return static_cast<int>(sumLanes(lanes));
+}
+
+// Thirty-two int8 pairs per step (AVX-512 BW); the tail is padded with zeros.
+__attribute__((target("avx512f,avx512bw")))
+int64_t dotProductInt8AVX512(const int8_t* email1, const int8_t* email2, size_t n) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512i a = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(email1 + i)));
+        __m512i b = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(email2 + i)));
+        acc = _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+    }
+    if (i < n) {
+        alignas(32) int8_t tail1[32] = {};
+        alignas(32) int8_t tail2[32] = {};
+        memcpy(tail1, email1 + i, n - i);
+        memcpy(tail2, email2 + i, n - i);
+        __m512i a = _mm512_cvtepi8_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail1)));
+        __m512i b = _mm512_cvtepi8_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail2)));
+        acc = _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+    }
+    // The sixteen lanes are added in 64 bits, as in the AVX2 version.
+    alignas(64) int32_t lanes[16];
+    _mm512_store_si512(lanes, acc);
+    int64_t sum = 0;
+    for (int32_t lane : lanes) {
+        sum += lane;
+    }
+    return sum;
+}
+
+// Sixteen fp16 values per step; the tail is padded with zeros, which add nothing.
+__attribute__((target("avx512f")))
+float squaredDistanceHalfAVX512(const float* email1, const uint16_t* email2, size_t n) {
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(email1 + i), _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(email2 + i))));
+        acc = _mm512_fmadd_ps(diff, diff, acc);
+    }
+    if (i < n) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        alignas(32) uint16_t tail[16] = {};
+        memcpy(tail, email2 + i, (n - i) * sizeof(uint16_t));
+        __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, email1 + i), _mm512_maskz_cvtph_ps(0xFFFF, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail))));
+        acc = _mm512_fmadd_ps(diff, diff, acc);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    return sumLanes(lanes);
+}
+
+#endif // KNN_X86_KERNELS
+
+// Currently selected kernels.
+struct KernelTable {
+    DistanceKernels::Isa isa;
+    SquaredDistanceFn squaredDistance;
+    HammingDistanceFn hammingDistance;
+    DotProductInt8Fn dotProductInt8;
+    SquaredDistanceHalfFn squaredDistanceHalf;
+};
+
+// Builds the kernel table for an instruction set, falling back to narrower kernels where needed.
+KernelTable makeTable(DistanceKernels::Isa isa) {
+    KernelTable table = { DistanceKernels::Scalar, squaredDistanceScalar, hammingDistanceScalar, dotProductInt8Scalar, squaredDistanceHalfScalar };
+#ifdef KNN_X86_KERNELS
+    if (isa >= DistanceKernels::AVX2) {
+        table.isa = DistanceKernels::AVX2;
+        table.squaredDistance = squaredDistanceAVX2;
+        table.hammingDistance = hammingDistancePopcnt;
+        table.dotProductInt8 = dotProductInt8AVX2;
+        if (__builtin_cpu_supports("f16c")) {
+            table.squaredDistanceHalf = squaredDistanceHalfAVX2;
+        }
+    }
+    if (isa >= DistanceKernels::AVX512) {
+        table.isa = DistanceKernels::AVX512;
+        table.squaredDistance = squaredDistanceAVX512;
+        table.squaredDistanceHalf = squaredDistanceHalfAVX512;
+        if (__builtin_cpu_supports("avx512vpopcntdq")) {
+            table.hammingDistance = hammingDistanceAVX512;
+        }
+        if (__builtin_cpu_supports("avx512bw")) {
+            table.dotProductInt8 = dotProductInt8AVX512;
+        }
+    }
+#else
+    (void)isa;
+#endif
+    return table;
+}
+
+// Returns the process-wide kernel table, initialized on first use from the CPU features.
+KernelTable& kernelTable() {
+    static KernelTable table = makeTable(DistanceKernels::bestSupportedIsa());
+    return table;
+}
+
+} // namespace
+
+// Squared Euclidean distance between two dense vectors of length n.
+double DistanceKernels::squaredDistance(const double* email1, const double* email2, size_t n) {
+    return kernelTable().squaredDistance(email1, email2, n);
+}
+
+// Number of differing bits between two packed binary vectors of the given word count.
+int DistanceKernels::hammingDistance(const uint64_t* email1, const uint64_t* email2, size_t words) {
+    return kernelTable().hammingDistance(email1, email2, words);
+}
+
+// Dot product of two int8 vectors of length n.
+int64_t DistanceKernels::dotProductInt8(const int8_t* email1, const int8_t* email2, size_t n) {
+    return kernelTable().dotProductInt8(email1, email2, n);
+}
+
+// Squared Euclidean distance between a float vector and an fp16 vector of length n.
+float DistanceKernels::squaredDistanceHalf(const float* email1, const uint16_t* email2, size_t n) {
+    return kernelTable().squaredDistanceHalf(email1, email2, n);
+}
+
+// Works on the bit patterns: the exponent is rebiased from 127 to 15, values below the
+// normal range become subnormals, and the dropped mantissa bits round to nearest even.
+uint16_t DistanceKernels::floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+        // Infinity stays infinity, NaN stays a (quiet) NaN.
+        return static_cast<uint16_t>(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477FF000) {
+        // At or above 65520 rounds past the largest half (65504).
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (magnitude < 0x38800000) {
+        // Subnormal half (or zero): shift the mantissa with its implicit bit into place.
+        int shift = 126 - static_cast<int>(magnitude >> 23);
+        if (shift > 24) {
+            return sign;
+        }
+        uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = ((magnitude >> 13) - (112u << 10));
+    uint32_t rest = magnitude & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+// Exact widening: normals are rebiased, subnormals normalized.
+float DistanceKernels::halfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+    uint32_t bits;
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Widest instruction set supported by this CPU and build.
+DistanceKernels::Isa DistanceKernels::bestSupportedIsa() {
+#ifdef KNN_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("popcnt")) {
+        return AVX2;
+    }
+#endif
+    return Scalar;
+}
+
+// Instruction set currently used by the kernels.
+DistanceKernels::Isa DistanceKernels::activeIsa() {
+    return kernelTable().isa;
+}
+
+// Switches the kernels to the given instruction set, clamped to what the CPU supports.
+void DistanceKernels::useIsa(Isa isa) {
+    Isa best = bestSupportedIsa();
+    kernelTable() = makeTable(isa < best ? isa : best);
+}
+
+// Human readable name of an instruction set.
+string DistanceKernels::isaName(Isa isa) {
+    switch (isa) {
+        case AVX512: return "avx512";
+        case AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef DISTANCEKERNELS_H
+#define DISTANCEKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Distance kernels used by the KNN scan, with a scalar, AVX2 and AVX-512 version of each.
+// The widest version supported by the running CPU is picked once at first use.
+class DistanceKernels {
+public:
+    // Instruction sets a kernel can be built for, from narrowest to widest.
+    enum Isa { Scalar = 0, AVX2 = 1, AVX512 = 2 };
+
+    // Squared Euclidean distance between two dense vectors of length n.
+    static double squaredDistance(const double* email1, const double* email2, size_t n);
+
+    // Number of differing bits between two packed binary vectors of the given word count.
+    static int hammingDistance(const uint64_t* email1, const uint64_t* email2, size_t words);
+
+    // Dot product of two int8 vectors of length n, accumulated exactly in integers (n up to 2^20).
+    static int64_t dotProductInt8(const int8_t* email1, const int8_t* email2, size_t n);
+
+    // Squared Euclidean distance between a float vector and an fp16 vector of length n.
+    static float squaredDistanceHalf(const float* email1, const uint16_t* email2, size_t n);
+
+    // IEEE 754 half-precision conversions; floatToHalf rounds to nearest even and saturates
+    // to infinity.
+    static uint16_t floatToHalf(float value);
+    static float halfToFloat(uint16_t value);
+
+    // Widest instruction set supported by this CPU and build.
+    static Isa bestSupportedIsa();
+
+    // Instruction set currently used by the kernels.
+    static Isa activeIsa();
+
+    // Switches the kernels to the given instruction set, clamped to what the CPU supports.
+    // Intended for benchmarks and validation; call it before any concurrent use.
+    static void useIsa(Isa isa);
+
+    // Human readable name of an instruction set ("scalar", "avx2", "avx512").
+    static string isaName(Isa isa);
+};
+
+#endif // DISTANCEKERNELS_H
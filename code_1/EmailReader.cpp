@@ -1,96 +1,248 @@
 #include "EmailReader.h"
+#include "Metrics.h"
 
 // Constructor: Sets file paths for spam, ham, and test email datasets.
 EmailReader::EmailReader(const string& spamFilePath, const string& hamFilePath, const string& testFilePath)
-    : spamFilePath_(spamFilePath), hamFilePath_(hamFilePath), testFilePath_(testFilePath) {
+    : spamFilePath_(spamFilePath), hamFilePath_(hamFilePath), testFilePath_(testFilePath), parseStats_() {
 }
 
 // Reads and processes training emails from spam and ham datasets.
+// The files are parsed in place through their mappings; each field is copied exactly once.
 void EmailReader::readTrainingEmails() {
+    KNN_TIMED_SCOPE("reader.readTrainingEmails");
     trainingData_.clear(); // Clear existing training data.
+    trainingCorpus_.clear();
+    mapTrainingEmails();
 
-    ifstream spamFile(spamFilePath_), hamFile(hamFilePath_);
-    string line;
     int spamCount = 0, hamCount = 0;
-
-    // Reading and labeling spam emails.
-    if (spamFile.is_open()) {
-        getline(spamFile, line); // Skip header line.
-        while (getline(spamFile, line)) {
-            if (!line.empty()) {
-                spamCount++;
-                auto parsedEmail = parseLine(line);
-                trainingData_.push_back(make_pair(parsedEmail, true)); // Label as true for spam.
-            }
+    trainingData_.reserve(trainingViews_.size());
+    for (const auto& email : trainingViews_) {
+        // Label as true for spam, false for ham.
+        trainingData_.push_back(make_pair(make_pair(string(email.first.subject), string(email.first.message)), email.second));
+        if (email.second) {
+            spamCount++;
+        } else {
+            hamCount++;
         }
-        spamFile.close();
-    } else {
-        throw runtime_error("Failed to open spam file: " + spamFilePath_);
     }
-
-    // Reading and labeling ham emails.
-    if (hamFile.is_open()) {
-        getline(hamFile, line); // Skip header line.
-        while (getline(hamFile, line)) {
-            if (!line.empty()) {
-                hamCount++;
-                auto parsedEmail = parseLine(line);
-                trainingData_.push_back(make_pair(parsedEmail, false)); // Label as false for ham.
-            }
-        }
-        hamFile.close();
-    } else {
-        throw runtime_error("Failed to open ham file: " + hamFilePath_);
-    }
-    cout << "Total spam emails loaded: " << spamCount << endl;
-    cout << "Total ham emails loaded: " << hamCount << endl;
-
-    cout << "Total training emails loaded: " << trainingData_.size() << endl;
-
-
+    reportTrainingEmails(spamCount, hamCount);
 }
 
 // Reads and stores test emails for later prediction.
 void EmailReader::readTestEmails() {
+    KNN_TIMED_SCOPE("reader.readTestEmails");
     testData_.clear(); // Clear existing test data.
-    
-    ifstream testFile(testFilePath_);
-    string line;
-
-    if (testFile.is_open()) {
-        getline(testFile, line); // Skip header line.
-        while (getline(testFile, line)) {
-            if (!line.empty()) {
-                testData_.push_back(parseLine(line)); // Add parsed email to test data.
-            }
-        }
-        testFile.close();
-    } else {
-        throw runtime_error("Failed to open test file: " + testFilePath_);
+    testCorpus_.clear();
+    mapTestEmails();
+
+    testData_.reserve(testViews_.size());
+    for (const auto& email : testViews_) {
+        testData_.push_back(make_pair(string(email.subject), string(email.message))); // Add parsed email to test data.
     }
 }
 
 // Returns the parsed training data (emails and their labels).
-vector<pair<pair<string, string>, bool>> EmailReader::getTrainingData() const {
+const vector<pair<pair<string, string>, bool>>& EmailReader::getTrainingData() const {
     return trainingData_;
 }
 
 // Returns the parsed test data (emails without labels).
-vector<pair<string, string>> EmailReader::getTestData() const {
+const vector<pair<string, string>>& EmailReader::getTestData() const {
     return testData_;
 }
 
-// Parses a line from the dataset and returns a pair of subject and message.
-pair<string, string> EmailReader::parseLine(const string& line) const {
-    int commaPos = line.find(','); // Find the delimiter position.
+// Streams the spam and ham files into the corpus, spam first. Each record is copied from the
+// parser's chunk straight into the arena, so the files are never held in memory whole.
+void EmailReader::readTrainingCorpus() {
+    KNN_TIMED_SCOPE("reader.readTrainingCorpus");
+    vector<pair<pair<string, string>, bool>>().swap(trainingData_);
+    vector<pair<EmailView, bool>>().swap(trainingViews_);
+    deque<string>().swap(trainingFieldText_);
+    spamFile_.close();
+    hamFile_.close();
+    trainingCorpus_.clear();
+
+    size_t spamCount = streamFile(spamFilePath_, "spam", true, trainingCorpus_);
+    CsvParser::Stats spamStats = parser_.stats();
+    size_t hamCount = streamFile(hamFilePath_, "ham", false, trainingCorpus_);
+
+    parseStats_ = parser_.stats();
+    parseStats_.bytes += spamStats.bytes;
+    parseStats_.records += spamStats.records;
+    parseStats_.seconds += spamStats.seconds;
+    reportTrainingEmails(static_cast<int>(spamCount), static_cast<int>(hamCount));
+}
+
+// Streams the test file into the corpus.
+void EmailReader::readTestCorpus() {
+    KNN_TIMED_SCOPE("reader.readTestCorpus");
+    vector<pair<string, string>>().swap(testData_);
+    vector<EmailView>().swap(testViews_);
+    deque<string>().swap(testFieldText_);
+    testFile_.close();
+    testCorpus_.clear();
+
+    streamFile(testFilePath_, "test", false, testCorpus_);
+    parseStats_ = parser_.stats();
+}
+
+// Returns the training corpus.
+const CorpusStore& EmailReader::getTrainingCorpus() const {
+    return trainingCorpus_;
+}
+
+// Returns the test corpus.
+const CorpusStore& EmailReader::getTestCorpus() const {
+    return testCorpus_;
+}
+
+// Maps the spam and ham files and records views of their emails, spam first.
+void EmailReader::mapTrainingEmails() {
+    KNN_TIMED_SCOPE("reader.mapTrainingEmails");
+    trainingViews_.clear();
+    trainingFieldText_.clear();
+    mapFile(spamFile_, spamFilePath_, "spam");
+    mapFile(hamFile_, hamFilePath_, "ham");
+
+    vector<EmailView> emails;
+    parseFile(spamFile_, emails, trainingFieldText_);
+    CsvParser::Stats spamStats = parser_.stats();
+    for (const auto& email : emails) {
+        trainingViews_.push_back(make_pair(email, true)); // Label as true for spam.
+    }
+    emails.clear();
+    parseFile(hamFile_, emails, trainingFieldText_);
+    for (const auto& email : emails) {
+        trainingViews_.push_back(make_pair(email, false)); // Label as false for ham.
+    }
+
+    parseStats_ = parser_.stats();
+    parseStats_.bytes += spamStats.bytes;
+    parseStats_.records += spamStats.records;
+    parseStats_.seconds += spamStats.seconds;
+}
+
+// Maps the test file and records views of its emails.
+void EmailReader::mapTestEmails() {
+    KNN_TIMED_SCOPE("reader.mapTestEmails");
+    testViews_.clear();
+    testFieldText_.clear();
+    mapFile(testFile_, testFilePath_, "test");
+    parseFile(testFile_, testViews_, testFieldText_);
+    parseStats_ = parser_.stats();
+}
+
+// Returns the training email views and their labels.
+const vector<pair<EmailView, bool>>& EmailReader::getTrainingViews() const {
+    return trainingViews_;
+}
+
+// Returns the test email views.
+const vector<EmailView>& EmailReader::getTestViews() const {
+    return testViews_;
+}
+
+// Bytes, records and time spent parsing by the most recent read or map call.
+CsvParser::Stats EmailReader::getParseStats() const {
+    return parseStats_;
+}
 
-    if (commaPos == string::npos) {
-        throw runtime_error("Invalid email format: " + line); // Error handling for incorrect format.
+// Prints the training email counts; the parse throughput of the last read goes to stderr.
+void EmailReader::reportTrainingEmails(int spamCount, int hamCount) const {
+    cout << "Total spam emails loaded: " << spamCount << endl;
+    cout << "Total ham emails loaded: " << hamCount << endl;
+
+    cout << "Total training emails loaded: " << spamCount + hamCount << endl;
+    cerr << "Parsed " << parseStats_.bytes / 1e6 << " MB of training CSV at " << parseStats_.megabytesPerSecond() << " MB/s" << endl;
+}
+
+// Maps a dataset file, reporting which dataset failed to open.
+void EmailReader::mapFile(MappedFile& file, const string& path, const string& kind) {
+    try {
+        file.open(path);
+    } catch (const runtime_error&) {
+        throw runtime_error("Failed to open " + kind + " file: " + path);
     }
+}
 
-    // Split the line into subject and message.
-    string subject = line.substr(0, commaPos);
-    string message = line.substr(commaPos + 1);
+// Parses a mapped file as RFC 4180 CSV, so quoted subjects and messages may contain commas,
+// escaped quotes and line breaks. The first record is the header.
+void EmailReader::parseFile(const MappedFile& file, vector<EmailView>& emails, deque<string>& fieldText) {
+    bool header = true;
+    parser_.parse(file.view(), [&](const vector<string_view>& fields) {
+        if (header) { // Skip header line.
+            header = false;
+            return;
+        }
+        if (fields.size() < 2) {
+            throw runtime_error("Invalid email format: " + string(fields[0])); // Error handling for incorrect format.
+        }
 
-    return make_pair(subject, message); // Return the parsed email.
+        EmailView email;
+        email.subject = keepField(fields[0], file, fieldText);
+        if (fields.size() == 2) {
+            email.message = keepField(fields[1], file, fieldText);
+        } else {
+            // Unquoted commas in the message split it into extra fields; join them back.
+            fieldText.push_back(string(fields[1]));
+            for (size_t i = 2; i < fields.size(); ++i) {
+                fieldText.back() += ",";
+                fieldText.back() += fields[i];
+            }
+            email.message = fieldText.back();
+        }
+        emails.push_back(email);
+    });
+    KNN_COUNT("reader.emails", emails.size());
+    KNN_COUNT("reader.bytes", file.size());
+}
+
+// Parses the file in chunks with the same record rules as parseFile and adds every email after
+// the header row to the corpus. The text buffer is reserved to the file size up front.
+size_t EmailReader::streamFile(const string& path, const string& kind, bool label, CorpusStore& corpus) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        throw runtime_error("Failed to open " + kind + " file: " + path);
+    }
+    size_t fileSize = static_cast<size_t>(in.tellg());
+    in.seekg(0);
+    corpus.reserve(0, corpus.textBytes() + fileSize);
+
+    size_t emails = 0;
+    bool header = true;
+    string joined;
+    parser_.parse(in, [&](const vector<string_view>& fields) {
+        if (header) { // Skip header line.
+            header = false;
+            return;
+        }
+        if (fields.size() < 2) {
+            throw runtime_error("Invalid email format: " + string(fields[0])); // Error handling for incorrect format.
+        }
+        string_view message = fields[1];
+        if (fields.size() > 2) {
+            // Unquoted commas in the message split it into extra fields; join them back.
+            joined.assign(fields[1].data(), fields[1].size());
+            for (size_t i = 2; i < fields.size(); ++i) {
+                joined += ",";
+                joined += fields[i];
+            }
+            message = joined;
+        }
+        corpus.add(fields[0], message, label);
+        ++emails;
+    });
+    KNN_COUNT("reader.emails", emails);
+    KNN_COUNT("reader.bytes", fileSize);
+    return emails;
+}
+
+// Returns a view of a field that outlives the parse.
+string_view EmailReader::keepField(string_view field, const MappedFile& file, deque<string>& fieldText) {
+    const char* begin = file.data();
+    if (begin != nullptr && field.data() >= begin && field.data() + field.size() <= begin + file.size()) {
+        return field;
+    }
+    fieldText.push_back(string(field));
+    return fieldText.back();
 }
@@ -2,15 +2,26 @@
 #define EMAILREADER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
+#include <deque>
+#include "MappedFile.h"
+#include "CsvParser.h"
+#include "CorpusStore.h"
 
 using namespace std;
 
+// Subject and message of one email, viewed in place inside a memory-mapped CSV file.
+struct EmailView {
+    string_view subject;
+    string_view message;
+};
+
 class EmailReader {
 public:
     // Constructor: Initializes an EmailReader with paths to spam, ham, and test email datasets.
@@ -23,10 +34,41 @@ public:
     void readTestEmails();
 
     // Retrieves the training data consisting of email subject, message, and label (spam/ham).
-    vector<pair<pair<string, string>, bool>> getTrainingData() const;
+    const vector<pair<pair<string, string>, bool>>& getTrainingData() const;
 
     // Retrieves the test data consisting of email subjects and messages.
-    vector<pair<string, string>> getTestData() const;
+    const vector<pair<string, string>>& getTestData() const;
+
+    // Reads the spam and ham files into the training corpus (spam first). The files are parsed
+    // in chunks rather than mapped, and the strings and views of earlier reads are released, so
+    // the corpus arena holds the only copy of the text.
+    void readTrainingCorpus();
+
+    // Reads the test file into the test corpus (all labeled ham), in the same way.
+    void readTestCorpus();
+
+    // Retrieves the training corpus filled by readTrainingCorpus.
+    const CorpusStore& getTrainingCorpus() const;
+
+    // Retrieves the test corpus filled by readTestCorpus.
+    const CorpusStore& getTestCorpus() const;
+
+    // Maps the spam and ham files into memory and records a view of every email's subject and
+    // message, without copying any text. The views stay valid until the files are mapped again
+    // or the reader is destroyed.
+    void mapTrainingEmails();
+
+    // Maps the test file into memory and records a view of every email.
+    void mapTestEmails();
+
+    // Retrieves the training email views and their labels (spam/ham).
+    const vector<pair<EmailView, bool>>& getTrainingViews() const;
+
+    // Retrieves the test email views.
+    const vector<EmailView>& getTestViews() const;
+
+    // Bytes, records and time spent parsing by the most recent read or map call.
+    CsvParser::Stats getParseStats() const;
 
 private:
     // File paths for spam, ham, and test email datasets.
@@ -34,14 +76,51 @@ private:
     string hamFilePath_;
     string testFilePath_;
 
+    // Memory mappings of the dataset files, referenced by the email views.
+    MappedFile spamFile_;
+    MappedFile hamFile_;
+    MappedFile testFile_;
+
     // Stores parsed training data: pairs of (subject, message) and spam/ham label.
     vector<pair<pair<string, string>, bool>> trainingData_;
 
     // Stores parsed test data: list of email subjects and messages.
     vector<pair<string, string>> testData_;
 
-    // Parses a single line from the email dataset and returns subject and message.
-    pair<string, string> parseLine(const string& line) const;
+    // Training and test emails stored once in arenas, with interned tokens.
+    CorpusStore trainingCorpus_;
+    CorpusStore testCorpus_;
+
+    // Views of the training emails with their labels, and of the test emails.
+    vector<pair<EmailView, bool>> trainingViews_;
+    vector<EmailView> testViews_;
+
+    // Text of fields that cannot be viewed inside the mapped file (those with escaped quotes).
+    deque<string> trainingFieldText_;
+    deque<string> testFieldText_;
+
+    // RFC 4180 parser shared by every read, and its statistics for the last read.
+    CsvParser parser_;
+    CsvParser::Stats parseStats_;
+
+    // Prints the number of spam, ham and training emails loaded, and the parse throughput as a
+    // diagnostic on stderr, so stdout keeps the program's original output.
+    void reportTrainingEmails(int spamCount, int hamCount) const;
+
+    // Maps a dataset file, throwing "Failed to open <kind> file" if it cannot be read.
+    static void mapFile(MappedFile& file, const string& path, const string& kind);
+
+    // Parses a mapped CSV file and records a view of every email after the header row.
+    // Field text that is not contiguous in the file is stored in fieldText.
+    void parseFile(const MappedFile& file, vector<EmailView>& emails, deque<string>& fieldText);
+
+    // Streams a CSV file into the corpus with the given label and returns the number of emails
+    // added. Throws "Failed to open <kind> file" if it cannot be read.
+    size_t streamFile(const string& path, const string& kind, bool label, CorpusStore& corpus);
+
+    // Returns a view of a field that outlives the parse: the field itself if it lies inside the
+    // mapped file, otherwise a copy kept in fieldText.
+    static string_view keepField(string_view field, const MappedFile& file, deque<string>& fieldText);
 };
 
 #endif // EMAILREADER_H
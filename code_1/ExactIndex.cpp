@@ -0,0 +1,261 @@
+#include "ExactIndex.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Constructor: Creates an empty index.
+ExactIndex::ExactIndex() : rowCount(0), binaryFeatures(false), featureCount(0), wordsPerRow(0) {}
+
+// Store the training vectors. Binary (0/1) feature sets are packed 64 features per word
+// instead of one double each.
+void ExactIndex::build(const vector<vector<double>>& features) {
+    rowCount = features.size();
+    featureCount = features.empty() ? 0 : features[0].size();
+    wordsPerRow = (featureCount + 63) / 64;
+
+    binaryFeatures = true;
+    for (const auto& row : features) {
+        if (row.size() != featureCount) {
+            throw invalid_argument("Training feature vectors must all have the same length");
+        }
+        binaryFeatures = binaryFeatures && isBinaryVector(row);
+    }
+
+    clearRemoved();
+    trainingFeatures = FeatureMatrix();
+    packedTrainingFeatures.clear();
+    if (binaryFeatures) {
+        packedTrainingFeatures.assign(rowCount * wordsPerRow, 0);
+        for (size_t i = 0; i < rowCount; ++i) {
+            packBinaryVector(features[i], &packedTrainingFeatures[i * wordsPerRow]);
+        }
+    } else {
+        trainingFeatures.assign(features);
+    }
+}
+
+// Adopt packed rows as they are; they are in the same layout as the packed store.
+void ExactIndex::buildPacked(const uint64_t* rows, size_t rowCount, size_t featureCount) {
+    this->rowCount = rowCount;
+    this->featureCount = featureCount;
+    wordsPerRow = (featureCount + 63) / 64;
+    binaryFeatures = true;
+    clearRemoved();
+    trainingFeatures = FeatureMatrix();
+    packedTrainingFeatures.assign(rows, rows + rowCount * wordsPerRow);
+}
+
+// Append a row in the current storage. The first row of an empty index fixes the dimensions;
+// a non-binary row unpacks a packed store into the dense matrix first.
+size_t ExactIndex::append(const vector<double>& features) {
+    if (rowCount == 0) {
+        featureCount = features.size();
+        wordsPerRow = (featureCount + 63) / 64;
+        binaryFeatures = true;
+        trainingFeatures = FeatureMatrix();
+        packedTrainingFeatures.clear();
+    } else if (features.size() != featureCount) {
+        throw invalid_argument("Training feature vectors must all have the same length");
+    }
+
+    bool binaryRow = isBinaryVector(features);
+    if (binaryFeatures && !binaryRow) {
+        trainingFeatures = unpackRows(0, rowCount);
+        packedTrainingFeatures.clear();
+        binaryFeatures = false;
+    }
+    if (binaryFeatures) {
+        packedTrainingFeatures.resize((rowCount + 1) * wordsPerRow, 0);
+        packBinaryVector(features, packedTrainingFeatures.data() + rowCount * wordsPerRow);
+    } else {
+        trainingFeatures.appendRow(features.data(), features.size());
+    }
+    return rowCount++;
+}
+
+// Copies the rows and the removal flags.
+shared_ptr<NeighborIndex> ExactIndex::clone() const {
+    return make_shared<ExactIndex>(*this);
+}
+
+// Finds the k nearest training rows with a bounded buffer ordered on (distance, index).
+// It holds squared distances (Hamming distances on the packed path), which rank exactly like
+// Euclidean distances since sqrt is monotonic.
+vector<Neighbor> ExactIndex::search(const vector<double>& query, size_t k) const {
+    NeighborBuffer neighbors(k);
+
+    if (binaryFeatures && isBinaryVector(query)) {
+        vector<uint64_t> packedEmail(wordsPerRow, 0);
+        packBinaryVector(query, packedEmail.data());
+
+        bool skipRemoved = removedCount() > 0;
+        for (size_t i = 0; i < rowCount; ++i) {
+            if (skipRemoved && isRemoved(i)) {
+                continue;
+            }
+            int distance = hammingDistance(packedEmail.data(), &packedTrainingFeatures[i * wordsPerRow]);
+            neighbors.offer(distance, static_cast<int>(i));
+            if (distance == 0 && neighbors.settled()) {
+                break;
+            }
+        }
+        return neighbors.neighbors();
+    }
+
+    // Dense scan over the contiguous matrix, shared with the batch path.
+    vector<vector<double>> single(1, query);
+    vector<vector<Neighbor>> results(1);
+    searchBlock(single, 0, 1, k, false, results);
+    return results[0];
+}
+
+// Search many emails at once with a blocked scan: for each block of queries, the training
+// rows are visited in cache-sized blocks and every query in the block is scored against a
+// training block before moving on. Each query still sees the rows in ascending order, so its
+// neighbors end up exactly as in search, including the early stop on k exact duplicates.
+vector<vector<Neighbor>> ExactIndex::searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool) const {
+    vector<vector<Neighbor>> results(queries.size());
+
+    bool packedQueries = binaryFeatures;
+    for (const auto& query : queries) {
+        packedQueries = packedQueries && isBinaryVector(query);
+    }
+
+    // Query blocks are independent, so with a pool each worker takes whole blocks and writes
+    // its results by index; the output is identical to the single-threaded scan.
+    size_t blocks = (queries.size() + queryBlockSize - 1) / queryBlockSize;
+    auto runBlocks = [&](size_t firstBlock, size_t lastBlock) {
+        for (size_t b = firstBlock; b < lastBlock; ++b) {
+            size_t q0 = b * queryBlockSize;
+            searchBlock(queries, q0, min(queries.size(), q0 + queryBlockSize), k, packedQueries, results);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(blocks, 1, runBlocks);
+    } else {
+        runBlocks(0, blocks);
+    }
+    return results;
+}
+
+// Score queries [q0, q1) against the training set one cache-sized block of rows at a time.
+// A query that has found k exact duplicates sits out the remaining blocks, and the scan ends
+// when every query in the block has (duplicate-heavy batches such as spam campaigns).
+void ExactIndex::searchBlock(const vector<vector<double>>& queries, size_t q0, size_t q1, size_t k, bool packedQueries, vector<vector<Neighbor>>& results) const {
+    size_t rowBytes = packedQueries ? wordsPerRow * sizeof(uint64_t) : featureCount * sizeof(double);
+    size_t rowBlockSize = max<size_t>(1, trainingBlockBytes / max<size_t>(1, rowBytes));
+    vector<NeighborBuffer> neighbors(q1 - q0, NeighborBuffer(k));
+    size_t unsettled = q1 - q0;
+    // Removed rows are rare, so they are only looked up when there are any.
+    bool skipRemoved = removedCount() > 0;
+
+    if (packedQueries) {
+        // Pack the query block once; it stays in L1 while the training blocks stream past.
+        vector<uint64_t> packedBlock((q1 - q0) * wordsPerRow, 0);
+        for (size_t q = q0; q < q1; ++q) {
+            packBinaryVector(queries[q], &packedBlock[(q - q0) * wordsPerRow]);
+        }
+
+        for (size_t r0 = 0; r0 < rowCount && unsettled > 0; r0 += rowBlockSize) {
+            size_t r1 = min(rowCount, r0 + rowBlockSize);
+            for (size_t q = 0; q < q1 - q0; ++q) {
+                if (neighbors[q].settled()) {
+                    continue;
+                }
+                const uint64_t* packedEmail = &packedBlock[q * wordsPerRow];
+                for (size_t i = r0; i < r1; ++i) {
+                    if (skipRemoved && isRemoved(i)) {
+                        continue;
+                    }
+                    int distance = hammingDistance(packedEmail, &packedTrainingFeatures[i * wordsPerRow]);
+                    neighbors[q].offer(distance, static_cast<int>(i));
+                    if (distance == 0 && neighbors[q].settled()) {
+                        --unsettled;
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        // Binary training rows are unpacked one block at a time and shared by the query block.
+        for (size_t r0 = 0; r0 < rowCount && unsettled > 0; r0 += rowBlockSize) {
+            size_t r1 = min(rowCount, r0 + rowBlockSize);
+            FeatureMatrix unpacked = binaryFeatures ? unpackRows(r0, r1) : FeatureMatrix();
+            for (size_t q = 0; q < q1 - q0; ++q) {
+                if (neighbors[q].settled()) {
+                    continue;
+                }
+                const double* email = queries[q0 + q].data();
+                for (size_t i = r0; i < r1; ++i) {
+                    if (skipRemoved && isRemoved(i)) {
+                        continue;
+                    }
+                    const double* trainingRow = binaryFeatures ? unpacked.row(i - r0) : trainingFeatures.row(i);
+                    double distance = computeDistance(email, trainingRow);
+                    neighbors[q].offer(distance, static_cast<int>(i));
+                    if (distance == 0.0 && neighbors[q].settled()) {
+                        --unsettled;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for (size_t q = 0; q < q1 - q0; ++q) {
+        results[q0 + q] = neighbors[q].neighbors();
+    }
+}
+
+// Number of indexed training rows.
+size_t ExactIndex::size() const {
+    return rowCount;
+}
+
+// Length of the vectors the index was built from.
+size_t ExactIndex::dimensions() const {
+    return featureCount;
+}
+
+// The brute-force scan is always exact.
+bool ExactIndex::isExact() const {
+    return true;
+}
+
+// Short description of the backend.
+string ExactIndex::name() const {
+    return binaryFeatures ? "exact (packed binary)" : "exact (dense)";
+}
+
+// Bytes held by the index.
+size_t ExactIndex::memoryBytes() const {
+    return trainingFeatures.memoryBytes() + packedTrainingFeatures.capacity() * sizeof(uint64_t);
+}
+
+// Returns true if the training rows are stored as packed binary vectors.
+bool ExactIndex::usesBinaryFeatures() const {
+    return binaryFeatures;
+}
+
+// Compute the squared Euclidean distance between two feature vectors with the dispatched SIMD kernel.
+double ExactIndex::computeDistance(const double* email1, const double* email2) const {
+    return DistanceKernels::squaredDistance(email1, email2, featureCount);
+}
+
+// Count the differing bits between two packed rows with XOR + popcount.
+int ExactIndex::hammingDistance(const uint64_t* email1, const uint64_t* email2) const {
+    return DistanceKernels::hammingDistance(email1, email2, wordsPerRow);
+}
+
+// Unpack training rows [r0, r1) into a dense matrix.
+FeatureMatrix ExactIndex::unpackRows(size_t r0, size_t r1) const {
+    FeatureMatrix unpacked(r1 - r0, featureCount);
+    for (size_t i = r0; i < r1; ++i) {
+        const uint64_t* words = &packedTrainingFeatures[i * wordsPerRow];
+        double* row = unpacked.row(i - r0);
+        for (size_t j = 0; j < featureCount; ++j) {
+            row[j] = (words[j / 64] >> (j % 64)) & 1 ? 1.0 : 0.0;
+        }
+    }
+    return unpacked;
+}
@@ -0,0 +1,89 @@
+#ifndef EXACTINDEX_H
+#define EXACTINDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "NeighborIndex.h"
+#include "NeighborBuffer.h"
+#include "FeatureMatrix.h"
+#include "DistanceKernels.h"
+
+using namespace std;
+
+// Exact brute-force backend: every query is compared with every training row.
+// Binary (0/1) training sets are packed 64 features per word and compared with XOR + popcount;
+// other training sets live in a contiguous FeatureMatrix and use the SIMD squared distance.
+class ExactIndex : public NeighborIndex {
+public:
+    // Constructor: Creates an empty index.
+    ExactIndex();
+
+    // Stores the training vectors, packed if they are all binary.
+    void build(const vector<vector<double>>& features) override;
+
+    // Copies already packed binary rows directly into the packed store.
+    void buildPacked(const uint64_t* rows, size_t rowCount, size_t featureCount) override;
+
+    // Appends a row to the packed store, or to the dense matrix (switching to it if the row
+    // is not binary).
+    size_t append(const vector<double>& features) override;
+
+    shared_ptr<NeighborIndex> clone() const override;
+
+    // Scans the rows in order and keeps the k nearest; stops early once k exact duplicates of
+    // the query are found, since no later row can displace them.
+    vector<Neighbor> search(const vector<double>& query, size_t k) const override;
+
+    // Scans blocks of queries against cache-sized blocks of training rows; the result for each
+    // query is the same as search.
+    vector<vector<Neighbor>> searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool = nullptr) const override;
+
+    size_t size() const override;
+    size_t dimensions() const override;
+    bool isExact() const override;
+    string name() const override;
+    size_t memoryBytes() const override;
+
+    // Returns true if the training rows are stored as packed binary vectors.
+    bool usesBinaryFeatures() const;
+
+private:
+    // Number of training rows.
+    size_t rowCount;
+
+    // Stores training feature vectors in one contiguous matrix (only used when the features are not binary).
+    FeatureMatrix trainingFeatures;
+
+    // True when every training feature is 0.0 or 1.0 and the rows are stored packed.
+    bool binaryFeatures;
+
+    // Number of feature dimensions in each training vector.
+    size_t featureCount;
+
+    // Number of 64-bit words used by one packed training row.
+    size_t wordsPerRow;
+
+    // Packed training rows, wordsPerRow words per email, one bit per feature.
+    vector<uint64_t, AlignedAllocator<uint64_t>> packedTrainingFeatures;
+
+    // Number of queries processed together by searchBatch.
+    static const size_t queryBlockSize = 32;
+
+    // Approximate bytes of training rows scanned per block by searchBatch (sized for L2 cache).
+    static const size_t trainingBlockBytes = 128 * 1024;
+
+    // Searches queries [q0, q1) of a batch into results[q0, q1).
+    void searchBlock(const vector<vector<double>>& queries, size_t q0, size_t q1, size_t k, bool packedQueries, vector<vector<Neighbor>>& results) const;
+
+    // Computes the squared Euclidean distance between two feature vectors of featureCount values.
+    double computeDistance(const double* email1, const double* email2) const;
+
+    // Counts the differing bits between two packed rows (the squared Euclidean distance of binary vectors).
+    int hammingDistance(const uint64_t* email1, const uint64_t* email2) const;
+
+    // Unpacks training rows [r0, r1) into a dense matrix.
+    FeatureMatrix unpackRows(size_t r0, size_t r1) const;
+};
+
+#endif // EXACTINDEX_H
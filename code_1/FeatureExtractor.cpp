@@ -1,26 +1,10 @@
 #include "FeatureExtractor.h"
-
-// Converts a string to lowercase for case-insensitive processing.
-string FeatureExtractor::toLower(const string& str) {
-    string lowerStr = str;
-    transform(lowerStr.begin(), lowerStr.end(), lowerStr.begin(), ::tolower);
-    return lowerStr;
-}
+#include "Metrics.h"
 
 // Tokenizes an email string into individual words, removing non-alphabetic characters.
 vector<string> FeatureExtractor::tokenizeEmail(const string& email) {
-    vector<string> tokens;
-    string token;
-    istringstream emailStream(email);
-
-    while (emailStream >> token) {
-        // Remove non-alphabetic characters and convert to lowercase.
-        token.erase(remove_if(token.begin(), token.end(), [](char c) { return !isalpha(c); }), token.end());
-        if (!token.empty()) {
-            tokens.push_back(toLower(token));
-        }
-    }
-    return tokens;
+    Tokenizer tokenizer;
+    return tokenizer.tokenize(email);
 }
 
 // Builds a frequency map of words from the given list of tokens.
@@ -35,123 +19,314 @@ map<string, int> FeatureExtractor::buildFrequencyMap(const vector<string>& token
 
 // Selects the top N frequent words from the frequency map.
 vector<string> FeatureExtractor::selectTopFeatures(const map<string, int>& freqMap, int N) {
-    vector<pair<string, int>> pairs;
-    for (const auto& it : freqMap) {
-        pairs.push_back(it);
-    }
-
-    // Sort pairs based on frequency, in descending order.
-    sort(pairs.begin(), pairs.end(), [](const pair<string, int>& a, const pair<string, int>& b) {
-        return a.second > b.second;
-    });
+    vector<pair<string, int>> pairs(freqMap.begin(), freqMap.end());
+    rankWords(pairs, N > 0 ? N : 0);
 
     vector<string> topFeatures;
-    // Select the top N features.
-    for (int i = 0; i < static_cast<int>(N) && i < pairs.size(); ++i) {
-        topFeatures.push_back(pairs[i].first);
+    for (auto& pair : pairs) {
+        topFeatures.push_back(move(pair.first));
     }
-
     return topFeatures;
 }
 
-// Converts email tokens into a feature vector based on the presence of top features.
-vector<double> FeatureExtractor::emailToFeatureVector(const vector<string>& emailTokens, const vector<string>& topFeatures) {
-    vector<double> featureVector(topFeatures.size(), 0.0);
-    set<string> uniqueTokens(emailTokens.begin(), emailTokens.end());
+// Orders words by count (descending), then alphabetically.
+static bool moreFrequent(const pair<string, int>& a, const pair<string, int>& b) {
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+}
 
-    // Create a binary feature vector indicating the presence of top features in the email.
-    for (int i = 0; i < topFeatures.size(); ++i) {
-        if (uniqueTokens.find(topFeatures[i]) != uniqueTokens.end()) {
-            featureVector[i] = 1.0; // Set to 1 if the top feature is present in the email.
+// Keeps the m highest-ranked words: nth_element moves them to the front in linear time, and
+// only those m are sorted.
+void FeatureExtractor::rankWords(vector<pair<string, int>>& wordCounts, size_t m) {
+    if (m < wordCounts.size()) {
+        nth_element(wordCounts.begin(), wordCounts.begin() + m, wordCounts.end(), moreFrequent);
+        wordCounts.resize(m);
+    }
+    sort(wordCounts.begin(), wordCounts.end(), moreFrequent);
+}
+
+// Map step: every shard tokenizes its slice of the emails into its own hash maps, one per
+// (label, partition). Reduce step: every partition is merged across shards independently.
+void FeatureExtractor::countTrainingWords(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool, vector<pair<string, int>>& spamCounts, vector<pair<string, int>>& hamCounts) {
+    const Vocabulary& excluded = excludedWords();
+    size_t workers = pool != nullptr ? pool->size() : 1;
+    size_t partitions = workers;
+    // A few shards per worker so that stealing can balance uneven emails.
+    size_t shards = max<size_t>(1, min(trainingData.size(), workers > 1 ? workers * 4 : 1));
+
+    // counts[shard][label][partition]; label 0 is spam, 1 is ham.
+    typedef vector<unordered_map<string, int>> PartitionedCounts;
+    vector<vector<PartitionedCounts>> counts(shards, vector<PartitionedCounts>(2, PartitionedCounts(partitions)));
+
+    auto countShards = [&](size_t begin, size_t end) {
+        Tokenizer tokenizer;
+        string key;
+        for (size_t shard = begin; shard < end; ++shard) {
+            size_t first = trainingData.size() * shard / shards;
+            size_t last = trainingData.size() * (shard + 1) / shards;
+            for (size_t i = first; i < last; ++i) {
+                PartitionedCounts& labelCounts = counts[shard][trainingData[i].second ? 0 : 1];
+                auto countToken = [&](string_view token, uint64_t hash) {
+                    // Increment frequency count, excluding common words.
+                    if (excluded.find(token, hash) < 0) {
+                        key.assign(token.data(), token.size());
+                        labelCounts[hash % partitions][key]++;
+                    }
+                };
+                tokenizer.scan(trainingData[i].first.first, countToken);
+                tokenizer.scan(trainingData[i].first.second, countToken);
+            }
+        }
+    };
+
+    auto mergePartitions = [&](size_t begin, size_t end) {
+        for (size_t partition = begin; partition < end; ++partition) {
+            for (size_t label = 0; label < 2; ++label) {
+                unordered_map<string, int>& total = counts[0][label][partition];
+                for (size_t shard = 1; shard < shards; ++shard) {
+                    for (auto& wordCount : counts[shard][label][partition]) {
+                        total[wordCount.first] += wordCount.second;
+                    }
+                    unordered_map<string, int>().swap(counts[shard][label][partition]);
+                }
+            }
         }
+    };
+
+    if (pool != nullptr) {
+        pool->parallelFor(shards, 1, countShards);
+        pool->parallelFor(partitions, 1, mergePartitions);
+    } else {
+        countShards(0, shards);
+        mergePartitions(0, partitions);
     }
 
-    return featureVector;
+    // Partitions hold disjoint words, so concatenating them gives the complete counts.
+    spamCounts.clear();
+    hamCounts.clear();
+    for (size_t partition = 0; partition < partitions; ++partition) {
+        for (auto& wordCount : counts[0][0][partition]) {
+            spamCounts.emplace_back(wordCount.first, wordCount.second);
+        }
+        for (auto& wordCount : counts[0][1][partition]) {
+            hamCounts.emplace_back(wordCount.first, wordCount.second);
+        }
+    }
 }
 
+// Scans the text once, looking each token up by its hash; no token is copied or allocated.
+void FeatureExtractor::markFeatures(string_view text, const Vocabulary& vocabulary, Tokenizer& tokenizer, vector<double>& featureVector) {
+    tokenizer.scan(text, [&](string_view token, uint64_t hash) {
+        for (int i = vocabulary.find(token, hash); i >= 0; i = vocabulary.nextDuplicate(i)) {
+            featureVector[i] = 1.0; // Set to 1 if the top feature is present in the email.
+        }
+    });
+}
 
 // Extracts feature vector from an email based on the top features.
 vector<double> FeatureExtractor::extractFeatures(const string& emailSubject, const string& emailMessage, const vector<string>& topFeatures) {
-    // Combining subject and message into one string.
-    string fullEmail = emailSubject + " " + emailMessage;
-    // Tokenizing the email into words.
-    auto tokens = tokenizeEmail(fullEmail);
-    // Converting the tokens into a feature vector based on the top features.
-    return emailToFeatureVector(tokens, topFeatures);
+    return extractFeatures(emailSubject, emailMessage, Vocabulary(topFeatures));
 }
 
-// Extracts a balanced set of top features from the training data.
-vector<string> FeatureExtractor::extractBalancedTopFeatures(const vector<pair<pair<string, string>, bool>>& trainingData, int N) {
+// Extracts a binary feature vector; the subject and message are scanned separately, which
+// gives the same tokens as scanning them joined by a space.
+vector<double> FeatureExtractor::extractFeatures(string_view emailSubject, string_view emailMessage, const Vocabulary& vocabulary) {
+    KNN_TIMED_SCOPE("extractor.extractFeatures");
+    vector<double> featureVector(vocabulary.size(), 0.0);
+    Tokenizer tokenizer;
+    markFeatures(emailSubject, vocabulary, tokenizer, featureVector);
+    markFeatures(emailMessage, vocabulary, tokenizer, featureVector);
+    return featureVector;
+}
+
+// Each worker writes its own slots, so the order (and every value) matches extracting the
+// emails one by one.
+template <typename MarkEmail>
+vector<vector<double>> FeatureExtractor::extractEmails(size_t count, size_t featureCount, const MarkEmail& markEmail, ThreadPool* pool) {
+    KNN_TIMED_SCOPE("extractor.extractFeaturesBatch");
+    KNN_COUNT("extractor.batchEmails", count);
+    vector<vector<double>> features(count);
+    auto extractRange = [&](size_t begin, size_t end) {
+        Tokenizer tokenizer;
+        for (size_t i = begin; i < end; ++i) {
+            features[i].assign(featureCount, 0.0);
+            markEmail(i, tokenizer, features[i]);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(count, 64, extractRange);
+    } else {
+        extractRange(0, count);
+    }
+    return features;
+}
+
+// Extracts feature vectors for a list of emails. The vocabulary table is built once.
+vector<vector<double>> FeatureExtractor::extractFeaturesBatch(const vector<pair<string, string>>& emails, const vector<string>& topFeatures, ThreadPool* pool) {
+    Vocabulary vocabulary(topFeatures);
+    return extractEmails(emails.size(), vocabulary.size(), [&](size_t i, Tokenizer& tokenizer, vector<double>& featureVector) {
+        markFeatures(emails[i].first, vocabulary, tokenizer, featureVector);
+        markFeatures(emails[i].second, vocabulary, tokenizer, featureVector);
+    }, pool);
+}
+
+// Extracts feature vectors for labeled training data, in input order.
+vector<vector<double>> FeatureExtractor::extractFeaturesBatch(const vector<pair<pair<string, string>, bool>>& trainingData, const vector<string>& topFeatures, ThreadPool* pool) {
+    Vocabulary vocabulary(topFeatures);
+    return extractEmails(trainingData.size(), vocabulary.size(), [&](size_t i, Tokenizer& tokenizer, vector<double>& featureVector) {
+        markFeatures(trainingData[i].first.first, vocabulary, tokenizer, featureVector);
+        markFeatures(trainingData[i].first.second, vocabulary, tokenizer, featureVector);
+    }, pool);
+}
+
+// Extracts feature vectors for the emails of a corpus, in order. The column of every token id
+// is resolved once, so marking an email's features is one table lookup per token.
+vector<vector<double>> FeatureExtractor::extractFeaturesBatch(const CorpusStore& corpus, const vector<string>& topFeatures, ThreadPool* pool) {
+    Vocabulary vocabulary(topFeatures);
+    vector<int> columns = featureColumns(corpus, vocabulary);
+    return extractEmails(corpus.size(), vocabulary.size(), [&](size_t i, Tokenizer&, vector<double>& featureVector) {
+        const uint32_t* tokens = corpus.tokens(i);
+        size_t tokenCount = corpus.tokenCount(i);
+        for (size_t t = 0; t < tokenCount; ++t) {
+            for (int column = columns[tokens[t]]; column >= 0; column = vocabulary.nextDuplicate(column)) {
+                featureVector[column] = 1.0;
+            }
+        }
+    }, pool);
+}
+
+// Looks every interned token up in the vocabulary with its stored hash.
+vector<int> FeatureExtractor::featureColumns(const CorpusStore& corpus, const Vocabulary& vocabulary) {
+    vector<int> columns(corpus.vocabularySize());
+    for (size_t id = 0; id < columns.size(); ++id) {
+        columns[id] = vocabulary.find(corpus.token(static_cast<uint32_t>(id)), corpus.tokenHash(static_cast<uint32_t>(id)));
+    }
+    return columns;
+}
+
+// Collects the columns of the email's tokens and removes repeats.
+vector<int> FeatureExtractor::presentFeatures(const CorpusStore& corpus, size_t email, const vector<int>& columns, const Vocabulary& vocabulary) {
+    vector<int> present;
+    const uint32_t* tokens = corpus.tokens(email);
+    size_t tokenCount = corpus.tokenCount(email);
+    for (size_t t = 0; t < tokenCount; ++t) {
+        for (int column = columns[tokens[t]]; column >= 0; column = vocabulary.nextDuplicate(column)) {
+            present.push_back(column);
+        }
+    }
+    sort(present.begin(), present.end());
+    present.erase(unique(present.begin(), present.end()), present.end());
+    return present;
+}
+
+// The common-word list, built once.
+const Vocabulary& FeatureExtractor::excludedWords() {
     // List of common words to be excluded from feature selection.
-    set<string> excludedWords = {"if", "is", "these", "in", "this", "on", "of", "with", "our", "the", "you", "for", "a", "and", "your", "to", "out", "at", "be", "here", "just", "im", "or", "youre", "are", "have", "dont", "can", "any", "me", "some", "we", "about", "around", "as", "before", "during", "from", "how", "into", "off", "over", "so", "up", "without", "been", "being", "could", "do", "get", "has", "know", "make", "may", "see", "take", "want", "will", "all", "each", "every", "few", "many", "most", "other", "such", "they", "this", "those", "which", "i", "ive", "let", "lets", "were", "", " "};
-
-    // Maps to track word frequency separately for spam and ham emails.
-    map<string, int> frequencyMapSpam, frequencyMapHam;
-
-    // Iterating over training data to build frequency maps.
-    for (const auto& data : trainingData) {
-        string fullEmail = data.first.first + " " + data.first.second;
-        auto tokens = tokenizeEmail(fullEmail);
-
-        // Increment frequency count, excluding common words.
-        for (const auto& token : tokens) {
-            if (excludedWords.find(token) == excludedWords.end()) {
-                if (data.second) {
-                    frequencyMapSpam[token]++;
-                } else {
-                    frequencyMapHam[token]++;
+    static const Vocabulary words(vector<string>{"if", "is", "these", "in", "this", "on", "of", "with", "our", "the", "you", "for", "a", "and", "your", "to", "out", "at", "be", "here", "just", "im", "or", "youre", "are", "have", "dont", "can", "any", "me", "some", "we", "about", "around", "as", "before", "during", "from", "how", "into", "off", "over", "so", "up", "without", "been", "being", "could", "do", "get", "has", "know", "make", "may", "see", "take", "want", "will", "all", "each", "every", "few", "many", "most", "other", "such", "they", "this", "those", "which", "i", "ive", "let", "lets", "were", "", " "});
+    return words;
+}
+
+// Extracts a balanced set of top features from the training data.
+vector<string> FeatureExtractor::extractBalancedTopFeatures(const vector<pair<pair<string, string>, bool>>& trainingData, int N, ThreadPool* pool) {
+    KNN_TIMED_SCOPE("extractor.extractBalancedTopFeatures");
+    // Word frequencies counted separately for spam and ham emails.
+    vector<pair<string, int>> frequencySpam, frequencyHam;
+    countTrainingWords(trainingData, pool, frequencySpam, frequencyHam);
+    return selectBalancedTopFeatures(frequencySpam, frequencyHam, N);
+}
+
+// Map step: every worker counts a contiguous range of emails into its own per-id arrays.
+// Reduce step: the arrays are summed into the first worker's, split by id range. Common words
+// are dropped once per distinct token rather than once per occurrence.
+vector<string> FeatureExtractor::extractBalancedTopFeatures(const CorpusStore& corpus, int N, ThreadPool* pool) {
+    KNN_TIMED_SCOPE("extractor.extractBalancedTopFeatures");
+    size_t vocabularySize = corpus.vocabularySize();
+    size_t shards = max<size_t>(1, min(corpus.size(), pool != nullptr ? pool->size() : 1));
+
+    // counts[shard][label][id]; label 0 is spam, 1 is ham.
+    vector<vector<vector<int>>> counts(shards, vector<vector<int>>(2));
+    auto countShards = [&](size_t begin, size_t end) {
+        for (size_t shard = begin; shard < end; ++shard) {
+            counts[shard][0].assign(vocabularySize, 0);
+            counts[shard][1].assign(vocabularySize, 0);
+            size_t first = corpus.size() * shard / shards;
+            size_t last = corpus.size() * (shard + 1) / shards;
+            for (size_t i = first; i < last; ++i) {
+                vector<int>& labelCounts = counts[shard][corpus.label(i) ? 0 : 1];
+                const uint32_t* tokens = corpus.tokens(i);
+                size_t tokenCount = corpus.tokenCount(i);
+                for (size_t t = 0; t < tokenCount; ++t) {
+                    labelCounts[tokens[t]]++;
+                }
+            }
+        }
+    };
+    auto mergeIds = [&](size_t begin, size_t end) {
+        for (size_t shard = 1; shard < shards; ++shard) {
+            for (size_t label = 0; label < 2; ++label) {
+                for (size_t id = begin; id < end; ++id) {
+                    counts[0][label][id] += counts[shard][label][id];
                 }
             }
         }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(shards, 1, countShards);
+        pool->parallelFor(vocabularySize, 4096, mergeIds);
+    } else {
+        countShards(0, shards);
+        mergeIds(0, vocabularySize);
     }
 
-    // Lambda function to extract top N features from a frequency map.
-    auto extractTop = [&](const map<string, int>& freqMap, int halfN) {
-        // Sorting the frequency map to find top features.
-        vector<pair<string, int>> freqVec(freqMap.begin(), freqMap.end());
-        sort(freqVec.begin(), freqVec.end(), [](const pair<string, int>& a, const pair<string, int>& b) {
-            return a.second > b.second;
-        });
-
-        // Collecting the top features.
-        vector<string> top;
-        for (int i = 0; i < static_cast<int>(halfN) && i < freqVec.size(); i++) {
-            top.push_back(freqVec[i].first);
+    // Word frequencies counted separately for spam and ham emails.
+    const Vocabulary& excluded = excludedWords();
+    vector<pair<string, int>> frequencySpam, frequencyHam;
+    for (size_t id = 0; id < vocabularySize; ++id) {
+        string_view token = corpus.token(static_cast<uint32_t>(id));
+        if (excluded.find(token, corpus.tokenHash(static_cast<uint32_t>(id))) >= 0) {
+            continue;
         }
-        return top;
-    };
+        if (counts[0][0][id] > 0) {
+            frequencySpam.emplace_back(string(token), counts[0][0][id]);
+        }
+        if (counts[0][1][id] > 0) {
+            frequencyHam.emplace_back(string(token), counts[0][1][id]);
+        }
+    }
+    return selectBalancedTopFeatures(frequencySpam, frequencyHam, N);
+}
 
-    // Extracting top features for both spam and ham emails.
-    vector<string> topSpamFeatures = extractTop(frequencyMapSpam, N / 2);
-    vector<string> topHamFeatures = extractTop(frequencyMapHam, N / 2);
+// Takes the top N / 2 words of each label and tops the set up to N words.
+vector<string> FeatureExtractor::selectBalancedTopFeatures(vector<pair<string, int>>& frequencySpam, vector<pair<string, int>>& frequencyHam, int N) {
+    // Only the head of each ranking is ever read: N / 2 top words, and while topping up the
+    // combined set at most N words that are already in it plus the N it still needs.
+    size_t target = N > 0 ? static_cast<size_t>(N) : 0;
+    rankWords(frequencySpam, 2 * target);
+    rankWords(frequencyHam, 2 * target);
 
     // Combining and deduplicating top features from both categories.
-    set<string> combinedTopFeatures(topSpamFeatures.begin(), topSpamFeatures.end());
-    combinedTopFeatures.insert(topHamFeatures.begin(), topHamFeatures.end());
+    set<string> combinedTopFeatures;
+    size_t halfN = target / 2;
+    for (size_t i = 0; i < halfN && i < frequencySpam.size(); ++i) {
+        combinedTopFeatures.insert(frequencySpam[i].first);
+    }
+    for (size_t i = 0; i < halfN && i < frequencyHam.size(); ++i) {
+        combinedTopFeatures.insert(frequencyHam[i].first);
+    }
 
     // Adding additional features if the combined set is less than N.
-    int additionalNeeded = N - combinedTopFeatures.size();
-    auto addAdditionalFeatures = [&](const map<string, int>& freqMap) {
-        vector<pair<string, int>> freqVec(freqMap.begin(), freqMap.end());
-        sort(freqVec.begin(), freqVec.end(), [](const pair<string, int>& a, const pair<string, int>& b) {
-            return a.second > b.second;
-        });
-
+    auto addAdditionalFeatures = [&](const vector<pair<string, int>>& ranked) {
         // Inserting additional features while ensuring uniqueness.
-        for (const auto& pair : freqVec) {
-            if (combinedTopFeatures.size() >= N) break;
-            if (combinedTopFeatures.find(pair.first) == combinedTopFeatures.end()) {
-                combinedTopFeatures.insert(pair.first);
-            }
+        for (const auto& pair : ranked) {
+            if (combinedTopFeatures.size() >= target) break;
+            combinedTopFeatures.insert(pair.first);
         }
     };
 
-    if (additionalNeeded > 0) {
-        addAdditionalFeatures(frequencyMapSpam);
-        addAdditionalFeatures(frequencyMapHam);
+    if (combinedTopFeatures.size() < target) {
+        addAdditionalFeatures(frequencySpam);
+        addAdditionalFeatures(frequencyHam);
     }
 
     // Returning the final list of top features.
     return vector<string>(combinedTopFeatures.begin(), combinedTopFeatures.end());
 }
-
@@ -4,12 +4,18 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <utility> 
 #include <algorithm>
 #include <sstream>
 #include <set>
 #include <cctype>
 #include <iostream>
+#include <string_view>
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+#include "Vocabulary.h"
+#include "CorpusStore.h"
 
 using namespace std;
 
@@ -18,16 +24,55 @@ public:
     // Extracts features from an email subject and message.
     vector<double> extractFeatures(const string& emailSubject, const string& emailMessage, const vector<string>& topFeatures);
 
+    // Extracts features against a prebuilt vocabulary of the top features; use this when
+    // extracting many emails so the vocabulary table is built only once.
+    vector<double> extractFeatures(string_view emailSubject, string_view emailMessage, const Vocabulary& vocabulary);
+
+    // Extracts feature vectors for a list of emails, in input order. If a pool is given the
+    // emails are split across its workers; the vectors are identical to the serial result.
+    vector<vector<double>> extractFeaturesBatch(const vector<pair<string, string>>& emails, const vector<string>& topFeatures, ThreadPool* pool = nullptr);
+
+    // Same as above for labeled training data; the labels are ignored.
+    vector<vector<double>> extractFeaturesBatch(const vector<pair<pair<string, string>, bool>>& trainingData, const vector<string>& topFeatures, ThreadPool* pool = nullptr);
+
+    // Same as above for the emails of a corpus, working from their token ids: each distinct
+    // token is looked up once, and the text is not scanned again.
+    vector<vector<double>> extractFeaturesBatch(const CorpusStore& corpus, const vector<string>& topFeatures, ThreadPool* pool = nullptr);
+
     // Extracts a balanced set of top features from training data for spam and ham emails.
-    vector<string> extractBalancedTopFeatures(const vector<pair<pair<string, string>, bool>>& trainingData, int N);
+    // Words with equal counts are ranked alphabetically. If a pool is given the word counting
+    // is split across its workers; the result is identical to the serial one.
+    vector<string> extractBalancedTopFeatures(const vector<pair<pair<string, string>, bool>>& trainingData, int N, ThreadPool* pool = nullptr);
+
+    // Same as above for a labeled corpus: the words are counted per token id in flat arrays
+    // (one per worker, summed in parallel) and only the distinct words become strings.
+    vector<string> extractBalancedTopFeatures(const CorpusStore& corpus, int N, ThreadPool* pool = nullptr);
+
+    // Selects the balanced top N features from precounted spam and ham word frequencies (the
+    // selection step of extractBalancedTopFeatures). Reorders and shrinks both lists.
+    vector<string> selectBalancedTopFeatures(vector<pair<string, int>>& frequencySpam, vector<pair<string, int>>& frequencyHam, int N);
+
+    // Counts the words of the spam and ham training emails, excluding excludedWords(), as
+    // unsorted (word, count) lists for selectBalancedTopFeatures. The data is split into shards
+    // counted in thread-local hash maps; each shard's maps are partitioned by word hash so the
+    // partitions can be merged in parallel.
+    void countTrainingWords(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool, vector<pair<string, int>>& spamCounts, vector<pair<string, int>>& hamCounts);
+
+    // Feature index of every token id of a corpus, or -1 for tokens that are not features.
+    // Repeated feature words are reached through vocabulary.nextDuplicate.
+    static vector<int> featureColumns(const CorpusStore& corpus, const Vocabulary& vocabulary);
+
+    // Feature indices of the words an email of the corpus contains, in increasing order; these
+    // are the non-zero entries of its feature vector.
+    static vector<int> presentFeatures(const CorpusStore& corpus, size_t email, const vector<int>& columns, const Vocabulary& vocabulary);
+
+    // Common words that are never used as features.
+    static const Vocabulary& excludedWords();
 
     // Analyzes features of nearest neighbors and returns a summary.
     string analyzeFeaturesOfNeighbors(const vector<int>& neighborIndices, const vector<vector<double>>& trainingFeatures, const vector<string>& topFeatures);
 
 private:
-    // Converts a string to lowercase.
-    string toLower(const string& str);
-
     // Tokenizes an email into a list of words, cleaning it in the process.
     vector<string> tokenizeEmail(const string& email);
 
@@ -37,8 +82,18 @@ private:
     // Selects the top N words from a frequency map based on their occurrence.
     vector<string> selectTopFeatures(const map<string, int>& freqMap, int N);
 
-    // Converts a list of email tokens into a feature vector based on the top features.
-    vector<double> emailToFeatureVector(const vector<string>& emailTokens, const vector<string>& topFeatures);
+    // Reduces word counts to the m most frequent words, most frequent first (ties alphabetical),
+    // using partial selection instead of sorting every word.
+    static void rankWords(vector<pair<string, int>>& wordCounts, size_t m);
+
+    // Sets the feature of every vocabulary word found in the text to 1.
+    void markFeatures(string_view text, const Vocabulary& vocabulary, Tokenizer& tokenizer, vector<double>& featureVector);
+
+    // Extracts count feature vectors of featureCount zeros, in input order, on the pool when one
+    // is given; markEmail(i, tokenizer, vector) sets email i's features, with a tokenizer
+    // reused across its chunk. Defined in the .cpp, where every caller is.
+    template <typename MarkEmail>
+    static vector<vector<double>> extractEmails(size_t count, size_t featureCount, const MarkEmail& markEmail, ThreadPool* pool);
 };
 
 #endif // FEATUREEXTRACTOR_H
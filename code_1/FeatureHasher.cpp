@@ -0,0 +1,191 @@
+#include "FeatureHasher.h"
+#include "FeatureExtractor.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+// Constructor: Starts with every bucket kept.
+FeatureHasher::FeatureHasher(int bits) : bits_(bits), dimensions_(0) {
+    if (bits_ < 1 || bits_ > 24) {
+        throw invalid_argument("The number of hash bits must be between 1 and 24.");
+    }
+    dimensions_ = buckets();
+}
+
+// Number of buckets.
+size_t FeatureHasher::buckets() const {
+    return size_t(1) << bits_;
+}
+
+// Length of the feature vectors.
+size_t FeatureHasher::dimensions() const {
+    return dimensions_;
+}
+
+// FNV-1a mixes poorly into its low bits, so the bucket is taken from the high bits of a
+// Fibonacci (multiplicative) rehash.
+size_t FeatureHasher::bucketOf(uint64_t tokenHash) const {
+    return static_cast<size_t>((tokenHash * 0x9E3779B97F4A7C15ULL) >> (64 - bits_));
+}
+
+// Map step: every worker counts its slice of emails into hash maps, one per partition of the
+// buckets. Reduce step: every partition is merged across workers independently. Then the same
+// balanced selection as for words.
+void FeatureHasher::pruneBalanced(const vector<pair<pair<string, string>, bool>>& trainingData, int N, ThreadPool* pool) {
+    KNN_TIMED_SCOPE("hasher.pruneBalanced");
+    const Vocabulary& excluded = FeatureExtractor::excludedWords();
+    size_t workers = pool != nullptr ? pool->size() : 1;
+    size_t partitions = workers;
+    size_t shards = max<size_t>(1, min(trainingData.size(), workers));
+    // counts[shard][partition]: spam and ham tokens of each bucket hit.
+    typedef vector<unordered_map<uint32_t, pair<int, int>>> PartitionedCounts;
+    vector<PartitionedCounts> counts(shards, PartitionedCounts(partitions));
+    auto countShards = [&](size_t begin, size_t end) {
+        Tokenizer tokenizer;
+        for (size_t shard = begin; shard < end; ++shard) {
+            size_t first = trainingData.size() * shard / shards;
+            size_t last = trainingData.size() * (shard + 1) / shards;
+            for (size_t i = first; i < last; ++i) {
+                bool isSpam = trainingData[i].second;
+                auto countToken = [&](string_view token, uint64_t hash) {
+                    if (excluded.find(token, hash) < 0) {
+                        uint32_t bucket = static_cast<uint32_t>(bucketOf(hash));
+                        pair<int, int>& tokens = counts[shard][bucket % partitions][bucket];
+                        ++(isSpam ? tokens.first : tokens.second);
+                    }
+                };
+                tokenizer.scan(trainingData[i].first.first, countToken);
+                tokenizer.scan(trainingData[i].first.second, countToken);
+            }
+        }
+    };
+    auto mergePartitions = [&](size_t begin, size_t end) {
+        for (size_t partition = begin; partition < end; ++partition) {
+            unordered_map<uint32_t, pair<int, int>>& total = counts[0][partition];
+            for (size_t shard = 1; shard < shards; ++shard) {
+                for (const auto& bucket : counts[shard][partition]) {
+                    total[bucket.first].first += bucket.second.first;
+                    total[bucket.first].second += bucket.second.second;
+                }
+                unordered_map<uint32_t, pair<int, int>>().swap(counts[shard][partition]);
+            }
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(shards, 1, countShards);
+        pool->parallelFor(partitions, 1, mergePartitions);
+    } else {
+        countShards(0, shards);
+        mergePartitions(0, partitions);
+    }
+
+    // Rank the buckets of each label: most tokens first, then lower bucket.
+    vector<pair<uint32_t, pair<int, int>>> totals;
+    for (const auto& partition : counts[0]) {
+        totals.insert(totals.end(), partition.begin(), partition.end());
+    }
+    vector<vector<int>> rankings(2);
+    for (size_t label = 0; label < 2; ++label) {
+        auto tokens = [&](const pair<uint32_t, pair<int, int>>& bucket) { return label == 0 ? bucket.second.first : bucket.second.second; };
+        sort(totals.begin(), totals.end(), [&](const pair<uint32_t, pair<int, int>>& a, const pair<uint32_t, pair<int, int>>& b) {
+            return tokens(a) != tokens(b) ? tokens(a) > tokens(b) : a.first < b.first;
+        });
+        for (const auto& bucket : totals) {
+            if (tokens(bucket) > 0) {
+                rankings[label].push_back(static_cast<int>(bucket.first));
+            }
+        }
+    }
+
+    size_t target = N > 0 ? static_cast<size_t>(N) : 0;
+    set<int> kept;
+    for (const auto& ranking : rankings) {
+        for (size_t i = 0; i < target / 2 && i < ranking.size(); ++i) {
+            kept.insert(ranking[i]);
+        }
+    }
+    for (const auto& ranking : rankings) {
+        for (size_t i = 0; i < ranking.size() && kept.size() < target; ++i) {
+            kept.insert(ranking[i]);
+        }
+    }
+
+    columns_.assign(buckets(), -1);
+    dimensions_ = 0;
+    for (int bucket : kept) {
+        columns_[bucket] = static_cast<int>(dimensions_++);
+    }
+}
+
+// Keeps every bucket again.
+void FeatureHasher::clearPruning() {
+    columns_.clear();
+    dimensions_ = buckets();
+}
+
+// True while the buckets are pruned.
+bool FeatureHasher::isPruned() const {
+    return !columns_.empty();
+}
+
+// The token hash comes from the scan itself; only the excluded-word probe remains per token,
+// and once pruned most tokens land in a dropped bucket and skip even that.
+void FeatureHasher::markFeatures(string_view text, Tokenizer& tokenizer, double* features) const {
+    const Vocabulary& excluded = FeatureExtractor::excludedWords();
+    tokenizer.scan(text, [&](string_view token, uint64_t hash) {
+        size_t bucket = bucketOf(hash);
+        int column = columns_.empty() ? static_cast<int>(bucket) : columns_[bucket];
+        if (column >= 0 && excluded.find(token, hash) < 0) {
+            features[column] = 1.0;
+        }
+    });
+}
+
+// Clears the vector, then marks the subject and message tokens.
+void FeatureHasher::extract(string_view subject, string_view message, Tokenizer& tokenizer, double* features) const {
+    fill(features, features + dimensions_, 0.0);
+    markFeatures(subject, tokenizer, features);
+    markFeatures(message, tokenizer, features);
+}
+
+// Same as above into a new vector.
+vector<double> FeatureHasher::extract(string_view subject, string_view message) const {
+    KNN_TIMED_SCOPE("hasher.extract");
+    vector<double> features(dimensions_);
+    Tokenizer tokenizer;
+    extract(subject, message, tokenizer, features.data());
+    return features;
+}
+
+// Each worker writes its own slots with one tokenizer per chunk.
+template <typename Fields>
+vector<vector<double>> FeatureHasher::extractEmails(size_t count, const Fields& fieldsOf, ThreadPool* pool) const {
+    KNN_TIMED_SCOPE("hasher.extractBatch");
+    vector<vector<double>> features(count, vector<double>(dimensions_));
+    auto extractRange = [&](size_t begin, size_t end) {
+        Tokenizer tokenizer;
+        for (size_t i = begin; i < end; ++i) {
+            const pair<string, string>& fields = fieldsOf(i);
+            extract(fields.first, fields.second, tokenizer, features[i].data());
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(count, 64, extractRange);
+    } else {
+        extractRange(0, count);
+    }
+    return features;
+}
+
+// Vectorizes a list of emails.
+vector<vector<double>> FeatureHasher::extractBatch(const vector<pair<string, string>>& emails, ThreadPool* pool) const {
+    return extractEmails(emails.size(), [&](size_t i) -> const pair<string, string>& { return emails[i]; }, pool);
+}
+
+// Same as above for labeled training data.
+vector<vector<double>> FeatureHasher::extractBatch(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool) const {
+    return extractEmails(trainingData.size(), [&](size_t i) -> const pair<string, string>& { return trainingData[i].first; }, pool);
+}
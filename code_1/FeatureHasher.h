@@ -0,0 +1,80 @@
+#ifndef FEATUREHASHER_H
+#define FEATUREHASHER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "Tokenizer.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Binary features without a vocabulary (the hashing trick): every token sets the feature of
+// one of 2^bits buckets, chosen from the FNV-1a hash the Tokenizer computes while scanning, so
+// an email can be vectorized before any training data has been seen and no word is stored or
+// compared as a string. Common words (FeatureExtractor::excludedWords) are skipped, as in
+// feature selection. Different words may share a bucket; more bits make that rarer.
+// Optionally the buckets can be pruned to the balanced top N by spam and ham token counts,
+// selected like FeatureExtractor::selectBalancedTopFeatures selects words; the vectors then
+// hold only those N buckets.
+class FeatureHasher {
+public:
+    // Constructor: Hashes into 2^bits buckets; throws invalid_argument unless 1 <= bits <= 24.
+    explicit FeatureHasher(int bits);
+
+    // Number of buckets.
+    size_t buckets() const;
+
+    // Length of the feature vectors: the kept buckets once pruned, every bucket otherwise.
+    size_t dimensions() const;
+
+    // Bucket of a token, given its Tokenizer hash.
+    size_t bucketOf(uint64_t tokenHash) const;
+
+    // Counts the spam and ham tokens falling into each bucket, then keeps the top N / 2 buckets
+    // of each label, topped up to N from the spam then ham rankings (ties go to the lower
+    // bucket). Buckets no token fell into are never kept. The counts are kept in hash maps, so
+    // their memory follows the buckets hit rather than 2^bits.
+    void pruneBalanced(const vector<pair<pair<string, string>, bool>>& trainingData, int N, ThreadPool* pool = nullptr);
+
+    // Keeps every bucket again.
+    void clearPruning();
+
+    // True while the buckets are pruned.
+    bool isPruned() const;
+
+    // Writes the dimensions() features of an email into features, reusing the caller's
+    // tokenizer; nothing is allocated.
+    void extract(string_view subject, string_view message, Tokenizer& tokenizer, double* features) const;
+
+    // Same as above into a new vector.
+    vector<double> extract(string_view subject, string_view message) const;
+
+    // Vectorizes a list of emails, in input order, on the pool when one is given.
+    vector<vector<double>> extractBatch(const vector<pair<string, string>>& emails, ThreadPool* pool = nullptr) const;
+
+    // Same as above for labeled training data; the labels are ignored.
+    vector<vector<double>> extractBatch(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool = nullptr) const;
+
+private:
+    int bits_;
+
+    // Feature index of each bucket (-1 if pruned away); empty when nothing is pruned.
+    vector<int> columns_;
+
+    // Number of kept buckets.
+    size_t dimensions_;
+
+    // Sets the feature of every token of the text.
+    void markFeatures(string_view text, Tokenizer& tokenizer, double* features) const;
+
+    // Vectorizes count emails in input order, on the pool when one is given; fieldsOf(i)
+    // returns the subject and message of email i. Defined in the .cpp, where every caller is.
+    template <typename Fields>
+    vector<vector<double>> extractEmails(size_t count, const Fields& fieldsOf, ThreadPool* pool) const;
+};
+
+#endif // FEATUREHASHER_H
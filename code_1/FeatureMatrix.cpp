@@ -0,0 +1,85 @@
+#include "FeatureMatrix.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Constructor: Creates an empty matrix.
+FeatureMatrix::FeatureMatrix() : rows_(0), cols_(0), stride_(0) {}
+
+// Constructor: Creates a zero-filled matrix with the given shape.
+FeatureMatrix::FeatureMatrix(size_t rows, size_t cols)
+    : rows_(rows), cols_(cols), stride_(paddedStride(cols)), data_(rows * paddedStride(cols), 0.0) {}
+
+// Replaces the contents with the given rows, which must all have the same length.
+void FeatureMatrix::assign(const vector<vector<double>>& rows) {
+    rows_ = rows.size();
+    cols_ = rows.empty() ? 0 : rows[0].size();
+    stride_ = paddedStride(cols_);
+    data_.assign(rows_ * stride_, 0.0);
+
+    for (size_t i = 0; i < rows_; ++i) {
+        if (rows[i].size() != cols_) {
+            throw invalid_argument("FeatureMatrix rows must all have the same length");
+        }
+        copy(rows[i].begin(), rows[i].end(), row(i));
+    }
+}
+
+// Appends one row; the first row appended to an empty matrix fixes the column count.
+void FeatureMatrix::appendRow(const double* values, size_t count) {
+    if (rows_ == 0 && data_.empty()) {
+        cols_ = count;
+        stride_ = paddedStride(count);
+    } else if (count != cols_) {
+        throw invalid_argument("FeatureMatrix rows must all have the same length");
+    }
+    data_.resize((rows_ + 1) * stride_, 0.0);
+    copy(values, values + count, row(rows_));
+    ++rows_;
+}
+
+// Removes every row, keeping the column count.
+void FeatureMatrix::clear() {
+    rows_ = 0;
+    data_.clear();
+}
+
+// Number of rows (emails) in the matrix.
+size_t FeatureMatrix::rows() const {
+    return rows_;
+}
+
+// Number of feature columns in each row.
+size_t FeatureMatrix::cols() const {
+    return cols_;
+}
+
+// Distance in doubles between the starts of consecutive rows.
+size_t FeatureMatrix::stride() const {
+    return stride_;
+}
+
+// Returns a pointer to the first value of the given row.
+const double* FeatureMatrix::row(size_t index) const {
+    return data_.data() + index * stride_;
+}
+
+double* FeatureMatrix::row(size_t index) {
+    return data_.data() + index * stride_;
+}
+
+// Copies the given row out as a vector of length cols().
+vector<double> FeatureMatrix::rowVector(size_t index) const {
+    const double* values = row(index);
+    return vector<double>(values, values + cols_);
+}
+
+// Bytes held by the matrix storage.
+size_t FeatureMatrix::memoryBytes() const {
+    return data_.capacity() * sizeof(double);
+}
+
+// Rounds a column count up to a whole number of 64-byte cache lines (8 doubles).
+size_t FeatureMatrix::paddedStride(size_t cols) {
+    return (cols + 7) / 8 * 8;
+}
@@ -0,0 +1,97 @@
+#ifndef FEATUREMATRIX_H
+#define FEATUREMATRIX_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// Allocator returning memory aligned to a cache line, so SIMD kernels start rows on an aligned boundary.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t n) {
+        void* memory = nullptr;
+        if (n == 0) {
+            n = 1;
+        }
+        if (posix_memalign(&memory, Alignment, n * sizeof(T)) != 0) {
+            throw bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t) {
+        free(memory);
+    }
+};
+
+template <typename T, typename U, size_t A>
+bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return true; }
+
+template <typename T, typename U, size_t A>
+bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return false; }
+
+// Dense row-major matrix of feature vectors stored in one contiguous, 64-byte aligned block.
+// Each row is padded with zeros to a whole number of cache lines.
+class FeatureMatrix {
+public:
+    // Constructor: Creates an empty matrix.
+    FeatureMatrix();
+
+    // Constructor: Creates a zero-filled matrix with the given shape.
+    FeatureMatrix(size_t rows, size_t cols);
+
+    // Replaces the contents with the given rows, which must all have the same length.
+    void assign(const vector<vector<double>>& rows);
+
+    // Appends one row; the first row appended to an empty matrix fixes the column count.
+    void appendRow(const double* values, size_t count);
+
+    // Removes every row, keeping the column count.
+    void clear();
+
+    // Number of rows (emails) in the matrix.
+    size_t rows() const;
+
+    // Number of feature columns in each row.
+    size_t cols() const;
+
+    // Distance in doubles between the starts of consecutive rows.
+    size_t stride() const;
+
+    // Returns a pointer to the first value of the given row.
+    const double* row(size_t index) const;
+    double* row(size_t index);
+
+    // Copies the given row out as a vector of length cols().
+    vector<double> rowVector(size_t index) const;
+
+    // Bytes held by the matrix storage.
+    size_t memoryBytes() const;
+
+private:
+    size_t rows_;
+    size_t cols_;
+    size_t stride_;
+    vector<double, AlignedAllocator<double>> data_;
+
+    // Rounds a column count up to a whole number of 64-byte cache lines.
+    static size_t paddedStride(size_t cols);
+};
+
+#endif // FEATUREMATRIX_H
@@ -0,0 +1,239 @@
+#include "InvertedIndex.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Scratch of the calling thread, shared by every index searched on it, so a search does not
+// allocate or zero counters for every email.
+InvertedIndex::Scratch& threadScratch() {
+    thread_local InvertedIndex::Scratch scratch;
+    return scratch;
+}
+
+} // namespace
+
+// Constructor: Creates an empty index.
+InvertedIndex::InvertedIndex() : featureCount_(0), rowOffsets_(1, 0), postingOffsets_(1, 0) {}
+
+// Builds the index from binary feature vectors.
+void InvertedIndex::build(const vector<vector<double>>& features) {
+    size_t featureCount = features.empty() ? 0 : features[0].size();
+    vector<vector<int>> emails;
+    emails.reserve(features.size());
+    for (const auto& row : features) {
+        if (row.size() != featureCount) {
+            throw invalid_argument("Training feature vectors must all have the same length");
+        }
+        emails.push_back(queryIds(row));
+    }
+    build(emails, featureCount);
+}
+
+// Builds the row lists, the posting lists (by counting sort) and the size-ordered email list.
+void InvertedIndex::build(const vector<vector<int>>& emails, size_t featureCount) {
+    clearRemoved();
+    appendedPostings_.clear();
+    featureCount_ = featureCount;
+    rowOffsets_.assign(1, 0);
+    rowIds_.clear();
+    vector<size_t> postingCounts(featureCount + 1, 0);
+
+    for (const auto& ids : emails) {
+        for (int id : ids) {
+            if (id < 0 || static_cast<size_t>(id) >= featureCount) {
+                throw out_of_range("Feature id outside the index vocabulary");
+            }
+            rowIds_.push_back(id);
+            ++postingCounts[id + 1];
+        }
+        rowOffsets_.push_back(rowIds_.size());
+    }
+
+    postingOffsets_.assign(featureCount + 1, 0);
+    for (size_t f = 0; f < featureCount; ++f) {
+        postingOffsets_[f + 1] = postingOffsets_[f] + postingCounts[f + 1];
+    }
+    postings_.assign(rowIds_.size(), 0);
+    vector<size_t> cursor(postingOffsets_.begin(), postingOffsets_.end() - 1);
+    for (size_t email = 0; email < emails.size(); ++email) {
+        for (int id : emails[email]) {
+            postings_[cursor[id]++] = static_cast<int>(email);
+        }
+    }
+
+    emailsBySize_.resize(emails.size());
+    for (size_t email = 0; email < emails.size(); ++email) {
+        emailsBySize_[email] = static_cast<int>(email);
+    }
+    stable_sort(emailsBySize_.begin(), emailsBySize_.end(), [this](int a, int b) {
+        return rowSize(a) < rowSize(b);
+    });
+}
+
+// Appends the email's ids to the row lists and its index to the appended posting lists, and
+// inserts it into the size-ordered list after every email of the same size.
+size_t InvertedIndex::append(const vector<double>& features) {
+    if (size() == 0) {
+        featureCount_ = features.size();
+        postingOffsets_.assign(featureCount_ + 1, 0);
+        postings_.clear();
+        appendedPostings_.clear();
+    } else if (features.size() != featureCount_) {
+        throw invalid_argument("Training feature vectors must all have the same length");
+    }
+    vector<int> ids = queryIds(features);
+
+    int email = static_cast<int>(size());
+    rowIds_.insert(rowIds_.end(), ids.begin(), ids.end());
+    rowOffsets_.push_back(rowIds_.size());
+
+    if (appendedPostings_.empty()) {
+        appendedPostings_.resize(featureCount_);
+    }
+    for (int id : ids) {
+        appendedPostings_[id].push_back(email);
+    }
+
+    auto position = upper_bound(emailsBySize_.begin(), emailsBySize_.end(), email, [this](int a, int b) {
+        return rowSize(a) < rowSize(b);
+    });
+    emailsBySize_.insert(position, email);
+    return static_cast<size_t>(email);
+}
+
+// Copies the row lists, postings and removal flags.
+shared_ptr<NeighborIndex> InvertedIndex::clone() const {
+    return make_shared<InvertedIndex>(*this);
+}
+
+// Finds the k nearest emails by overlap counting over the query's posting lists. The counters
+// are grown to the index size when needed; only the ones a search touches are cleared.
+vector<Neighbor> InvertedIndex::search(const vector<int>& queryIds, size_t k, Scratch& scratch) const {
+    size_t emails = size();
+    if (scratch.overlap.size() < emails) {
+        scratch.overlap.resize(emails, 0);
+    }
+    scratch.touched.clear();
+    scratch.nearest.reset(k);
+
+    // Count shared features for every email that appears in a query feature's posting list.
+    int querySize = 0;
+    for (int id : queryIds) {
+        if (id < 0 || static_cast<size_t>(id) >= featureCount_) {
+            continue;
+        }
+        ++querySize;
+        for (size_t p = postingOffsets_[id]; p < postingOffsets_[id + 1]; ++p) {
+            int email = postings_[p];
+            if (scratch.overlap[email]++ == 0) {
+                scratch.touched.push_back(email);
+            }
+        }
+        if (!appendedPostings_.empty()) {
+            for (int email : appendedPostings_[id]) {
+                if (scratch.overlap[email]++ == 0) {
+                    scratch.touched.push_back(email);
+                }
+            }
+        }
+    }
+
+    bool skipRemoved = removedCount() > 0;
+    for (int email : scratch.touched) {
+        if (skipRemoved && isRemoved(email)) {
+            continue;
+        }
+        scratch.nearest.offer(querySize + rowSize(email) - 2 * scratch.overlap[email], email);
+    }
+
+    // Emails sharing no feature are at distance |q| + |b|; the first k of them in
+    // (size, index) order are the only ones that can make the cut.
+    size_t untouchedTaken = 0;
+    for (size_t i = 0; i < emailsBySize_.size() && untouchedTaken < k; ++i) {
+        int email = emailsBySize_[i];
+        if (scratch.overlap[email] == 0 && !(skipRemoved && isRemoved(email))) {
+            scratch.nearest.offer(querySize + rowSize(email), email);
+            ++untouchedTaken;
+        }
+    }
+
+    // Reset only the counters this query touched.
+    for (int email : scratch.touched) {
+        scratch.overlap[email] = 0;
+    }
+
+    return scratch.nearest.neighbors();
+}
+
+// Finds the k nearest emails to a binary query vector.
+vector<Neighbor> InvertedIndex::search(const vector<double>& query, size_t k) const {
+    return search(queryIds(query), k, threadScratch());
+}
+
+// Searches many binary queries; each chunk of queries uses its thread's scratch counters.
+vector<vector<Neighbor>> InvertedIndex::searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool) const {
+    vector<vector<Neighbor>> results(queries.size());
+    auto searchRange = [&](size_t begin, size_t end) {
+        Scratch& scratch = threadScratch();
+        for (size_t q = begin; q < end; ++q) {
+            results[q] = search(queryIds(queries[q]), k, scratch);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(queries.size(), 32, searchRange);
+    } else {
+        searchRange(0, queries.size());
+    }
+    return results;
+}
+
+// Number of indexed emails.
+size_t InvertedIndex::size() const {
+    return rowOffsets_.size() - 1;
+}
+
+// Sorted feature ids of one indexed email.
+vector<int> InvertedIndex::featureIds(size_t email) const {
+    return vector<int>(rowIds_.begin() + rowOffsets_[email], rowIds_.begin() + rowOffsets_[email + 1]);
+}
+
+// Number of features the index was built over.
+size_t InvertedIndex::dimensions() const {
+    return featureCount_;
+}
+
+// Overlap counting gives exact distances for every email.
+bool InvertedIndex::isExact() const {
+    return true;
+}
+
+// Short description of the backend.
+string InvertedIndex::name() const {
+    return "exact (inverted index)";
+}
+
+// Bytes held by the index.
+size_t InvertedIndex::memoryBytes() const {
+    size_t bytes = rowOffsets_.capacity() * sizeof(size_t) + rowIds_.capacity() * sizeof(int)
+        + postingOffsets_.capacity() * sizeof(size_t) + postings_.capacity() * sizeof(int)
+        + emailsBySize_.capacity() * sizeof(int);
+    for (const auto& list : appendedPostings_) {
+        bytes += sizeof(list) + list.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+// Converts a binary query vector to feature ids, throwing if it is not binary.
+vector<int> InvertedIndex::queryIds(const vector<double>& query) {
+    if (!isBinaryVector(query)) {
+        throw invalid_argument("The inverted index requires binary (0/1) features");
+    }
+    return toFeatureIds(query);
+}
+
+// Number of features set in an email.
+int InvertedIndex::rowSize(size_t email) const {
+    return static_cast<int>(rowOffsets_[email + 1] - rowOffsets_[email]);
+}
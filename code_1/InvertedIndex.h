@@ -0,0 +1,90 @@
+#ifndef INVERTEDINDEX_H
+#define INVERTEDINDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include "NeighborIndex.h"
+#include "NeighborBuffer.h"
+
+using namespace std;
+
+// Sparse exact nearest-neighbor index for binary feature vectors.
+// Each training email is stored as a sorted list of the feature ids it contains, and every
+// feature id has a posting list of the emails containing it. For binary vectors
+// |a - b|^2 = |a| + |b| - 2 * overlap(a, b), so walking the postings of a query's features
+// gives the exact distance to every email that shares a feature; emails sharing none are at
+// |q| + |b| and are taken from a list ordered by feature count.
+class InvertedIndex : public NeighborIndex {
+public:
+    // Per-search working memory, reusable across searches on the same thread and across
+    // indexes: overlap only grows and holds zeros between searches.
+    struct Scratch {
+        vector<int> overlap;
+        vector<int> touched;
+        NeighborBuffer nearest;
+    };
+
+    // Constructor: Creates an empty index.
+    InvertedIndex();
+
+    // Builds the index from binary feature vectors; throws if any value is not 0 or 1.
+    void build(const vector<vector<double>>& features) override;
+
+    // Builds the index from emails given as sorted feature-id lists over featureCount features.
+    void build(const vector<vector<int>>& emails, size_t featureCount);
+
+    // Finds the k nearest emails to a binary query vector.
+    vector<Neighbor> search(const vector<double>& query, size_t k) const override;
+
+    // Searches many binary queries, reusing the calling thread's Scratch.
+    vector<vector<Neighbor>> searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool = nullptr) const override;
+
+    // Finds the k nearest emails to the query (a sorted feature-id list). Returns
+    // (squared distance, email index) pairs nearest first, ties broken by lower index,
+    // exactly matching a full scan.
+    vector<Neighbor> search(const vector<int>& queryIds, size_t k, Scratch& scratch) const;
+
+    // Adds a binary email; its postings go to per-feature lists searched after the built ones.
+    size_t append(const vector<double>& features) override;
+
+    shared_ptr<NeighborIndex> clone() const override;
+
+    // Number of indexed emails.
+    size_t size() const override;
+
+    size_t dimensions() const override;
+    bool isExact() const override;
+    string name() const override;
+
+    // Sorted feature ids of one indexed email.
+    vector<int> featureIds(size_t email) const;
+
+    // Bytes held by the index.
+    size_t memoryBytes() const override;
+
+private:
+    size_t featureCount_;
+
+    // Emails as feature-id lists: ids of email i are rowIds_[rowOffsets_[i] .. rowOffsets_[i + 1]).
+    vector<size_t> rowOffsets_;
+    vector<int> rowIds_;
+
+    // Posting lists: emails containing feature f are postings_[postingOffsets_[f] .. postingOffsets_[f + 1]).
+    vector<size_t> postingOffsets_;
+    vector<int> postings_;
+
+    // Posting lists of emails appended after build (empty until the first append).
+    vector<vector<int>> appendedPostings_;
+
+    // Email indices ordered by (feature count, index), used for emails sharing no query feature.
+    vector<int> emailsBySize_;
+
+    // Converts a binary query vector to feature ids, throwing if it is not binary.
+    static vector<int> queryIds(const vector<double>& query);
+
+    // Number of features set in an email.
+    int rowSize(size_t email) const;
+};
+
+#endif // INVERTEDINDEX_H
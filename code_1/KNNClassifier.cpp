@@ -1,89 +1,291 @@
 #include "KNNClassifier.h"
+#include "Metrics.h"
+
+#include <algorithm>
 
 // Constructor: Initializes the KNN classifier with a given number of neighbors (k).
-KNNClassifier::KNNClassifier(int k) : k(k) {}
+KNNClassifier::KNNClassifier(int k)
+    : k(k), binaryFeatures(false), voting(Majority), searchMode(Dense), index(make_shared<ExactIndex>()) {}
 
-// Train the classifier by storing the training features and corresponding labels.
+// Train the classifier by storing the labels and building the selected search backend over
+// the training features.
 void KNNClassifier::train(const vector<vector<double>>& features, const vector<bool>& labels) {
-    trainingFeatures = features;
+    KNN_TIMED_SCOPE("classifier.train");
+    if (features.size() != labels.size()) {
+        throw invalid_argument("Training features and labels must have the same length");
+    }
+
+    binaryFeatures = true;
+    for (const auto& row : features) {
+        binaryFeatures = binaryFeatures && NeighborIndex::isBinaryVector(row);
+    }
+
+    shared_ptr<NeighborIndex> built = createIndex();
+    built->build(features);
+
+    index = built;
+    sparseIndex.reset();
+    trainingLabels = labels;
+    trainingWeights.clear();
+}
+
+// Train as above, then keep the weights (dropped when they are all 1).
+void KNNClassifier::train(const vector<vector<double>>& features, const vector<bool>& labels, const vector<int>& weights) {
+    if (weights.size() != labels.size()) {
+        throw invalid_argument("Training labels and weights must have the same length");
+    }
+    if (any_of(weights.begin(), weights.end(), [](int weight) { return weight <= 0; })) {
+        throw invalid_argument("Training weights must be positive");
+    }
+    train(features, labels);
+    if (any_of(weights.begin(), weights.end(), [](int weight) { return weight != 1; })) {
+        trainingWeights = weights;
+    }
+}
+
+// Train from packed binary rows; the exact backend copies them as they are.
+void KNNClassifier::trainPacked(const uint64_t* rows, size_t rowCount, size_t featureCount, const vector<bool>& labels) {
+    KNN_TIMED_SCOPE("classifier.trainPacked");
+    if (rowCount != labels.size()) {
+        throw invalid_argument("Training features and labels must have the same length");
+    }
+
+    shared_ptr<NeighborIndex> built = createIndex();
+    built->buildPacked(rows, rowCount, featureCount);
+
+    binaryFeatures = true;
+    index = built;
+    sparseIndex.reset();
+    trainingLabels = labels;
+    trainingWeights.clear();
+}
+
+// Train on sparse vectors; the dense backend is left empty.
+void KNNClassifier::trainSparse(const vector<SparseVector>& rows, const vector<bool>& labels) {
+    KNN_TIMED_SCOPE("classifier.trainSparse");
+    if (rows.size() != labels.size()) {
+        throw invalid_argument("Training features and labels must have the same length");
+    }
+
+    shared_ptr<SparseCosineIndex> built = make_shared<SparseCosineIndex>();
+    built->build(rows);
+
+    binaryFeatures = false;
+    index = make_shared<ExactIndex>();
+    sparseIndex = built;
     trainingLabels = labels;
+    trainingWeights.clear();
+}
+
+// The custom backend if one is plugged in, otherwise a fresh one for the search mode.
+shared_ptr<NeighborIndex> KNNClassifier::createIndex() const {
+    if (customIndex) {
+        return customIndex;
+    } else if (searchMode == Sparse) {
+        return make_shared<InvertedIndex>();
+    } else if (searchMode == LSH) {
+        return make_shared<LSHIndex>(lshParameters);
+    } else if (searchMode == Quantized) {
+        return make_shared<QuantizedIndex>(quantizationParameters);
+    }
+    return make_shared<ExactIndex>();
+}
+
+// Add one email to the backend in place.
+int KNNClassifier::append(const vector<double>& features, bool label) {
+    KNN_TIMED_SCOPE("classifier.append");
+    checkQuery(features);
+    size_t row = mutableIndex().append(features);
+    trainingLabels.push_back(label);
+    if (!trainingWeights.empty()) {
+        trainingWeights.push_back(1);
+    }
+    binaryFeatures = (row == 0 || binaryFeatures) && NeighborIndex::isBinaryVector(features);
+    return static_cast<int>(row);
+}
+
+// Tombstone one email in the backend.
+void KNNClassifier::remove(int trainingIndex) {
+    if (trainingIndex < 0 || static_cast<size_t>(trainingIndex) >= index->size()) {
+        throw out_of_range("Training index outside the training set");
+    }
+    mutableIndex().remove(static_cast<size_t>(trainingIndex));
+}
+
+// Number of training emails that have not been removed.
+size_t KNNClassifier::liveCount() const {
+    if (sparseIndex) {
+        return sparseIndex->size();
+    }
+    return index->size() - index->removedCount();
 }
 
 // Predict the class (spam or not spam) of a new email instance using KNN algorithm.
 bool KNNClassifier::predict(const vector<double>& emailFeatures) const {
-    // Max heap to store the k nearest neighbors based on their distance
-    priority_queue<pair<double, int>> neighbors;
-
-    for (int i = 0; i < trainingFeatures.size(); ++i) {
-        double distance = computeDistance(emailFeatures, trainingFeatures[i]);
-
-        // If the heap has less than k elements, just add the new element
-        if (neighbors.size() < k) {
-            neighbors.push(make_pair(distance, i));
-        } else {
-            // If the new element's distance is smaller than the largest in the heap, replace it
-            if (distance < neighbors.top().first) {
-                neighbors.pop();
-                neighbors.push(make_pair(distance, i));
-            }
-        }
+    KNN_TIMED_SCOPE("classifier.predict");
+    checkQuery(emailFeatures);
+    return vote(index->search(emailFeatures, static_cast<size_t>(k)), k).isSpam;
+}
+
+// Classify many emails at once through the backend's batch search.
+vector<Prediction> KNNClassifier::predictBatch(const vector<vector<double>>& queries, ThreadPool* pool) const {
+    KNN_TIMED_SCOPE("classifier.predictBatch");
+    KNN_COUNT("classifier.batchQueries", queries.size());
+    for (const auto& query : queries) {
+        checkQuery(query);
     }
+    vector<vector<Neighbor>> neighbors = index->searchBatch(queries, static_cast<size_t>(k), pool);
 
-    // Count the number of spam emails among the k nearest neighbors
-    int spamCount = 0;
-    while (!neighbors.empty()) {
-        int index = neighbors.top().second;
-        bool isSpam = trainingLabels[index];
-        spamCount += isSpam;
-        neighbors.pop();
+    vector<Prediction> predictions;
+    predictions.reserve(queries.size());
+    for (const auto& list : neighbors) {
+        predictions.push_back(vote(list, k));
     }
+    return predictions;
+}
 
-    return spamCount > k / 2;
+// Classify one sparse email through the cosine index.
+Prediction KNNClassifier::predictSparse(const SparseVector& query) const {
+    KNN_TIMED_SCOPE("classifier.predictSparse");
+    checkSparse();
+    return vote(sparseIndex->search(query, static_cast<size_t>(k)), k);
 }
 
+// Classify many sparse emails through the cosine index's batch search.
+vector<Prediction> KNNClassifier::predictBatchSparse(const vector<SparseVector>& queries, ThreadPool* pool) const {
+    KNN_TIMED_SCOPE("classifier.predictBatchSparse");
+    KNN_COUNT("classifier.batchQueries", queries.size());
+    checkSparse();
+    vector<vector<Neighbor>> neighbors = sparseIndex->searchBatch(queries, static_cast<size_t>(k), pool);
 
-// Compute Euclidean distance between two feature vectors.
-double KNNClassifier::computeDistance(const vector<double>& email1, const vector<double>& email2) const {
-    double sum = 0.0;
-    for (int i = 0; i < email1.size(); ++i) {
-        sum += pow(email1[i] - email2[i], 2);
+    vector<Prediction> predictions;
+    predictions.reserve(queries.size());
+    for (const auto& list : neighbors) {
+        predictions.push_back(vote(list, k));
     }
-    return sqrt(sum);
+    return predictions;
 }
 
+// Returns true if every training feature is 0.0 or 1.0.
+bool KNNClassifier::usesBinaryFeatures() const {
+    return binaryFeatures;
+}
 
-// Same as the predict function but also prints the nearest neighbor information.
-bool KNNClassifier::predictAnalyze(const vector<double>& emailFeatures) const {
-    // Max heap to store the k nearest neighbors based on their distance
-    priority_queue<pair<double, int>> neighbors;
-
-    for (int i = 0; i < trainingFeatures.size(); ++i) {
-        double distance = computeDistance(emailFeatures, trainingFeatures[i]);
-
-        // If the heap has less than k elements, just add the new element
-        if (neighbors.size() < k) {
-            neighbors.push(make_pair(distance, i));
-        } else {
-            // If the new element's distance is smaller than the largest in the heap, replace it
-            if (distance < neighbors.top().first) {
-                neighbors.pop();
-                neighbors.push(make_pair(distance, i));
-            }
+// Returns the training labels.
+const vector<bool>& KNNClassifier::getTrainingLabels() const {
+    return trainingLabels;
+}
+
+// Selects the built-in backend the next call to train builds.
+void KNNClassifier::setSearchMode(SearchMode mode) {
+    searchMode = mode;
+    customIndex.reset();
+}
+
+// Selects how the neighbors vote.
+void KNNClassifier::setVoting(Voting voting) {
+    this->voting = voting;
+}
+
+// Parameters for the LSH backend.
+void KNNClassifier::setLSHParameters(const LSHIndex::Parameters& parameters) {
+    lshParameters = parameters;
+}
+
+// Parameters for the Quantized backend.
+void KNNClassifier::setQuantizationParameters(const QuantizedIndex::Parameters& parameters) {
+    quantizationParameters = parameters;
+}
+
+// Plugs in a custom backend for the next call to train.
+void KNNClassifier::setIndex(shared_ptr<NeighborIndex> index) {
+    customIndex = index;
+}
+
+// Backend holding the current training set.
+const NeighborIndex& KNNClassifier::neighborIndex() const {
+    return *index;
+}
+
+// Copy the backend on first write if it is shared with another classifier. A plugged-in
+// custom backend is the caller's object and is updated in place.
+NeighborIndex& KNNClassifier::mutableIndex() {
+    if (index != customIndex && index.use_count() > 1) {
+        index = index->clone();
+    }
+    return *index;
+}
+
+// Throws if a query does not have the training vectors' length.
+void KNNClassifier::checkQuery(const vector<double>& emailFeatures) const {
+    if (sparseIndex) {
+        throw logic_error("The classifier was trained on sparse vectors; use predictSparse");
+    }
+    if (index->size() > 0 && emailFeatures.size() != index->dimensions()) {
+        throw invalid_argument("Feature vector length does not match the training data");
+    }
+}
+
+// Throws unless the classifier was trained on sparse vectors.
+void KNNClassifier::checkSparse() const {
+    if (!sparseIndex) {
+        throw logic_error("The classifier was not trained on sparse vectors; use trainSparse first");
+    }
+}
+
+// Weigh the spam and ham neighbors; the distances are reported as Euclidean. A weighted
+// training email casts its weight in votes, and only the nearest k votes count. A majority
+// vote keeps the k / 2 threshold, ties included, so a search that returns fewer than k votes
+// (removed rows) still needs the same number of spam votes.
+Prediction KNNClassifier::vote(const vector<Neighbor>& neighbors, int k) const {
+    Prediction prediction;
+    prediction.spamVotes = 0;
+    prediction.neighborIndices.reserve(neighbors.size());
+    prediction.neighborDistances.reserve(neighbors.size());
+    double spamWeight = 0.0;
+    double hamWeight = 0.0;
+    int votes = 0;
+    for (const auto& neighbor : neighbors) {
+        if (votes == k) {
+            break;
         }
+        int count = trainingWeights.empty() ? 1 : min(trainingWeights[neighbor.second], k - votes);
+        double distance = sqrt(neighbor.first);
+        bool isSpam = trainingLabels[neighbor.second];
+        double weight = count * (voting == DistanceWeighted ? 1.0 / (1.0 + distance) : 1.0);
+        prediction.neighborIndices.push_back(neighbor.second);
+        prediction.neighborDistances.push_back(distance);
+        prediction.spamVotes += isSpam ? count : 0;
+        (isSpam ? spamWeight : hamWeight) += weight;
+        votes += count;
+    }
+
+    if (voting == Majority) {
+        prediction.isSpam = prediction.spamVotes > k / 2;
+    } else if (spamWeight != hamWeight) {
+        prediction.isSpam = spamWeight > hamWeight;
+    } else {
+        prediction.isSpam = !neighbors.empty() && trainingLabels[neighbors[0].second];
     }
 
-    // Count the number of spam emails among the k nearest neighbors
-    int spamCount = 0;
-    while (!neighbors.empty()) {
-        int index = neighbors.top().second;
+    double total = spamWeight + hamWeight;
+    prediction.confidence = total > 0.0 ? (prediction.isSpam ? spamWeight : hamWeight) / total : 0.0;
+    return prediction;
+}
+
+// Same as the predict function but also prints the nearest neighbor information.
+bool KNNClassifier::predictAnalyze(const vector<double>& emailFeatures) const {
+    checkQuery(emailFeatures);
+    Prediction prediction = vote(index->search(emailFeatures, static_cast<size_t>(k)), k);
+
+    // Print the neighbors farthest first, with their Euclidean distance.
+    for (size_t n = prediction.neighborIndices.size(); n-- > 0;) {
+        int index = prediction.neighborIndices[n];
         bool isSpam = trainingLabels[index];
-        spamCount += isSpam;
 
         // Print statement
-        cout << "Neighbor index: " << index << ", Distance: " << computeDistance(emailFeatures, trainingFeatures[index]) << ", Label (Spam=1/Ham=0): " << isSpam << endl;
-
-        neighbors.pop();
+        cout << "Neighbor index: " << index << ", Distance: " << prediction.neighborDistances[n] << ", Label (Spam=1/Ham=0): " << isSpam << endl;
     }
 
-    return spamCount > k / 2;
+    return prediction.isSpam;
 }
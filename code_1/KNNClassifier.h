@@ -1,40 +1,184 @@
 #ifndef KNNCLASSIFIER_H
 #define KNNCLASSIFIER_H
 
-#include <queue>
 #include <vector>
 #include <utility>
 #include <iostream>
 #include <cmath>
+#include <memory>
+#include <stdexcept>
+#include "NeighborIndex.h"
+#include "ExactIndex.h"
+#include "InvertedIndex.h"
+#include "LSHIndex.h"
+#include "QuantizedIndex.h"
+#include "SparseCosineIndex.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
+// Classification of one email together with the neighbors that decided it.
+struct Prediction {
+    // True if the email was classified as spam.
+    bool isSpam;
+
+    // Indices of the k nearest training emails, nearest first (ties broken by lower index).
+    vector<int> neighborIndices;
+
+    // Euclidean distance to each neighbor, parallel to neighborIndices.
+    vector<double> neighborDistances;
+
+    // Number of the votes that are spam: one per neighbor, or its weight for a weighted
+    // training set (see train with weights), counting at most k in total.
+    int spamVotes;
+
+    // Share of the vote weight behind the verdict: 1 when unanimous, 0.5 for a tie, 0 when
+    // there were no neighbors. It can fall below 0.5 only for a majority vote over fewer than
+    // k neighbors, which still needs more than k / 2 spam votes.
+    double confidence;
+};
+
 class KNNClassifier {
 public:
+    // Built-in search backends (see NeighborIndex for plugging in others).
+    //   Dense:  exact scan of every row (packed bitsets for binary features, a FeatureMatrix otherwise).
+    //   Sparse: exact; binary features only. An inverted index over feature ids, so a query only
+    //           touches the training emails that share one of its features.
+    //   LSH:    approximate; binary features only. MinHash LSH tuned by setLSHParameters.
+    //   Quantized: for weighted features; scans int8 or fp16 copies of the rows, optionally
+    //           reranking the best candidates exactly (setQuantizationParameters).
+    enum SearchMode { Dense, Sparse, LSH, Quantized };
+
+    // How the neighbors vote.
+    //   Majority:         one vote each; spam needs more than k / 2 votes, so a tie is ham.
+    //   DistanceWeighted: each neighbor votes 1 / (1 + distance), so exact duplicates count
+    //                     fully and far neighbors barely; spam needs more than half the
+    //                     weight, and an exact tie goes to the nearest neighbor's label.
+    enum Voting { Majority, DistanceWeighted };
+
     // Constructor: Initializes the KNN classifier with a given number of neighbors (k).
     explicit KNNClassifier(int k);
 
     // Trains the classifier using the provided features and labels.
     void train(const vector<vector<double>>& features, const vector<bool>& labels);
 
+    // Trains on weighted prototypes (for example from TrainingCondenser): a training email of
+    // weight w votes as w identical neighbors, so a query's k votes may come from fewer than k
+    // emails. Throws invalid_argument unless there is one positive weight per email.
+    void train(const vector<vector<double>>& features, const vector<bool>& labels, const vector<int>& weights);
+
+    // Trains from binary rows already packed 64 features per word (for example the matrix of a
+    // loaded ModelSnapshot), without expanding them to doubles when the backend can avoid it.
+    void trainPacked(const uint64_t* rows, size_t rowCount, size_t featureCount, const vector<bool>& labels);
+
+    // Trains on unit-length sparse vectors (for example TF-IDF vectors from TfidfVectorizer),
+    // searched by cosine similarity in a SparseCosineIndex. Only predictSparse and
+    // predictBatchSparse can be used until the next dense train.
+    void trainSparse(const vector<SparseVector>& rows, const vector<bool>& labels);
+
+    // Adds one labeled training email to the live classifier and returns its training index.
+    // Only the new row is indexed; nothing is rebuilt.
+    int append(const vector<double>& features, bool label);
+
+    // Removes a training email: it no longer votes, but the indices of the other emails do not
+    // change. Throws out_of_range for a bad index.
+    void remove(int trainingIndex);
+
+    // Number of training emails that have not been removed.
+    size_t liveCount() const;
+
     // Predicts the class (true/false) of a new instance based on its features.
     bool predict(const vector<double>& emailFeatures) const;
 
     // Same as the predict function but also prints the nearest neighbor information.
     bool predictAnalyze(const vector<double>& emailFeatures) const;
 
+    // Classifies many emails at once and returns each label with its nearest-first neighbors.
+    // The search backend processes the whole batch (the exact scan visits each cache-sized block
+    // of training rows once per block of queries). If a pool is given, the work is spread over
+    // its workers; the output is unchanged.
+    vector<Prediction> predictBatch(const vector<vector<double>>& queries, ThreadPool* pool = nullptr) const;
+
+    // Classifies one sparse email of a classifier trained by trainSparse; the neighbor
+    // distances are those between the unit vectors, sqrt(2 - 2 cos). Throws logic_error if the
+    // classifier was trained on dense features.
+    Prediction predictSparse(const SparseVector& query) const;
+
+    // Same as above for many emails, searched on the pool when one is given.
+    vector<Prediction> predictBatchSparse(const vector<SparseVector>& queries, ThreadPool* pool = nullptr) const;
+
+    // Converts a nearest-first neighbor list of the training set (as returned by
+    // neighborIndex().search) into a Prediction by the selected vote over its nearest k votes.
+    // A list searched once at a large k can so be reused for every smaller k.
+    Prediction vote(const vector<Neighbor>& neighbors, int k) const;
+
+    // Returns true if every training feature is 0.0 or 1.0.
+    bool usesBinaryFeatures() const;
+
+    // Labels of the training emails, in training order (true = spam).
+    const vector<bool>& getTrainingLabels() const;
+
+    // Selects the built-in backend the next call to train builds (default Dense).
+    void setSearchMode(SearchMode mode);
+
+    // Selects how the neighbors vote (default Majority); takes effect on the next prediction.
+    void setVoting(Voting voting);
+
+    // Parameters for the LSH backend, used by the next call to train in LSH mode.
+    void setLSHParameters(const LSHIndex::Parameters& parameters);
+
+    // Parameters for the Quantized backend, used by the next call to train in Quantized mode.
+    void setQuantizationParameters(const QuantizedIndex::Parameters& parameters);
+
+    // Plugs in a custom backend; the next call to train builds it instead of the search mode's.
+    void setIndex(shared_ptr<NeighborIndex> index);
+
+    // Backend holding the current training set.
+    const NeighborIndex& neighborIndex() const;
+
 private:
     // Number of nearest neighbors to consider in the KNN algorithm.
     int k;
 
-    // Stores training feature vectors.
-    vector<vector<double>> trainingFeatures;
-
     // Stores corresponding labels for the training feature vectors.
     vector<bool> trainingLabels;
 
-    // Computes Euclidean distance between two feature vectors.
-    double computeDistance(const vector<double>& email1, const vector<double>& email2) const;
+    // Number of votes of each training email; empty when every email has one.
+    vector<int> trainingWeights;
+
+    // True when every training feature is 0.0 or 1.0.
+    bool binaryFeatures;
+
+    // How the neighbors vote.
+    Voting voting;
+
+    // Backend requested for the next train call.
+    SearchMode searchMode;
+    LSHIndex::Parameters lshParameters;
+    QuantizedIndex::Parameters quantizationParameters;
+    shared_ptr<NeighborIndex> customIndex;
+
+    // Backend built from the current training set. Shared between copies of the classifier;
+    // train always replaces it rather than rebuilding it in place.
+    shared_ptr<NeighborIndex> index;
+
+    // Cosine index of a classifier trained by trainSparse; null after a dense train.
+    shared_ptr<SparseCosineIndex> sparseIndex;
+
+    // Backend the next call to train should build.
+    shared_ptr<NeighborIndex> createIndex() const;
+
+    // The backend, first copied if another classifier still shares it, so that updates never
+    // show through copies of this classifier.
+    NeighborIndex& mutableIndex();
+
+    // Throws if a query does not have the training vectors' length, or if the classifier was
+    // trained on sparse vectors.
+    void checkQuery(const vector<double>& emailFeatures) const;
+
+    // Throws unless the classifier was trained on sparse vectors.
+    void checkSparse() const;
+
 };
 
 #endif // KNNCLASSIFIER_H
@@ -0,0 +1,192 @@
+#include "LSHIndex.h"
+#include "DistanceKernels.h"
+#include "NeighborBuffer.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// SplitMix64 finalizer: a cheap 64-bit mixing function with good avalanche.
+uint64_t mix64(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+} // namespace
+
+// Constructor: Creates an empty index with the given parameters.
+LSHIndex::LSHIndex(const Parameters& parameters)
+    : parameters_(parameters), rowCount_(0), featureCount_(0), wordsPerRow_(0) {
+    if (parameters_.bands <= 0 || parameters_.rowsPerBand <= 0) {
+        throw invalid_argument("LSH bands and rows per band must be positive");
+    }
+    uint64_t state = parameters_.seed;
+    for (int h = 0; h < parameters_.bands * parameters_.rowsPerBand; ++h) {
+        state = mix64(state);
+        hashSeeds_.push_back(state);
+    }
+}
+
+// Packs every training email for re-ranking and inserts it into each band's table.
+void LSHIndex::build(const vector<vector<double>>& features) {
+    clearRemoved();
+    rowCount_ = features.size();
+    featureCount_ = features.empty() ? 0 : features[0].size();
+    wordsPerRow_ = (featureCount_ + 63) / 64;
+    packedRows_.assign(rowCount_ * wordsPerRow_, 0);
+    tables_.assign(parameters_.bands, unordered_map<uint64_t, vector<int>>());
+
+    for (size_t i = 0; i < rowCount_; ++i) {
+        if (features[i].size() != featureCount_) {
+            throw invalid_argument("Training feature vectors must all have the same length");
+        }
+        vector<int> ids = binaryIds(features[i]);
+        packBinaryVector(features[i], &packedRows_[i * wordsPerRow_]);
+
+        vector<uint64_t> keys = bandKeys(ids);
+        for (int band = 0; band < parameters_.bands; ++band) {
+            tables_[band][keys[band]].push_back(static_cast<int>(i));
+        }
+    }
+}
+
+// Packs the email after the existing rows and adds it to each band's bucket.
+size_t LSHIndex::append(const vector<double>& features) {
+    if (rowCount_ == 0) {
+        featureCount_ = features.size();
+        wordsPerRow_ = (featureCount_ + 63) / 64;
+        packedRows_.clear();
+        tables_.assign(parameters_.bands, unordered_map<uint64_t, vector<int>>());
+    } else if (features.size() != featureCount_) {
+        throw invalid_argument("Training feature vectors must all have the same length");
+    }
+    vector<int> ids = binaryIds(features);
+
+    packedRows_.resize((rowCount_ + 1) * wordsPerRow_, 0);
+    packBinaryVector(features, packedRows_.data() + rowCount_ * wordsPerRow_);
+    vector<uint64_t> keys = bandKeys(ids);
+    for (int band = 0; band < parameters_.bands; ++band) {
+        tables_[band][keys[band]].push_back(static_cast<int>(rowCount_));
+    }
+    return rowCount_++;
+}
+
+// Copies the packed rows, tables and removal flags.
+shared_ptr<NeighborIndex> LSHIndex::clone() const {
+    return make_shared<LSHIndex>(*this);
+}
+
+// Re-ranks the colliding candidates by exact Hamming distance.
+vector<Neighbor> LSHIndex::search(const vector<double>& query, size_t k) const {
+    vector<int> rows = candidates(query);
+    vector<uint64_t> packedQuery(wordsPerRow_, 0);
+    packBinaryVector(query, packedQuery.data());
+
+    // Too few collisions to fill k neighbors: fall back to the exact scan.
+    size_t liveRows = rowCount_ - removedCount();
+    if (rows.size() < k && rows.size() < liveRows) {
+        rows.clear();
+        for (size_t i = 0; i < rowCount_; ++i) {
+            if (!isRemoved(i)) {
+                rows.push_back(static_cast<int>(i));
+            }
+        }
+    }
+
+    NeighborBuffer nearest(k);
+    for (int row : rows) {
+        nearest.offer(DistanceKernels::hammingDistance(packedQuery.data(), &packedRows_[row * wordsPerRow_], wordsPerRow_), row);
+    }
+    return nearest.neighbors();
+}
+
+// Training emails that share at least one band key with the query.
+vector<int> LSHIndex::candidates(const vector<double>& query) const {
+    if (!tables_.empty() && query.size() != featureCount_) {
+        throw invalid_argument("Feature vector length does not match the training data");
+    }
+    vector<uint64_t> keys = bandKeys(binaryIds(query));
+    vector<int> rows;
+    for (size_t band = 0; band < tables_.size(); ++band) {
+        auto bucket = tables_[band].find(keys[band]);
+        if (bucket != tables_[band].end()) {
+            rows.insert(rows.end(), bucket->second.begin(), bucket->second.end());
+        }
+    }
+    sort(rows.begin(), rows.end());
+    rows.erase(unique(rows.begin(), rows.end()), rows.end());
+    if (removedCount() > 0) {
+        rows.erase(remove_if(rows.begin(), rows.end(), [this](int row) { return isRemoved(row); }), rows.end());
+    }
+    return rows;
+}
+
+// Number of indexed training rows.
+size_t LSHIndex::size() const {
+    return rowCount_;
+}
+
+// Length of the vectors the index was built from.
+size_t LSHIndex::dimensions() const {
+    return featureCount_;
+}
+
+// Emails that never collide with the query are missed, so results are approximate.
+bool LSHIndex::isExact() const {
+    return false;
+}
+
+// Short description of the backend and its parameters.
+string LSHIndex::name() const {
+    ostringstream description;
+    description << "minhash lsh (bands=" << parameters_.bands << ", rows=" << parameters_.rowsPerBand << ")";
+    return description.str();
+}
+
+// Bytes held by the packed rows, the hash tables and their buckets.
+size_t LSHIndex::memoryBytes() const {
+    size_t bytes = packedRows_.capacity() * sizeof(uint64_t) + hashSeeds_.capacity() * sizeof(uint64_t);
+    for (const auto& table : tables_) {
+        bytes += table.bucket_count() * sizeof(void*);
+        for (const auto& bucket : table) {
+            bytes += sizeof(bucket) + bucket.second.capacity() * sizeof(int);
+        }
+    }
+    return bytes;
+}
+
+// Parameters the index was built with.
+const LSHIndex::Parameters& LSHIndex::parameters() const {
+    return parameters_;
+}
+
+// Computes one key per band by combining rowsPerBand MinHash values of the feature set.
+vector<uint64_t> LSHIndex::bandKeys(const vector<int>& featureIds) const {
+    vector<uint64_t> keys(parameters_.bands);
+    for (int band = 0; band < parameters_.bands; ++band) {
+        uint64_t key = static_cast<uint64_t>(band);
+        for (int r = 0; r < parameters_.rowsPerBand; ++r) {
+            uint64_t seed = hashSeeds_[band * parameters_.rowsPerBand + r];
+            uint64_t minHash = numeric_limits<uint64_t>::max();
+            for (int id : featureIds) {
+                minHash = min(minHash, mix64(static_cast<uint64_t>(id) ^ seed));
+            }
+            key = mix64(key ^ minHash);
+        }
+        keys[band] = key;
+    }
+    return keys;
+}
+
+// Converts a binary vector to feature ids, throwing if it is not binary.
+vector<int> LSHIndex::binaryIds(const vector<double>& features) {
+    if (!isBinaryVector(features)) {
+        throw invalid_argument("The LSH index requires binary (0/1) features");
+    }
+    return toFeatureIds(features);
+}
@@ -0,0 +1,83 @@
+#ifndef LSHINDEX_H
+#define LSHINDEX_H
+
+#include <vector>
+#include <utility>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+#include "NeighborIndex.h"
+#include "FeatureMatrix.h"
+
+using namespace std;
+
+// Approximate backend for binary feature vectors using MinHash locality-sensitive hashing.
+// Each email is reduced to bands x rowsPerBand MinHash values over its set of feature ids;
+// every band is hashed into its own table, and a query only looks at emails that collide with
+// it in at least one band. Candidates are re-ranked by exact Hamming distance.
+// Emails that share most of their features collide with high probability, so near-duplicates
+// (the common case for spam campaigns) are found while the rest of the corpus is skipped.
+class LSHIndex : public NeighborIndex {
+public:
+    // Recall/latency knobs. More bands raise recall and the number of candidates; more rows
+    // per band make each bucket more selective, lowering both.
+    struct Parameters {
+        int bands;
+        int rowsPerBand;
+        uint64_t seed;
+
+        Parameters() : bands(16), rowsPerBand(2), seed(2270) {}
+        Parameters(int bands, int rowsPerBand, uint64_t seed = 2270) : bands(bands), rowsPerBand(rowsPerBand), seed(seed) {}
+    };
+
+    // Constructor: Creates an empty index with the given parameters.
+    explicit LSHIndex(const Parameters& parameters = Parameters());
+
+    // Hashes every training email into the band tables; throws if any feature is not 0 or 1.
+    void build(const vector<vector<double>>& features) override;
+
+    // Returns up to k nearest emails among the colliding candidates, nearest first. If fewer
+    // than k emails collide, the whole training set is scanned so k neighbors are always found.
+    vector<Neighbor> search(const vector<double>& query, size_t k) const override;
+
+    // Training emails that share at least one band with the query, in ascending order (removed
+    // emails excluded).
+    vector<int> candidates(const vector<double>& query) const;
+
+    // Hashes a binary email into the band tables.
+    size_t append(const vector<double>& features) override;
+
+    shared_ptr<NeighborIndex> clone() const override;
+
+    size_t size() const override;
+    size_t dimensions() const override;
+    bool isExact() const override;
+    string name() const override;
+    size_t memoryBytes() const override;
+
+    // Parameters the index was built with.
+    const Parameters& parameters() const;
+
+private:
+    Parameters parameters_;
+    size_t rowCount_;
+    size_t featureCount_;
+    size_t wordsPerRow_;
+
+    // Packed training rows used to re-rank candidates.
+    vector<uint64_t, AlignedAllocator<uint64_t>> packedRows_;
+
+    // One hash table per band: band key -> emails with that key.
+    vector<unordered_map<uint64_t, vector<int>>> tables_;
+
+    // Per-hash seeds, bands * rowsPerBand of them.
+    vector<uint64_t> hashSeeds_;
+
+    // Computes the band keys of a sorted feature-id list.
+    vector<uint64_t> bandKeys(const vector<int>& featureIds) const;
+
+    // Converts a binary query vector to feature ids, throwing if it is not binary.
+    static vector<int> binaryIds(const vector<double>& features);
+};
+
+#endif // LSHINDEX_H
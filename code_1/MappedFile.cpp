@@ -0,0 +1,88 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Constructor: Creates an empty mapping.
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+// Constructor: Maps the given file.
+MappedFile::MappedFile(const string& path) : data_(nullptr), size_(0) {
+    open(path);
+}
+
+// Destructor: Unmaps the file.
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        swap(data_, other.data_);
+        swap(size_, other.size_);
+    }
+    return *this;
+}
+
+// Maps the given file read-only, replacing the current mapping. Empty files map to an empty view.
+void MappedFile::open(const string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Failed to open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw runtime_error("Failed to read file size: " + path);
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw runtime_error("Failed to map file: " + path);
+        }
+        // The readers walk the file front to back once.
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapping);
+        size_ = size;
+    }
+    ::close(fd); // The mapping keeps its own reference to the file.
+}
+
+// Unmaps the file; views into it become invalid.
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// First byte of the file, or nullptr if nothing is mapped.
+const char* MappedFile::data() const {
+    return data_;
+}
+
+// Size of the mapped file in bytes.
+size_t MappedFile::size() const {
+    return size_;
+}
+
+// The whole file as a view.
+string_view MappedFile::view() const {
+    return string_view(data_, size_);
+}
@@ -0,0 +1,48 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+using namespace std;
+
+// Read-only memory mapping of a whole file. The contents can be viewed in place without
+// reading them into a buffer; views into the file stay valid until the mapping is closed.
+class MappedFile {
+public:
+    // Constructor: Creates an empty mapping.
+    MappedFile();
+
+    // Constructor: Maps the given file; throws runtime_error if it cannot be opened or mapped.
+    explicit MappedFile(const string& path);
+
+    // Destructor: Unmaps the file.
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Maps the given file, replacing the current mapping.
+    void open(const string& path);
+
+    // Unmaps the file; views into it become invalid.
+    void close();
+
+    // First byte of the file, or nullptr if nothing is mapped.
+    const char* data() const;
+
+    // Size of the mapped file in bytes.
+    size_t size() const;
+
+    // The whole file as a view.
+    string_view view() const;
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,204 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+const size_t LatencyHistogram::exactBuckets;
+const size_t LatencyHistogram::subBuckets;
+const size_t LatencyHistogram::bucketCount;
+
+// Constructor: Starts empty.
+LatencyHistogram::LatencyHistogram() : count_(0), total_(0), max_(0) {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+// One relaxed increment per bucket and total; the maximum is raised with a CAS loop that
+// rarely iterates.
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    buckets_[bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+    total_.fetch_add(nanoseconds, memory_order_relaxed);
+    uint64_t seen = max_.load(memory_order_relaxed);
+    while (nanoseconds > seen && !max_.compare_exchange_weak(seen, nanoseconds, memory_order_relaxed)) {
+    }
+}
+
+// Number of recorded durations.
+uint64_t LatencyHistogram::count() const {
+    return count_.load(memory_order_relaxed);
+}
+
+// Sum of the recorded durations.
+uint64_t LatencyHistogram::totalNanoseconds() const {
+    return total_.load(memory_order_relaxed);
+}
+
+// Largest recorded duration.
+uint64_t LatencyHistogram::maxNanoseconds() const {
+    return max_.load(memory_order_relaxed);
+}
+
+// Walks the buckets to the one holding the ceil(p * count)-th smallest duration.
+double LatencyHistogram::percentileNanoseconds(double p) const {
+    uint64_t total = 0;
+    array<uint64_t, bucketCount> counts;
+    for (size_t b = 0; b < bucketCount; ++b) {
+        counts[b] = buckets_[b].load(memory_order_relaxed);
+        total += counts[b];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(min(max(p, 0.0), 1.0) * total)));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < bucketCount; ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return min(bucketMidpoint(b), static_cast<double>(maxNanoseconds()));
+        }
+    }
+    return static_cast<double>(maxNanoseconds());
+}
+
+// Not atomic as a whole: durations recorded while resetting may survive partially.
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+    count_.store(0, memory_order_relaxed);
+    total_.store(0, memory_order_relaxed);
+    max_.store(0, memory_order_relaxed);
+}
+
+// For 2^e <= v < 2^(e+1), the three bits below the leading one pick the sub-bucket.
+size_t LatencyHistogram::bucketOf(uint64_t nanoseconds) {
+    if (nanoseconds < exactBuckets) {
+        return static_cast<size_t>(nanoseconds);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(nanoseconds));
+    size_t sub = static_cast<size_t>(nanoseconds >> (exponent - 3)) & (subBuckets - 1);
+    return exactBuckets + (exponent - 4) * subBuckets + sub;
+}
+
+// Middle of the durations that fall into a bucket.
+double LatencyHistogram::bucketMidpoint(size_t bucket) {
+    if (bucket < exactBuckets) {
+        return static_cast<double>(bucket);
+    }
+    size_t exponent = (bucket - exactBuckets) / subBuckets + 4;
+    size_t sub = (bucket - exactBuckets) % subBuckets;
+    double width = ldexp(1.0, static_cast<int>(exponent) - 3);
+    return (subBuckets + sub) * width + width / 2;
+}
+
+// Leaked on purpose so that metrics recorded during static destruction stay valid.
+Metrics& Metrics::global() {
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+// Looks the counter up, creating it on first use.
+Counter& Metrics::counter(const string& name) {
+    lock_guard<mutex> guard(lock_);
+    unique_ptr<Counter>& entry = counters_[name];
+    if (!entry) {
+        entry.reset(new Counter());
+    }
+    return *entry;
+}
+
+// Looks the histogram up, creating it on first use.
+LatencyHistogram& Metrics::histogram(const string& name) {
+    lock_guard<mutex> guard(lock_);
+    unique_ptr<LatencyHistogram>& entry = histograms_[name];
+    if (!entry) {
+        entry.reset(new LatencyHistogram());
+    }
+    return *entry;
+}
+
+// Zeroes every metric in place, so cached references stay valid.
+void Metrics::reset() {
+    lock_guard<mutex> guard(lock_);
+    for (auto& entry : counters_) {
+        entry.second->reset();
+    }
+    for (auto& entry : histograms_) {
+        entry.second->reset();
+    }
+}
+
+// Durations in microseconds, totals in milliseconds.
+void Metrics::print(ostream& out) const {
+    lock_guard<mutex> guard(lock_);
+    if (!enabled()) {
+        out << "Metrics were compiled out (KNN_METRICS=0)." << endl;
+        return;
+    }
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(1);
+    out << left << setw(36) << "stage" << right << setw(10) << "count" << setw(12) << "mean us" << setw(12) << "p50 us"
+        << setw(12) << "p99 us" << setw(12) << "p999 us" << setw(12) << "max us" << setw(12) << "total ms" << endl;
+    for (const auto& entry : histograms_) {
+        const LatencyHistogram& histogram = *entry.second;
+        uint64_t count = histogram.count();
+        double mean = count > 0 ? histogram.totalNanoseconds() / 1e3 / count : 0.0;
+        out << left << setw(36) << entry.first << right << setw(10) << count << setw(12) << mean
+            << setw(12) << histogram.percentileNanoseconds(0.50) / 1e3 << setw(12) << histogram.percentileNanoseconds(0.99) / 1e3
+            << setw(12) << histogram.percentileNanoseconds(0.999) / 1e3 << setw(12) << histogram.maxNanoseconds() / 1e3
+            << setw(12) << histogram.totalNanoseconds() / 1e6 << endl;
+    }
+    for (const auto& entry : counters_) {
+        out << left << setw(36) << entry.first << right << setw(10) << entry.second->value() << endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// Metric names are plain identifiers with dots, so they need no escaping.
+void Metrics::writeJson(ostream& out) const {
+    lock_guard<mutex> guard(lock_);
+    ostringstream json;
+    json << setprecision(6) << "{\"enabled\":" << (enabled() ? "true" : "false") << ",\"counters\":{";
+    bool first = true;
+    for (const auto& entry : counters_) {
+        json << (first ? "" : ",") << '"' << entry.first << "\":" << entry.second->value();
+        first = false;
+    }
+    json << "},\"histograms\":{";
+    first = true;
+    for (const auto& entry : histograms_) {
+        const LatencyHistogram& histogram = *entry.second;
+        uint64_t count = histogram.count();
+        json << (first ? "" : ",") << '"' << entry.first << "\":{\"count\":" << count
+             << ",\"meanMicroseconds\":" << (count > 0 ? histogram.totalNanoseconds() / 1e3 / count : 0.0)
+             << ",\"p50Microseconds\":" << histogram.percentileNanoseconds(0.50) / 1e3
+             << ",\"p99Microseconds\":" << histogram.percentileNanoseconds(0.99) / 1e3
+             << ",\"p999Microseconds\":" << histogram.percentileNanoseconds(0.999) / 1e3
+             << ",\"maxMicroseconds\":" << histogram.maxNanoseconds() / 1e3
+             << ",\"totalMilliseconds\":" << histogram.totalNanoseconds() / 1e6 << '}';
+        first = false;
+    }
+    json << "}}\n";
+    out << json.str();
+}
+
+// Writes the JSON form to a file.
+void Metrics::writeJsonFile(const string& path) const {
+    ofstream file(path);
+    if (!file.is_open()) {
+        throw runtime_error("Failed to open file: " + path);
+    }
+    writeJson(file);
+    file.close();
+    if (file.fail()) {
+        throw runtime_error("Failed to write file: " + path);
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Per-stage instrumentation: named counters and latency histograms in one process-wide
+// registry, filled through the KNN_TIMED_SCOPE / KNN_RECORD_NANOSECONDS / KNN_COUNT macros.
+// Recording is lock-free (relaxed atomics); the registry lock is only taken the first time a
+// call site runs, because each macro caches its metric in a function-local static.
+// Build with KNN_METRICS=0 (CMake option KNN_METRICS=OFF) to compile every macro to nothing;
+// the registry then stays empty.
+#ifndef KNN_METRICS
+#define KNN_METRICS 1
+#endif
+
+// Monotonic event or byte count.
+class Counter {
+public:
+    Counter() : value_(0) {}
+
+    // Adds to the count.
+    void add(uint64_t amount) { value_.fetch_add(amount, memory_order_relaxed); }
+
+    // Current count.
+    uint64_t value() const { return value_.load(memory_order_relaxed); }
+
+    // Sets the count back to zero.
+    void reset() { value_.store(0, memory_order_relaxed); }
+
+private:
+    atomic<uint64_t> value_;
+};
+
+// Log-linear histogram of durations in nanoseconds.
+// Values below 16 ns get their own bucket; above that, every power of two is split into 8
+// buckets, so a percentile is within 1/16 of the true value (the bucket midpoint is reported).
+// The exact count, sum and maximum are kept alongside.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    // Records one duration.
+    void record(uint64_t nanoseconds);
+
+    // Number of recorded durations.
+    uint64_t count() const;
+
+    // Sum of the recorded durations.
+    uint64_t totalNanoseconds() const;
+
+    // Largest recorded duration.
+    uint64_t maxNanoseconds() const;
+
+    // Duration below which a fraction p (0..1) of the recorded ones fall; 0 if empty.
+    double percentileNanoseconds(double p) const;
+
+    // Forgets every recorded duration.
+    void reset();
+
+private:
+    static const size_t exactBuckets = 16;
+    static const size_t subBuckets = 8;
+    static const size_t bucketCount = exactBuckets + (64 - 4) * subBuckets;
+
+    array<atomic<uint64_t>, bucketCount> buckets_;
+    atomic<uint64_t> count_;
+    atomic<uint64_t> total_;
+    atomic<uint64_t> max_;
+
+    // Bucket of a duration, and the range of durations a bucket holds.
+    static size_t bucketOf(uint64_t nanoseconds);
+    static double bucketMidpoint(size_t bucket);
+};
+
+// Records the lifetime of the scope into a histogram.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram) : histogram_(histogram), start_(chrono::steady_clock::now()) {}
+
+    ~ScopedTimer() {
+        histogram_.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_).count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram_;
+    chrono::steady_clock::time_point start_;
+};
+
+// Registry of the named metrics. Metrics are created on first use and never destroyed, so
+// references to them stay valid.
+class Metrics {
+public:
+    // The process-wide registry.
+    static Metrics& global();
+
+    // True unless the build compiled the instrumentation out.
+    static constexpr bool enabled() { return KNN_METRICS != 0; }
+
+    // The counter or histogram with this name, created if needed.
+    Counter& counter(const string& name);
+    LatencyHistogram& histogram(const string& name);
+
+    // Zeroes every metric (names are kept).
+    void reset();
+
+    // Human-readable table: one line per histogram (count, mean, p50/p99/p999, max, total)
+    // and per counter, sorted by name.
+    void print(ostream& out) const;
+
+    // The same as a JSON object: {"enabled": bool, "counters": {name: value}, "histograms":
+    // {name: {...}}}, with durations in microseconds; enabled is false when the build compiled
+    // the instrumentation out.
+    void writeJson(ostream& out) const;
+
+    // Writes the JSON object to a file; throws runtime_error if it cannot be written.
+    void writeJsonFile(const string& path) const;
+
+private:
+    mutable mutex lock_;
+    map<string, unique_ptr<Counter>> counters_;
+    map<string, unique_ptr<LatencyHistogram>> histograms_;
+};
+
+#define KNN_METRICS_CONCAT_INNER(a, b) a##b
+#define KNN_METRICS_CONCAT(a, b) KNN_METRICS_CONCAT_INNER(a, b)
+
+#if KNN_METRICS
+// Times the rest of the enclosing scope into histogram `name`.
+#define KNN_TIMED_SCOPE(name)                                                                           \
+    static LatencyHistogram& KNN_METRICS_CONCAT(knnHistogram_, __LINE__) = Metrics::global().histogram(name); \
+    ScopedTimer KNN_METRICS_CONCAT(knnTimer_, __LINE__)(KNN_METRICS_CONCAT(knnHistogram_, __LINE__))
+
+// Records a duration measured by the caller into histogram `name`.
+#define KNN_RECORD_NANOSECONDS(name, nanoseconds)                                   \
+    do {                                                                            \
+        static LatencyHistogram& knnHistogram = Metrics::global().histogram(name);  \
+        knnHistogram.record(nanoseconds);                                           \
+    } while (0)
+
+// Adds amount to counter `name`.
+#define KNN_COUNT(name, amount)                                          \
+    do {                                                                 \
+        static Counter& knnCounter = Metrics::global().counter(name);    \
+        knnCounter.add(amount);                                          \
+    } while (0)
+#else
+#define KNN_TIMED_SCOPE(name) static_cast<void>(0)
+#define KNN_RECORD_NANOSECONDS(name, nanoseconds) static_cast<void>(0)
+#define KNN_COUNT(name, amount) static_cast<void>(0)
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,263 @@
+#include "ModelSnapshot.h"
+#include "NeighborIndex.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+const char ModelSnapshot::magicBytes[8] = {'K', 'N', 'N', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t ModelSnapshot::formatVersion;
+const uint32_t ModelSnapshot::byteOrderMark;
+const size_t ModelSnapshot::sectionAlignment;
+
+// Constructor: Creates an empty, unloaded snapshot.
+ModelSnapshot::ModelSnapshot() : header_(nullptr) {}
+
+// Constructor: Loads the given snapshot file.
+ModelSnapshot::ModelSnapshot(const string& path) : header_(nullptr) {
+    load(path);
+}
+
+// Lays the sections out in one buffer and writes it through a temporary file.
+void ModelSnapshot::write(const string& path, int k, int N, const vector<string>& topFeatures, const vector<vector<double>>& features, const vector<bool>& labels, uint64_t sourceFingerprint) {
+    if (features.size() != labels.size()) {
+        throw invalid_argument("Training features and labels must have the same length");
+    }
+    size_t featureCount = topFeatures.size();
+    size_t wordsPerRow = (featureCount + 63) / 64;
+    for (const auto& row : features) {
+        if (row.size() != featureCount) {
+            throw invalid_argument("Training feature vectors must match the vocabulary size");
+        }
+        if (!NeighborIndex::isBinaryVector(row)) {
+            throw invalid_argument("Model snapshots require binary features");
+        }
+    }
+
+    size_t wordBytes = 0;
+    for (const auto& word : topFeatures) {
+        wordBytes += word.size();
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magicBytes, sizeof(header.magic));
+    header.version = formatVersion;
+    header.byteOrder = byteOrderMark;
+    header.k = k;
+    header.N = N;
+    header.rowCount = features.size();
+    header.featureCount = featureCount;
+    header.wordsPerRow = wordsPerRow;
+    header.sourceFingerprint = sourceFingerprint;
+    header.vocabularyOffset = alignSection(sizeof(Header));
+    header.vocabularyBytes = (featureCount + 1) * sizeof(uint32_t) + wordBytes;
+    header.labelsOffset = alignSection(header.vocabularyOffset + header.vocabularyBytes);
+    header.matrixOffset = alignSection(header.labelsOffset + features.size());
+    header.fileBytes = header.matrixOffset + features.size() * wordsPerRow * sizeof(uint64_t);
+
+    vector<char> image(header.fileBytes, 0);
+
+    // Vocabulary: end offsets of each word (relative to the word bytes), then the words.
+    char* vocabulary = image.data() + header.vocabularyOffset;
+    char* words = vocabulary + (featureCount + 1) * sizeof(uint32_t);
+    uint32_t offset = 0;
+    memcpy(vocabulary, &offset, sizeof(offset));
+    for (size_t i = 0; i < featureCount; ++i) {
+        memcpy(words + offset, topFeatures[i].data(), topFeatures[i].size());
+        offset += static_cast<uint32_t>(topFeatures[i].size());
+        memcpy(vocabulary + (i + 1) * sizeof(uint32_t), &offset, sizeof(offset));
+    }
+
+    for (size_t i = 0; i < labels.size(); ++i) {
+        image[header.labelsOffset + i] = labels[i] ? 1 : 0;
+    }
+
+    uint64_t* matrix = reinterpret_cast<uint64_t*>(image.data() + header.matrixOffset);
+    for (size_t i = 0; i < features.size(); ++i) {
+        NeighborIndex::packBinaryVector(features[i], matrix + i * wordsPerRow);
+    }
+
+    memcpy(image.data(), &header, sizeof(header));
+    header.checksum = checksum(image.data(), image.size());
+    memcpy(image.data(), &header, sizeof(header));
+
+    string temporaryPath = path + ".tmp";
+    {
+        ofstream out(temporaryPath, ios::binary | ios::trunc);
+        if (!out) {
+            throw runtime_error("Failed to create model snapshot: " + temporaryPath);
+        }
+        out.write(image.data(), static_cast<streamsize>(image.size()));
+        if (!out) {
+            throw runtime_error("Failed to write model snapshot: " + temporaryPath);
+        }
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        throw runtime_error("Failed to replace model snapshot: " + path);
+    }
+}
+
+// Maps the file and validates it before exposing any of its sections.
+void ModelSnapshot::load(const string& path) {
+    header_ = nullptr;
+    file_.open(path);
+
+    const char* data = file_.data();
+    size_t size = file_.size();
+    if (size < sizeof(Header)) {
+        throw runtime_error("Model snapshot is truncated: " + path);
+    }
+    Header header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, magicBytes, sizeof(header.magic)) != 0) {
+        throw runtime_error("Not a model snapshot: " + path);
+    }
+    if (header.version != formatVersion || header.byteOrder != byteOrderMark) {
+        throw runtime_error("Unsupported model snapshot version: " + path);
+    }
+    if (header.fileBytes != size
+        || header.wordsPerRow != (header.featureCount + 63) / 64
+        || header.vocabularyOffset < sizeof(Header)
+        || header.vocabularyBytes < (header.featureCount + 1) * sizeof(uint32_t)
+        || header.labelsOffset < header.vocabularyOffset + header.vocabularyBytes
+        || header.matrixOffset < header.labelsOffset + header.rowCount
+        || header.matrixOffset % sectionAlignment != 0
+        || header.matrixOffset > size
+        || (size - header.matrixOffset) / sizeof(uint64_t) / max<uint64_t>(1, header.wordsPerRow) < header.rowCount) {
+        throw runtime_error("Model snapshot is truncated or malformed: " + path);
+    }
+    if (checksum(data, size) != header.checksum) {
+        throw runtime_error("Model snapshot checksum mismatch: " + path);
+    }
+
+    // Word offsets must stay inside the vocabulary section.
+    const char* vocabulary = data + header.vocabularyOffset;
+    uint64_t wordBytes = header.vocabularyBytes - (header.featureCount + 1) * sizeof(uint32_t);
+    uint32_t previous = 0;
+    for (size_t i = 0; i <= header.featureCount; ++i) {
+        uint32_t offset;
+        memcpy(&offset, vocabulary + i * sizeof(uint32_t), sizeof(offset));
+        if (offset < previous || offset > wordBytes || (i == 0 && offset != 0)) {
+            throw runtime_error("Model snapshot vocabulary is malformed: " + path);
+        }
+        previous = offset;
+    }
+
+    header_ = reinterpret_cast<const Header*>(data);
+}
+
+// Parameters the model was trained with.
+int ModelSnapshot::k() const {
+    return header_ != nullptr ? header_->k : 0;
+}
+
+int ModelSnapshot::N() const {
+    return header_ != nullptr ? header_->N : 0;
+}
+
+// Fingerprint of the training data recorded at write time.
+uint64_t ModelSnapshot::sourceFingerprint() const {
+    return header_ != nullptr ? header_->sourceFingerprint : 0;
+}
+
+// Number of training rows.
+size_t ModelSnapshot::rowCount() const {
+    return header_ != nullptr ? header_->rowCount : 0;
+}
+
+// Number of features per row.
+size_t ModelSnapshot::featureCount() const {
+    return header_ != nullptr ? header_->featureCount : 0;
+}
+
+// Packed rows, viewed in the mapping (the section is 64-byte aligned within a page-aligned map).
+const uint64_t* ModelSnapshot::packedRows() const {
+    if (header_ == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<const uint64_t*>(file_.data() + header_->matrixOffset);
+}
+
+// Number of 64-bit words per packed row.
+size_t ModelSnapshot::wordsPerRow() const {
+    return header_ != nullptr ? header_->wordsPerRow : 0;
+}
+
+// Copies the vocabulary words out of the mapping.
+vector<string> ModelSnapshot::vocabulary() const {
+    vector<string> words;
+    if (header_ == nullptr) {
+        return words;
+    }
+    const char* offsets = file_.data() + header_->vocabularyOffset;
+    const char* text = offsets + (header_->featureCount + 1) * sizeof(uint32_t);
+    words.reserve(header_->featureCount);
+    for (size_t i = 0; i < header_->featureCount; ++i) {
+        uint32_t begin, end;
+        memcpy(&begin, offsets + i * sizeof(uint32_t), sizeof(begin));
+        memcpy(&end, offsets + (i + 1) * sizeof(uint32_t), sizeof(end));
+        words.emplace_back(text + begin, end - begin);
+    }
+    return words;
+}
+
+// Copies the labels out of the mapping.
+vector<bool> ModelSnapshot::labels() const {
+    vector<bool> result;
+    if (header_ == nullptr) {
+        return result;
+    }
+    const char* labels = file_.data() + header_->labelsOffset;
+    result.reserve(header_->rowCount);
+    for (size_t i = 0; i < header_->rowCount; ++i) {
+        result.push_back(labels[i] != 0);
+    }
+    return result;
+}
+
+// Hashes each file's path, size and modification time.
+uint64_t ModelSnapshot::fingerprintFiles(const vector<string>& paths) {
+    uint64_t fingerprint = 14695981039346656037ULL;
+    auto mix = [&](const void* bytes, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(bytes);
+        for (size_t i = 0; i < size; ++i) {
+            fingerprint = (fingerprint ^ p[i]) * 1099511628211ULL;
+        }
+    };
+    for (const auto& path : paths) {
+        mix(path.data(), path.size());
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) {
+            int64_t fields[3] = {static_cast<int64_t>(info.st_size), static_cast<int64_t>(info.st_mtim.tv_sec), static_cast<int64_t>(info.st_mtim.tv_nsec)};
+            mix(fields, sizeof(fields));
+        }
+    }
+    return fingerprint;
+}
+
+// Rounds an offset up to the section alignment.
+size_t ModelSnapshot::alignSection(size_t offset) {
+    return (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+}
+
+// A word-at-a-time multiply-xorshift hash: fast enough to check large matrices at load time.
+// The header's checksum field is hashed as zero so the stored value can cover the header too.
+uint64_t ModelSnapshot::checksum(const char* data, size_t size) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = size * multiplier;
+    static_assert(offsetof(Header, checksum) % 8 == 0, "checksum field must be word aligned");
+    size_t checksumOffset = offsetof(Header, checksum);
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word = 0;
+        if (i != checksumOffset) {
+            memcpy(&word, data + i, min<size_t>(8, size - i));
+        }
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
@@ -0,0 +1,97 @@
+#ifndef MODELSNAPSHOT_H
+#define MODELSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "MappedFile.h"
+
+using namespace std;
+
+// Binary snapshot of a trained model: the top feature vocabulary, the packed binary training
+// matrix, the labels and the k and N it was trained with.
+// The file is a fixed header followed by 64-byte aligned sections, all in native byte order:
+//   header | vocabulary (featureCount + 1 uint32 offsets, then the word bytes)
+//          | labels (one byte per row) | matrix (rowCount * wordsPerRow uint64 words)
+// Loading maps the file and checks the magic, version, byte order, section bounds and a
+// checksum of the whole file; the matrix is then used in place, with no parsing.
+class ModelSnapshot {
+public:
+    // Version written into new snapshots; other versions are rejected by load.
+    static const uint32_t formatVersion = 1;
+
+    // Constructor: Creates an empty, unloaded snapshot.
+    ModelSnapshot();
+
+    // Constructor: Loads the given snapshot file (see load).
+    explicit ModelSnapshot(const string& path);
+
+    // Writes a snapshot of a trained model. The features must be binary; sourceFingerprint
+    // identifies the training data it was built from (see fingerprintFiles). The file is
+    // written next to the target and renamed over it, so readers never see a partial file.
+    // Throws invalid_argument for non-binary or inconsistent input, runtime_error on I/O errors.
+    static void write(const string& path, int k, int N, const vector<string>& topFeatures, const vector<vector<double>>& features, const vector<bool>& labels, uint64_t sourceFingerprint);
+
+    // Maps and validates a snapshot file; throws runtime_error if it is missing, truncated,
+    // of another version or fails its checksum.
+    void load(const string& path);
+
+    // Parameters the model was trained with.
+    int k() const;
+    int N() const;
+
+    // Fingerprint of the training data recorded at write time.
+    uint64_t sourceFingerprint() const;
+
+    // Number of training rows and of features (vocabulary words) per row.
+    size_t rowCount() const;
+    size_t featureCount() const;
+
+    // Packed training rows, wordsPerRow() 64-bit words each, viewed in the mapping.
+    const uint64_t* packedRows() const;
+    size_t wordsPerRow() const;
+
+    // Copies of the vocabulary and labels.
+    vector<string> vocabulary() const;
+    vector<bool> labels() const;
+
+    // Fingerprint of a set of files from their paths, sizes and modification times; changes
+    // whenever one of them is replaced or edited. Missing files contribute only their path.
+    static uint64_t fingerprintFiles(const vector<string>& paths);
+
+private:
+    // On-disk header; every field is fixed width.
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        int32_t k;
+        int32_t N;
+        uint64_t rowCount;
+        uint64_t featureCount;
+        uint64_t wordsPerRow;
+        uint64_t sourceFingerprint;
+        uint64_t vocabularyOffset;
+        uint64_t vocabularyBytes;
+        uint64_t labelsOffset;
+        uint64_t matrixOffset;
+        uint64_t fileBytes;
+        uint64_t checksum;
+    };
+
+    static const char magicBytes[8];
+    static const uint32_t byteOrderMark = 0x01020304;
+    static const size_t sectionAlignment = 64;
+
+    MappedFile file_;
+    const Header* header_;
+
+    // Rounds an offset up to the section alignment.
+    static size_t alignSection(size_t offset);
+
+    // Checksum of a file image, computed with the header's checksum field taken as zero.
+    static uint64_t checksum(const char* data, size_t size);
+};
+
+#endif // MODELSNAPSHOT_H
@@ -0,0 +1,24 @@
+#include "NeighborBuffer.h"
+
+const size_t NeighborBuffer::inlineCapacity;
+
+// Constructor: Creates an empty buffer.
+NeighborBuffer::NeighborBuffer(size_t k) : k_(0), size_(0), threshold_(0.0), thresholdIndex_(0) {
+    reset(k);
+}
+
+// Only a k above the inline capacity needs the vector.
+void NeighborBuffer::reset(size_t k) {
+    k_ = k;
+    size_ = 0;
+    threshold_ = numeric_limits<double>::infinity();
+    thresholdIndex_ = numeric_limits<int>::max();
+    if (k_ > inlineCapacity) {
+        overflow_.resize(k_);
+    }
+}
+
+// Copies the kept neighbors out.
+vector<Neighbor> NeighborBuffer::neighbors() const {
+    return vector<Neighbor>(items(), items() + size_);
+}
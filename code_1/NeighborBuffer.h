@@ -0,0 +1,112 @@
+#ifndef NEIGHBORBUFFER_H
+#define NEIGHBORBUFFER_H
+
+#include <array>
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include "NeighborIndex.h"
+
+using namespace std;
+
+// The k nearest candidates seen so far, kept sorted nearest first (ties by lower index), as
+// every search backend needs them. For the small k used in practice an insertion-sorted array
+// beats a binary heap: a rejected candidate costs one comparison against the farthest kept
+// neighbor, an accepted one a short shift, and the result is already in order, with no heap
+// allocation when k is at most inlineCapacity. The result is the k smallest (distance, index)
+// pairs whatever order the candidates are offered in.
+class NeighborBuffer {
+public:
+    // Neighbors kept inside the object; larger k use a vector.
+    static const size_t inlineCapacity = 16;
+
+    // Constructor: Creates an empty buffer that keeps up to k neighbors.
+    explicit NeighborBuffer(size_t k = 0);
+
+    // Empties the buffer and sets how many neighbors it keeps.
+    void reset(size_t k);
+
+    // Keeps the candidate if it is among the k nearest seen so far.
+    void offer(double distance, int index);
+
+    // Distance a candidate must beat to be kept: the farthest kept distance once the buffer is
+    // full, infinity before.
+    double threshold() const;
+
+    // Number of neighbors kept.
+    size_t size() const;
+
+    // True once k neighbors at distance 0 are kept. Nothing offered later with a higher index
+    // can displace them, so a scan in ascending index order can stop there.
+    bool settled() const;
+
+    // The kept neighbors, nearest first.
+    vector<Neighbor> neighbors() const;
+
+private:
+    size_t k_;
+    size_t size_;
+    double threshold_;
+    int thresholdIndex_;
+    array<Neighbor, inlineCapacity> inline_;
+    vector<Neighbor> overflow_;
+
+    // Storage in use.
+    Neighbor* items();
+    const Neighbor* items() const;
+};
+
+// The scan loops call offer once per training row, so it is kept in the header to be inlined.
+// The farthest kept neighbor is cached, so a candidate that does not make the cut (including
+// a tie with it, which loses on index) is rejected without touching the array.
+inline void NeighborBuffer::offer(double distance, int index) {
+    if (!(distance < threshold_)) {
+        // Evaluated without branching on the tie, which would be unpredictable when distances
+        // are small integers such as Hamming distances.
+        if ((distance > threshold_) | (index > thresholdIndex_)) {
+            return;
+        }
+    }
+    // A buffer of size 0 keeps nothing and its threshold stays infinite, so the check is made
+    // here, off the rejection path, but before the array is touched.
+    if (k_ == 0) {
+        return;
+    }
+    Neighbor* kept = items();
+    Neighbor candidate(distance, index);
+    if (size_ == k_) {
+        --size_;
+    }
+    size_t slot = size_;
+    while (slot > 0 && candidate < kept[slot - 1]) {
+        kept[slot] = kept[slot - 1];
+        --slot;
+    }
+    kept[slot] = candidate;
+    if (++size_ == k_) {
+        threshold_ = kept[size_ - 1].first;
+        thresholdIndex_ = kept[size_ - 1].second;
+    }
+}
+
+inline double NeighborBuffer::threshold() const {
+    return threshold_;
+}
+
+inline size_t NeighborBuffer::size() const {
+    return size_;
+}
+
+inline bool NeighborBuffer::settled() const {
+    return size_ == k_ && threshold_ == 0.0;
+}
+
+inline Neighbor* NeighborBuffer::items() {
+    return k_ <= inlineCapacity ? inline_.data() : overflow_.data();
+}
+
+inline const Neighbor* NeighborBuffer::items() const {
+    return k_ <= inlineCapacity ? inline_.data() : overflow_.data();
+}
+
+#endif // NEIGHBORBUFFER_H
@@ -0,0 +1,116 @@
+#include "NeighborIndex.h"
+
+#include <stdexcept>
+
+// Constructor: Creates an index with no removed rows.
+NeighborIndex::NeighborIndex() : removedCount_(0) {}
+
+NeighborIndex::~NeighborIndex() {}
+
+// Unpacks the rows and builds the index from them.
+void NeighborIndex::buildPacked(const uint64_t* rows, size_t rowCount, size_t featureCount) {
+    size_t wordsPerRow = (featureCount + 63) / 64;
+    vector<vector<double>> features;
+    features.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        features.push_back(unpackBinaryVector(rows + i * wordsPerRow, featureCount));
+    }
+    build(features);
+}
+
+// Backends that only support full rebuilds reject appends.
+size_t NeighborIndex::append(const vector<double>& features) {
+    throw logic_error(name() + " does not support adding rows");
+}
+
+// Records the removal; the flags are grown lazily so appends never touch them.
+void NeighborIndex::remove(size_t row) {
+    if (row >= size()) {
+        throw out_of_range("Row index outside the index");
+    }
+    if (removed_.size() <= row) {
+        removed_.resize(row + 1, 0);
+    }
+    if (!removed_[row]) {
+        removed_[row] = 1;
+        ++removedCount_;
+    }
+}
+
+// Returns true if the row was removed since the last build.
+bool NeighborIndex::isRemoved(size_t row) const {
+    return row < removed_.size() && removed_[row] != 0;
+}
+
+// Number of rows removed since the last build.
+size_t NeighborIndex::removedCount() const {
+    return removedCount_;
+}
+
+// Backends that cannot be copied reject cloning.
+shared_ptr<NeighborIndex> NeighborIndex::clone() const {
+    throw logic_error(name() + " cannot be copied");
+}
+
+// Forgets every removal.
+void NeighborIndex::clearRemoved() {
+    removed_.clear();
+    removedCount_ = 0;
+}
+
+// Searches many queries one at a time, writing each result into its query's slot.
+vector<vector<Neighbor>> NeighborIndex::searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool) const {
+    vector<vector<Neighbor>> results(queries.size());
+    auto searchRange = [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q) {
+            results[q] = search(queries[q], k);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(queries.size(), 16, searchRange);
+    } else {
+        searchRange(0, queries.size());
+    }
+    return results;
+}
+
+// Returns true if every value in the vector is 0.0 or 1.0.
+bool NeighborIndex::isBinaryVector(const vector<double>& features) {
+    for (double value : features) {
+        if (value != 0.0 && value != 1.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Packs a binary feature vector into 64-bit words; bit (j % 64) of word (j / 64) is feature j.
+void NeighborIndex::packBinaryVector(const vector<double>& features, uint64_t* words) {
+    for (size_t j = 0; j < features.size(); ++j) {
+        if (features[j] != 0.0) {
+            words[j / 64] |= uint64_t(1) << (j % 64);
+        }
+    }
+}
+
+// Expands packed bits back into a binary feature vector.
+vector<double> NeighborIndex::unpackBinaryVector(const uint64_t* words, size_t featureCount) {
+    vector<double> features(featureCount, 0.0);
+    for (size_t j = 0; j < featureCount; ++j) {
+        if ((words[j / 64] >> (j % 64)) & 1) {
+            features[j] = 1.0;
+        }
+    }
+    return features;
+}
+
+// Returns the ids of the non-zero features of a vector, in ascending order.
+vector<int> NeighborIndex::toFeatureIds(const vector<double>& features) {
+    vector<int> ids;
+    for (size_t j = 0; j < features.size(); ++j) {
+        if (features[j] != 0.0) {
+            ids.push_back(static_cast<int>(j));
+        }
+    }
+    return ids;
+}
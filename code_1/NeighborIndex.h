@@ -0,0 +1,96 @@
+#ifndef NEIGHBORINDEX_H
+#define NEIGHBORINDEX_H
+
+#include <vector>
+#include <utility>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// A search result: squared Euclidean distance to a training row and the row's index.
+typedef pair<double, int> Neighbor;
+
+// Interface of the nearest-neighbor search backends used by KNNClassifier.
+// Exact backends return the k smallest (distance, index) pairs, so they agree with each other
+// neighbor for neighbor; approximate backends trade some of those neighbors for speed.
+// Rows can also be added and removed after building: removed rows keep their index (so
+// results never renumber) but are skipped by every search until the next build.
+class NeighborIndex {
+public:
+    // Constructor: Creates an index with no removed rows.
+    NeighborIndex();
+
+    virtual ~NeighborIndex();
+
+    // Builds the index over the training vectors, replacing any previous contents.
+    virtual void build(const vector<vector<double>>& features) = 0;
+
+    // Builds the index from binary rows that are already packed (see packBinaryVector), e.g.
+    // straight out of a model snapshot. The default unpacks them and calls build.
+    virtual void buildPacked(const uint64_t* rows, size_t rowCount, size_t featureCount);
+
+    // Finds up to k nearest training rows, nearest first, ties broken by lower index.
+    virtual vector<Neighbor> search(const vector<double>& query, size_t k) const = 0;
+
+    // Searches many queries; results are in query order. The default runs search per query,
+    // spread over the pool when one is given.
+    virtual vector<vector<Neighbor>> searchBatch(const vector<vector<double>>& queries, size_t k, ThreadPool* pool = nullptr) const;
+
+    // Adds one training row after the existing ones and returns its index. The default throws
+    // logic_error for backends that can only be rebuilt.
+    virtual size_t append(const vector<double>& features);
+
+    // Marks a row as removed; later searches skip it. Throws out_of_range for a bad index.
+    virtual void remove(size_t row);
+
+    // Returns true if the row was removed since the last build.
+    bool isRemoved(size_t row) const;
+
+    // Number of rows removed since the last build (size() still counts them).
+    size_t removedCount() const;
+
+    // Independent copy of the index, used before modifying an index that is shared. The
+    // default throws logic_error.
+    virtual shared_ptr<NeighborIndex> clone() const;
+
+    // Number of indexed training rows.
+    virtual size_t size() const = 0;
+
+    // Length of the vectors the index was built from.
+    virtual size_t dimensions() const = 0;
+
+    // True if search always returns the exact k nearest rows.
+    virtual bool isExact() const = 0;
+
+    // Short description of the backend and its parameters.
+    virtual string name() const = 0;
+
+    // Bytes held by the index.
+    virtual size_t memoryBytes() const = 0;
+
+    // Returns true if every value in the vector is 0.0 or 1.0.
+    static bool isBinaryVector(const vector<double>& features);
+
+    // Packs a binary feature vector into 64-bit words; bit (j % 64) of word (j / 64) is feature j.
+    static void packBinaryVector(const vector<double>& features, uint64_t* words);
+
+    // Inverse of packBinaryVector: expands featureCount bits into a 0.0/1.0 vector.
+    static vector<double> unpackBinaryVector(const uint64_t* words, size_t featureCount);
+
+    // Returns the ids of the non-zero features of a vector, in ascending order.
+    static vector<int> toFeatureIds(const vector<double>& features);
+
+protected:
+    // Forgets every removal; called by build.
+    void clearRemoved();
+
+private:
+    // removed_[i] != 0 if row i was removed; only as long as the highest removed row.
+    vector<unsigned char> removed_;
+    size_t removedCount_;
+};
+
+#endif // NEIGHBORINDEX_H
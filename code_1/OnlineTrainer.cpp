@@ -0,0 +1,208 @@
+#include "OnlineTrainer.h"
+
+#include <stdexcept>
+#include <unordered_set>
+
+// Constructor: Creates an empty trainer.
+OnlineTrainer::OnlineTrainer(int k, int N, const Policy& policy, ThreadPool* pool)
+    : classifier_(k), N_(N), policy_(policy), pool_(pool), liveCount_(0), updatesSinceCheck_(0), revectorizations_(0) {}
+
+// Stores and counts every email, selects the features and trains on all of them.
+void OnlineTrainer::train(const vector<pair<pair<string, string>, bool>>& trainingData) {
+    emails_.clear();
+    rowOfEmail_.clear();
+    spamCounts_.clear();
+    hamCounts_.clear();
+    emails_.reserve(trainingData.size());
+    for (const auto& data : trainingData) {
+        emails_.push_back(StoredEmail{data.first.first, data.first.second, data.second, false});
+        rowOfEmail_.push_back(-1);
+        countWords(emails_.back(), 1);
+    }
+    liveCount_ = emails_.size();
+    revectorize(selectFeatures());
+}
+
+// Vectorizes the email with the features in use and appends it to the live classifier.
+int OnlineTrainer::addEmail(const string& subject, const string& message, bool isSpam) {
+    int id = static_cast<int>(emails_.size());
+    emails_.push_back(StoredEmail{subject, message, isSpam, false});
+    countWords(emails_.back(), 1);
+
+    int row = classifier_.append(vectorize(subject, message), isSpam);
+    rowOfEmail_.push_back(row);
+    emailOfRow_.push_back(id);
+    ++liveCount_;
+
+    noteUpdate();
+    return id;
+}
+
+// Uncounts the email's words and tombstones its classifier row.
+void OnlineTrainer::removeEmail(int emailId) {
+    if (emailId < 0 || static_cast<size_t>(emailId) >= emails_.size() || emails_[emailId].removed) {
+        throw out_of_range("Unknown email id");
+    }
+    StoredEmail& email = emails_[emailId];
+    countWords(email, -1);
+    classifier_.remove(rowOfEmail_[emailId]);
+    rowOfEmail_[emailId] = -1;
+    email.removed = true;
+    string().swap(email.subject);
+    string().swap(email.message);
+    --liveCount_;
+
+    noteUpdate();
+}
+
+// Re-vectorizes if forced, if the selected features drifted too far, or if too many rows
+// are tombstones.
+bool OnlineTrainer::refresh(bool force) {
+    updatesSinceCheck_ = 0;
+    vector<string> selected = selectFeatures();
+
+    size_t rows = classifier_.neighborIndex().size();
+    size_t removedRows = rows - classifier_.liveCount();
+    bool drifted = driftFrom(selected) >= policy_.maxFeatureDrift && selected != topFeatures_;
+    bool compact = rows > 0 && removedRows > 0 && static_cast<double>(removedRows) / rows >= policy_.maxRemovedFraction;
+    if (!force && !drifted && !compact) {
+        return false;
+    }
+    revectorize(selected);
+    return true;
+}
+
+// Vectorizes against the vocabulary in use.
+vector<double> OnlineTrainer::vectorize(string_view subject, string_view message) const {
+    FeatureExtractor extractor;
+    return extractor.extractFeatures(subject, message, vocabulary_);
+}
+
+// Classifier trained on the live emails.
+const KNNClassifier& OnlineTrainer::classifier() const {
+    return classifier_;
+}
+
+// Top features in use.
+const vector<string>& OnlineTrainer::topFeatures() const {
+    return topFeatures_;
+}
+
+// Drift of the currently selected features from the ones in use.
+double OnlineTrainer::featureDrift() const {
+    return driftFrom(selectFeatures());
+}
+
+// Number of live emails.
+size_t OnlineTrainer::liveCount() const {
+    return liveCount_;
+}
+
+// Number of re-vectorizations.
+size_t OnlineTrainer::revectorizations() const {
+    return revectorizations_;
+}
+
+// Classifier row of an email id.
+int OnlineTrainer::trainingIndex(int emailId) const {
+    if (emailId < 0 || static_cast<size_t>(emailId) >= rowOfEmail_.size()) {
+        throw out_of_range("Unknown email id");
+    }
+    return rowOfEmail_[emailId];
+}
+
+// Email id of a classifier row.
+int OnlineTrainer::emailId(int trainingIndex) const {
+    if (trainingIndex < 0 || static_cast<size_t>(trainingIndex) >= emailOfRow_.size()) {
+        throw out_of_range("Training index outside the training set");
+    }
+    return emailOfRow_[trainingIndex];
+}
+
+// Tokenizes the email once and adjusts the counts of its label; counts that reach zero are
+// erased so the maps only hold words of live emails.
+void OnlineTrainer::countWords(const StoredEmail& email, int delta) {
+    const Vocabulary& excluded = FeatureExtractor::excludedWords();
+    unordered_map<string, int>& counts = email.isSpam ? spamCounts_ : hamCounts_;
+    Tokenizer tokenizer;
+    string key;
+    auto countToken = [&](string_view token, uint64_t hash) {
+        if (excluded.find(token, hash) >= 0) {
+            return;
+        }
+        key.assign(token.data(), token.size());
+        auto entry = counts.emplace(key, 0).first;
+        entry->second += delta;
+        if (entry->second <= 0) {
+            counts.erase(entry);
+        }
+    };
+    tokenizer.scan(email.subject, countToken);
+    tokenizer.scan(email.message, countToken);
+}
+
+// Runs the balanced selection over the current counts.
+vector<string> OnlineTrainer::selectFeatures() const {
+    vector<pair<string, int>> frequencySpam(spamCounts_.begin(), spamCounts_.end());
+    vector<pair<string, int>> frequencyHam(hamCounts_.begin(), hamCounts_.end());
+    FeatureExtractor extractor;
+    return extractor.selectBalancedTopFeatures(frequencySpam, frequencyHam, N_);
+}
+
+// Fraction of the selected features that are not in use (1 if nothing is in use yet).
+double OnlineTrainer::driftFrom(const vector<string>& selected) const {
+    if (selected.empty()) {
+        return topFeatures_.empty() ? 0.0 : 1.0;
+    }
+    unordered_set<string> inUse(topFeatures_.begin(), topFeatures_.end());
+    size_t missing = 0;
+    for (const auto& feature : selected) {
+        missing += inUse.count(feature) == 0;
+    }
+    return static_cast<double>(missing) / selected.size();
+}
+
+// Vectorizes every live email with the new features and retrains; removed emails are dropped
+// and the live ones renumbered in id order.
+void OnlineTrainer::revectorize(const vector<string>& features) {
+    topFeatures_ = features;
+    vocabulary_.assign(topFeatures_);
+
+    emailOfRow_.clear();
+    for (size_t id = 0; id < emails_.size(); ++id) {
+        rowOfEmail_[id] = emails_[id].removed ? -1 : static_cast<int>(emailOfRow_.size());
+        if (!emails_[id].removed) {
+            emailOfRow_.push_back(static_cast<int>(id));
+        }
+    }
+
+    vector<vector<double>> vectors(emailOfRow_.size());
+    vector<bool> labels(emailOfRow_.size());
+    auto vectorizeRange = [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            const StoredEmail& email = emails_[emailOfRow_[row]];
+            vectors[row] = vectorize(email.subject, email.message);
+        }
+    };
+    if (pool_ != nullptr) {
+        pool_->parallelFor(vectors.size(), 64, vectorizeRange);
+    } else {
+        vectorizeRange(0, vectors.size());
+    }
+    for (size_t row = 0; row < labels.size(); ++row) {
+        labels[row] = emails_[emailOfRow_[row]].isSpam;
+    }
+
+    classifier_.train(vectors, labels);
+    updatesSinceCheck_ = 0;
+    ++revectorizations_;
+}
+
+// Counts an update and applies the policy every checkInterval updates (or right away while no
+// features are in use, so a trainer started empty picks its first features immediately).
+void OnlineTrainer::noteUpdate() {
+    ++updatesSinceCheck_;
+    if (topFeatures_.empty() || (policy_.checkInterval > 0 && updatesSinceCheck_ >= static_cast<size_t>(policy_.checkInterval))) {
+        refresh();
+    }
+}
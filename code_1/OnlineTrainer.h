@@ -0,0 +1,131 @@
+#ifndef ONLINETRAINER_H
+#define ONLINETRAINER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include "KNNClassifier.h"
+#include "FeatureExtractor.h"
+#include "Vocabulary.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Keeps a KNNClassifier trained on a stream of labeled emails without full rebuilds.
+// New emails are vectorized against the current top features and appended to the live
+// classifier; removed emails are tombstoned. The spam and ham word counts behind the feature
+// selection are updated per email, and a Policy decides when the top-N features computed from
+// them have drifted far enough (or enough rows are tombstoned) to re-vectorize every email.
+// Emails keep the id returned by addEmail for the lifetime of the trainer, even when
+// re-vectorization drops removed emails and renumbers the classifier's training rows.
+class OnlineTrainer {
+public:
+    // When to re-vectorize the live emails.
+    struct Policy {
+        // Updates between two automatic checks of the feature set (0 = only on refresh).
+        int checkInterval;
+
+        // Re-vectorize when at least this fraction of the freshly selected top features is
+        // missing from the features in use.
+        double maxFeatureDrift;
+
+        // Re-vectorize, dropping tombstoned rows, when this fraction of the rows is removed.
+        double maxRemovedFraction;
+
+        Policy() : checkInterval(64), maxFeatureDrift(0.1), maxRemovedFraction(0.25) {}
+    };
+
+    // Constructor: Creates an empty trainer for a classifier with k neighbors and N features.
+    OnlineTrainer(int k, int N, const Policy& policy = Policy(), ThreadPool* pool = nullptr);
+
+    // Replaces everything with a batch of labeled emails and trains from scratch; email ids
+    // are the positions in trainingData.
+    void train(const vector<pair<pair<string, string>, bool>>& trainingData);
+
+    // Adds one labeled email and returns its id. Only this email is vectorized and indexed.
+    int addEmail(const string& subject, const string& message, bool isSpam);
+
+    // Removes an email by id; throws out_of_range for unknown or already removed ids.
+    void removeEmail(int emailId);
+
+    // Applies the policy now. With force, re-vectorizes regardless. Returns true if the
+    // emails were re-vectorized.
+    bool refresh(bool force = false);
+
+    // Feature vector of an email under the features in use.
+    vector<double> vectorize(string_view subject, string_view message) const;
+
+    // Classifier trained on the live emails.
+    const KNNClassifier& classifier() const;
+
+    // Top features in use.
+    const vector<string>& topFeatures() const;
+
+    // Fraction of the top features selected from the current counts that are not in use.
+    double featureDrift() const;
+
+    // Number of emails added and not removed.
+    size_t liveCount() const;
+
+    // Number of times the emails were re-vectorized (including train).
+    size_t revectorizations() const;
+
+    // Classifier training index of an email, or -1 if it was removed.
+    int trainingIndex(int emailId) const;
+
+    // Email id of a classifier training index.
+    int emailId(int trainingIndex) const;
+
+private:
+    // An email as added, kept so it can be re-vectorized; the text is dropped on removal.
+    struct StoredEmail {
+        string subject;
+        string message;
+        bool isSpam;
+        bool removed;
+    };
+
+    KNNClassifier classifier_;
+    int N_;
+    Policy policy_;
+    ThreadPool* pool_;
+    FeatureExtractor extractor_;
+
+    // Every email ever added, by id.
+    vector<StoredEmail> emails_;
+
+    // Classifier row of each email id (-1 once removed from the classifier) and the reverse.
+    vector<int> rowOfEmail_;
+    vector<int> emailOfRow_;
+
+    // Word frequencies of the live spam and ham emails, excluding common words.
+    unordered_map<string, int> spamCounts_;
+    unordered_map<string, int> hamCounts_;
+
+    // Features in use and their lookup table.
+    vector<string> topFeatures_;
+    Vocabulary vocabulary_;
+
+    size_t liveCount_;
+    size_t updatesSinceCheck_;
+    size_t revectorizations_;
+
+    // Adds delta to the count of every (non-common) word of the email.
+    void countWords(const StoredEmail& email, int delta);
+
+    // Top N features selected from the current word counts.
+    vector<string> selectFeatures() const;
+
+    // Fraction of the selected features that are not in use.
+    double driftFrom(const vector<string>& selected) const;
+
+    // Switches to the given features and retrains on every live email.
+    void revectorize(const vector<string>& features);
+
+    // Counts an update and runs the policy every checkInterval updates.
+    void noteUpdate();
+};
+
+#endif // ONLINETRAINER_H
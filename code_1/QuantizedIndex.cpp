@@ -0,0 +1,197 @@
+#include "QuantizedIndex.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Largest number of features; keeps the int8 dot products exact in the SIMD kernels.
+static const size_t maxFeatures = size_t(1) << 20;
+
+// Constructor: Creates an empty index.
+QuantizedIndex::QuantizedIndex(const Parameters& parameters) : parameters_(parameters), rowCount_(0), featureCount_(0) {}
+
+// Symmetric per-vector scale: the largest magnitude maps to 127.
+float QuantizedIndex::quantizeInt8(const double* values, size_t count, int8_t* codes) {
+    double largest = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        largest = max(largest, fabs(values[i]));
+    }
+    if (largest == 0.0) {
+        fill(codes, codes + count, 0);
+        return 0.0f;
+    }
+    double inverse = 127.0 / largest;
+    for (size_t i = 0; i < count; ++i) {
+        codes[i] = static_cast<int8_t>(lround(values[i] * inverse));
+    }
+    return static_cast<float>(largest / 127.0);
+}
+
+// Quantize every row; the full-precision copy is only kept for the rerank.
+void QuantizedIndex::build(const vector<vector<double>>& features) {
+    KNN_TIMED_SCOPE("quantized.build");
+    size_t featureCount = features.empty() ? 0 : features[0].size();
+    for (const auto& row : features) {
+        if (row.size() != featureCount) {
+            throw invalid_argument("Training feature vectors must all have the same length");
+        }
+    }
+    if (featureCount > maxFeatures) {
+        throw invalid_argument("The quantized index supports at most 2^20 features");
+    }
+
+    clearRemoved();
+    rowCount_ = 0;
+    featureCount_ = featureCount;
+    codes_.clear();
+    scales_.clear();
+    halves_.clear();
+    norms_.clear();
+    if (parameters_.precision == Int8) {
+        codes_.reserve(features.size() * featureCount_);
+        scales_.reserve(features.size());
+        norms_.reserve(features.size());
+    } else {
+        halves_.reserve(features.size() * featureCount_);
+    }
+    for (const auto& row : features) {
+        encodeRow(row.data());
+    }
+    rowCount_ = features.size();
+    fullRows_ = FeatureMatrix();
+    if (parameters_.rerankFactor > 0) {
+        fullRows_.assign(features);
+    }
+}
+
+// Appends the codes, scale and norm (int8) or the half values (fp16) of one row.
+void QuantizedIndex::encodeRow(const double* values) {
+    if (parameters_.precision == Int8) {
+        size_t offset = codes_.size();
+        codes_.resize(offset + featureCount_);
+        scales_.push_back(quantizeInt8(values, featureCount_, codes_.data() + offset));
+        double norm = 0.0;
+        for (size_t i = 0; i < featureCount_; ++i) {
+            norm += values[i] * values[i];
+        }
+        norms_.push_back(norm);
+    } else {
+        for (size_t i = 0; i < featureCount_; ++i) {
+            halves_.push_back(DistanceKernels::floatToHalf(static_cast<float>(values[i])));
+        }
+    }
+}
+
+// Append a row; the first row of an empty index fixes the dimensions.
+size_t QuantizedIndex::append(const vector<double>& features) {
+    if (rowCount_ == 0) {
+        if (features.size() > maxFeatures) {
+            throw invalid_argument("The quantized index supports at most 2^20 features");
+        }
+        featureCount_ = features.size();
+        codes_.clear();
+        scales_.clear();
+        halves_.clear();
+        norms_.clear();
+        fullRows_ = FeatureMatrix();
+    } else if (features.size() != featureCount_) {
+        throw invalid_argument("Training feature vectors must all have the same length");
+    }
+    encodeRow(features.data());
+    if (parameters_.rerankFactor > 0) {
+        fullRows_.appendRow(features.data(), features.size());
+    }
+    return rowCount_++;
+}
+
+// Copies the quantized rows, the full-precision copy and the removal flags.
+shared_ptr<NeighborIndex> QuantizedIndex::clone() const {
+    return make_shared<QuantizedIndex>(*this);
+}
+
+// One pass over the quantized rows in index order keeps the candidates; the rerank then
+// orders them by their exact distance. There is no early exit: a quantized distance of 0 does
+// not prove an exact duplicate.
+vector<Neighbor> QuantizedIndex::search(const vector<double>& query, size_t k) const {
+    if (rowCount_ > 0 && query.size() != featureCount_) {
+        throw invalid_argument("Feature vector length does not match the training data");
+    }
+    size_t candidates = parameters_.rerankFactor > 0 ? k * parameters_.rerankFactor : k;
+    NeighborBuffer nearest(candidates);
+    bool skipRemoved = removedCount() > 0;
+
+    if (parameters_.precision == Int8) {
+        vector<int8_t> codes(featureCount_);
+        double scale = quantizeInt8(query.data(), featureCount_, codes.data());
+        double queryNorm = 0.0;
+        for (double value : query) {
+            queryNorm += value * value;
+        }
+        for (size_t i = 0; i < rowCount_; ++i) {
+            if (skipRemoved && isRemoved(i)) {
+                continue;
+            }
+            int64_t dot = DistanceKernels::dotProductInt8(codes.data(), &codes_[i * featureCount_], featureCount_);
+            double distance = queryNorm + norms_[i] - 2.0 * scale * scales_[i] * static_cast<double>(dot);
+            nearest.offer(max(0.0, distance), static_cast<int>(i));
+        }
+    } else {
+        vector<float> values(query.begin(), query.end());
+        for (size_t i = 0; i < rowCount_; ++i) {
+            if (skipRemoved && isRemoved(i)) {
+                continue;
+            }
+            nearest.offer(DistanceKernels::squaredDistanceHalf(values.data(), &halves_[i * featureCount_], featureCount_), static_cast<int>(i));
+        }
+    }
+
+    if (parameters_.rerankFactor == 0) {
+        return nearest.neighbors();
+    }
+    NeighborBuffer reranked(k);
+    for (const auto& candidate : nearest.neighbors()) {
+        reranked.offer(DistanceKernels::squaredDistance(query.data(), fullRows_.row(candidate.second), featureCount_), candidate.second);
+    }
+    return reranked.neighbors();
+}
+
+// Number of indexed training rows.
+size_t QuantizedIndex::size() const {
+    return rowCount_;
+}
+
+// Length of the vectors the index was built from.
+size_t QuantizedIndex::dimensions() const {
+    return featureCount_;
+}
+
+// A neighbor the quantized scan ranks below the candidates is missed even with a rerank.
+bool QuantizedIndex::isExact() const {
+    return false;
+}
+
+// Short description of the backend.
+string QuantizedIndex::name() const {
+    string format = parameters_.precision == Int8 ? "int8" : "fp16";
+    if (parameters_.rerankFactor == 0) {
+        return "quantized (" + format + ")";
+    }
+    return "quantized (" + format + ", rerank " + to_string(parameters_.rerankFactor) + "x)";
+}
+
+// Bytes held by the index.
+size_t QuantizedIndex::memoryBytes() const {
+    return scannedBytes() + fullRows_.memoryBytes();
+}
+
+// Bytes of quantized rows, scales and norms.
+size_t QuantizedIndex::scannedBytes() const {
+    return codes_.capacity() * sizeof(int8_t) + scales_.capacity() * sizeof(float)
+        + halves_.capacity() * sizeof(uint16_t) + norms_.capacity() * sizeof(double);
+}
+
+// Parameters the index was created with.
+const QuantizedIndex::Parameters& QuantizedIndex::parameters() const {
+    return parameters_;
+}
@@ -0,0 +1,98 @@
+#ifndef QUANTIZEDINDEX_H
+#define QUANTIZEDINDEX_H
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "NeighborIndex.h"
+#include "NeighborBuffer.h"
+#include "FeatureMatrix.h"
+#include "DistanceKernels.h"
+
+using namespace std;
+
+// Brute-force backend for weighted (non-binary) features that scans a compressed copy of the
+// training rows instead of doubles:
+//   Int8:    each row scaled by its own largest magnitude into [-127, 127] (1 byte per feature
+//            plus a float scale). The query is quantized the same way, and the distance is
+//            |q|^2 + |r|^2 - 2 * scale(q) * scale(r) * dot(q8, r8), with exact norms kept per
+//            row and the dot product in integer SIMD.
+//   Float16: IEEE half-precision values (2 bytes per feature) against a float query.
+// By default only the quantized rows are kept and the reported distances are the quantized
+// ones. A rerank factor f is opt-in: the scan then keeps the f * k nearest by the quantized
+// distance and re-scores them exactly against a full-precision copy of the rows, so the
+// reported neighbors and distances are those of the double path unless a true neighbor fell
+// out of the candidates. That copy is only read for the candidates, but it is held in memory,
+// so a reranking index is larger than the double path it replaces.
+class QuantizedIndex : public NeighborIndex {
+public:
+    // Storage format of the scanned rows.
+    enum Precision { Int8, Float16 };
+
+    // Storage format and rerank depth.
+    struct Parameters {
+        Precision precision;
+
+        // Candidates re-scored in full precision per requested neighbor; 0 (the default)
+        // disables the rerank and the full-precision copy.
+        size_t rerankFactor;
+
+        Parameters() : precision(Int8), rerankFactor(0) {}
+        Parameters(Precision precision, size_t rerankFactor) : precision(precision), rerankFactor(rerankFactor) {}
+    };
+
+    // Constructor: Creates an empty index.
+    explicit QuantizedIndex(const Parameters& parameters = Parameters());
+
+    // Quantizes the training vectors; throws invalid_argument if their lengths differ or
+    // exceed 2^20 features.
+    void build(const vector<vector<double>>& features) override;
+
+    // Quantizes and appends one row.
+    size_t append(const vector<double>& features) override;
+
+    shared_ptr<NeighborIndex> clone() const override;
+
+    // Scans the quantized rows for the candidates, then reranks them if enabled.
+    vector<Neighbor> search(const vector<double>& query, size_t k) const override;
+
+    size_t size() const override;
+    size_t dimensions() const override;
+    bool isExact() const override;
+    string name() const override;
+
+    // Bytes held by the index, including the full-precision copy kept for the rerank.
+    size_t memoryBytes() const override;
+
+    // Bytes of quantized rows, scales and norms read by every search.
+    size_t scannedBytes() const;
+
+    // Parameters the index was created with.
+    const Parameters& parameters() const;
+
+private:
+    Parameters parameters_;
+    size_t rowCount_;
+    size_t featureCount_;
+
+    // Int8 rows (featureCount_ codes each) with their scales.
+    vector<int8_t, AlignedAllocator<int8_t>> codes_;
+    vector<float> scales_;
+
+    // Float16 rows (featureCount_ values each).
+    vector<uint16_t, AlignedAllocator<uint16_t>> halves_;
+
+    // Exact squared norm of every row (used by the int8 distance).
+    vector<double> norms_;
+
+    // Full-precision rows for the rerank; empty when rerankFactor is 0.
+    FeatureMatrix fullRows_;
+
+    // Appends the quantized form of one row.
+    void encodeRow(const double* values);
+
+    // Quantizes values into codes and returns the scale (0 for an all-zero vector).
+    static float quantizeInt8(const double* values, size_t count, int8_t* codes);
+};
+
+#endif // QUANTIZEDINDEX_H
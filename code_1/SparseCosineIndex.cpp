@@ -0,0 +1,149 @@
+#include "SparseCosineIndex.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Constructor: Creates an empty index.
+SparseCosineIndex::SparseCosineIndex() : emailCount_(0), postingOffsets_(1, 0) {}
+
+// Builds the posting lists by counting sort over the distinct feature ids.
+void SparseCosineIndex::build(const vector<SparseVector>& emails) {
+    KNN_TIMED_SCOPE("cosine.build");
+    features_.clear();
+    for (const auto& email : emails) {
+        if (email.indices.size() != email.values.size()) {
+            throw invalid_argument("Sparse vector ids and weights must have the same length");
+        }
+        for (size_t i = 1; i < email.indices.size(); ++i) {
+            if (email.indices[i - 1] >= email.indices[i]) {
+                throw invalid_argument("Sparse vector ids must be strictly increasing");
+            }
+        }
+        features_.insert(features_.end(), email.indices.begin(), email.indices.end());
+    }
+    sort(features_.begin(), features_.end());
+    features_.erase(unique(features_.begin(), features_.end()), features_.end());
+    features_.shrink_to_fit();
+
+    // Feature ids of the emails as positions in features_, found once and reused below.
+    vector<size_t> counts(features_.size() + 1, 0);
+    vector<uint32_t> positions;
+    for (const auto& email : emails) {
+        for (uint32_t id : email.indices) {
+            uint32_t position = static_cast<uint32_t>(lower_bound(features_.begin(), features_.end(), id) - features_.begin());
+            positions.push_back(position);
+            ++counts[position + 1];
+        }
+    }
+    postingOffsets_.assign(features_.size() + 1, 0);
+    for (size_t f = 0; f < features_.size(); ++f) {
+        postingOffsets_[f + 1] = postingOffsets_[f] + counts[f + 1];
+    }
+    postingEmails_.assign(positions.size(), 0);
+    postingWeights_.assign(positions.size(), 0.0f);
+    vector<size_t> cursor(postingOffsets_.begin(), postingOffsets_.end() - 1);
+    size_t next = 0;
+    for (size_t email = 0; email < emails.size(); ++email) {
+        for (float weight : emails[email].values) {
+            size_t slot = cursor[positions[next++]]++;
+            postingEmails_[slot] = static_cast<int>(email);
+            postingWeights_[slot] = weight;
+        }
+    }
+    emailCount_ = emails.size();
+}
+
+// Accumulates the dot products over the query's posting lists in increasing feature order (the
+// order SparseVector::dot adds them in, so the scores are bit-identical), then converts them to
+// distances.
+vector<Neighbor> SparseCosineIndex::search(const SparseVector& query, size_t k, Scratch& scratch) const {
+    if (scratch.scores.size() != emailCount_) {
+        scratch.scores.assign(emailCount_, 0.0);
+        scratch.visited.assign(emailCount_, 0);
+    }
+    scratch.touched.clear();
+    scratch.nearest.reset(k);
+
+    auto feature = features_.begin();
+    for (size_t i = 0; i < query.indices.size(); ++i) {
+        feature = lower_bound(feature, features_.end(), query.indices[i]);
+        if (feature == features_.end()) {
+            break;
+        }
+        if (*feature != query.indices[i]) {
+            continue;
+        }
+        size_t f = static_cast<size_t>(feature - features_.begin());
+        double weight = query.values[i];
+        for (size_t p = postingOffsets_[f]; p < postingOffsets_[f + 1]; ++p) {
+            int email = postingEmails_[p];
+            if (!scratch.visited[email]) {
+                scratch.visited[email] = 1;
+                scratch.touched.push_back(email);
+            }
+            scratch.scores[email] += weight * postingWeights_[p];
+        }
+    }
+
+    for (int email : scratch.touched) {
+        scratch.nearest.offer(max(0.0, 2.0 - 2.0 * scratch.scores[email]), email);
+    }
+
+    // Emails sharing no feature are all at distance 2, so only the first k of them by index
+    // can make the cut.
+    size_t untouchedTaken = 0;
+    for (size_t email = 0; email < emailCount_ && untouchedTaken < k; ++email) {
+        if (!scratch.visited[email]) {
+            scratch.nearest.offer(2.0, static_cast<int>(email));
+            ++untouchedTaken;
+        }
+    }
+
+    // Reset only the entries this query touched.
+    for (int email : scratch.touched) {
+        scratch.scores[email] = 0.0;
+        scratch.visited[email] = 0;
+    }
+    return scratch.nearest.neighbors();
+}
+
+// Same as above with its own working memory.
+vector<Neighbor> SparseCosineIndex::search(const SparseVector& query, size_t k) const {
+    Scratch scratch;
+    return search(query, k, scratch);
+}
+
+// Each chunk of queries shares one set of scratch arrays.
+vector<vector<Neighbor>> SparseCosineIndex::searchBatch(const vector<SparseVector>& queries, size_t k, ThreadPool* pool) const {
+    KNN_TIMED_SCOPE("cosine.searchBatch");
+    vector<vector<Neighbor>> results(queries.size());
+    auto searchRange = [&](size_t begin, size_t end) {
+        Scratch scratch;
+        for (size_t q = begin; q < end; ++q) {
+            results[q] = search(queries[q], k, scratch);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(queries.size(), 32, searchRange);
+    } else {
+        searchRange(0, queries.size());
+    }
+    return results;
+}
+
+// Number of indexed emails.
+size_t SparseCosineIndex::size() const {
+    return emailCount_;
+}
+
+// Number of distinct feature ids with a posting list.
+size_t SparseCosineIndex::features() const {
+    return features_.size();
+}
+
+// Bytes held by the index.
+size_t SparseCosineIndex::memoryBytes() const {
+    return features_.capacity() * sizeof(uint32_t) + postingOffsets_.capacity() * sizeof(size_t)
+        + postingEmails_.capacity() * sizeof(int) + postingWeights_.capacity() * sizeof(float);
+}
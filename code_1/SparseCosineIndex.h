@@ -0,0 +1,69 @@
+#ifndef SPARSECOSINEINDEX_H
+#define SPARSECOSINEINDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "SparseVector.h"
+#include "NeighborIndex.h"
+#include "NeighborBuffer.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Exact cosine-similarity nearest-neighbor index for unit-length sparse vectors (as made by
+// TfidfVectorizer). Every feature id has a posting list of (email, weight) pairs, so a query
+// accumulates its dot product with exactly the emails sharing one of its features. For unit
+// vectors |a - b|^2 = 2 - 2 cos(a, b), and that is the distance reported, so neighbors come out
+// in decreasing cosine order and KNNClassifier::vote sees ordinary squared Euclidean distances.
+// Emails sharing no feature with the query have cosine 0 (distance 2); the first of them by
+// index fill up a result with fewer than k touched emails.
+class SparseCosineIndex {
+public:
+    // Per-search working memory, reusable across searches on the same thread.
+    struct Scratch {
+        vector<double> scores;
+        vector<char> visited;
+        vector<int> touched;
+        NeighborBuffer nearest;
+    };
+
+    // Constructor: Creates an empty index.
+    SparseCosineIndex();
+
+    // Builds the posting lists of the emails; throws invalid_argument if an email's ids are not
+    // strictly increasing or do not match its weights.
+    void build(const vector<SparseVector>& emails);
+
+    // Finds the k nearest emails to the query: (2 - 2 cos, email index) pairs nearest first,
+    // ties broken by lower index, exactly matching a full scan with SparseVector::dot.
+    vector<Neighbor> search(const SparseVector& query, size_t k, Scratch& scratch) const;
+
+    // Same as above with its own working memory.
+    vector<Neighbor> search(const SparseVector& query, size_t k) const;
+
+    // Searches many queries, reusing one Scratch per chunk of queries, on the pool when one is
+    // given.
+    vector<vector<Neighbor>> searchBatch(const vector<SparseVector>& queries, size_t k, ThreadPool* pool = nullptr) const;
+
+    // Number of indexed emails.
+    size_t size() const;
+
+    // Number of distinct feature ids with a posting list.
+    size_t features() const;
+
+    // Bytes held by the index.
+    size_t memoryBytes() const;
+
+private:
+    size_t emailCount_;
+
+    // Feature ids having a posting list, increasing; the postings of features_[f] are
+    // postingEmails_/postingWeights_[postingOffsets_[f] .. postingOffsets_[f + 1]).
+    vector<uint32_t> features_;
+    vector<size_t> postingOffsets_;
+    vector<int> postingEmails_;
+    vector<float> postingWeights_;
+};
+
+#endif // SPARSECOSINEINDEX_H
@@ -0,0 +1,44 @@
+#include "SparseVector.h"
+
+#include <cmath>
+
+// Walks both id lists once; only shared ids contribute.
+double SparseVector::dot(const SparseVector& other) const {
+    double sum = 0.0;
+    size_t i = 0, j = 0;
+    while (i < indices.size() && j < other.indices.size()) {
+        if (indices[i] < other.indices[j]) {
+            ++i;
+        } else if (indices[i] > other.indices[j]) {
+            ++j;
+        } else {
+            sum += static_cast<double>(values[i++]) * other.values[j++];
+        }
+    }
+    return sum;
+}
+
+// Euclidean length.
+double SparseVector::norm() const {
+    double sum = 0.0;
+    for (float value : values) {
+        sum += static_cast<double>(value) * value;
+    }
+    return sqrt(sum);
+}
+
+// Divides every weight by the length.
+void SparseVector::normalize() {
+    double length = norm();
+    if (length == 0.0) {
+        return;
+    }
+    for (float& value : values) {
+        value = static_cast<float>(value / length);
+    }
+}
+
+// Bytes held by the entries.
+size_t SparseVector::memoryBytes() const {
+    return indices.capacity() * sizeof(uint32_t) + values.capacity() * sizeof(float);
+}
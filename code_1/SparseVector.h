@@ -0,0 +1,36 @@
+#ifndef SPARSEVECTOR_H
+#define SPARSEVECTOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Weighted feature vector holding only its non-zero entries, for feature spaces far too large
+// for a dense vector<double> per email: feature ids in increasing order with one float weight
+// each (8 bytes per non-zero entry).
+struct SparseVector {
+    // Feature ids, strictly increasing.
+    vector<uint32_t> indices;
+
+    // Weight of each feature, parallel to indices.
+    vector<float> values;
+
+    // Number of non-zero entries.
+    size_t size() const { return indices.size(); }
+
+    // Dot product with another sparse vector (a merge of the two id lists).
+    double dot(const SparseVector& other) const;
+
+    // Euclidean length.
+    double norm() const;
+
+    // Scales the vector to unit length; an all-zero vector is left as it is.
+    void normalize();
+
+    // Bytes held by the entries.
+    size_t memoryBytes() const;
+};
+
+#endif // SPARSEVECTOR_H
@@ -0,0 +1,170 @@
+#include "SyntheticCorpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Constructor: Validates the options, then names every rank and accumulates its Zipf weight.
+SyntheticCorpus::SyntheticCorpus(const Options& options) : options_(options), state_(options.seed), emailIndex_(0) {
+    if (options_.spamRatio < 0.0 || options_.spamRatio > 1.0) {
+        throw invalid_argument("Spam ratio must be between 0 and 1.");
+    }
+    if (options_.vocabularySize == 0) {
+        throw invalid_argument("Vocabulary size must be positive.");
+    }
+    if (options_.zipfExponent < 0.0) {
+        throw invalid_argument("Zipf exponent must not be negative.");
+    }
+    if (options_.subjectMinWords == 0 || options_.subjectMinWords > options_.subjectMaxWords) {
+        throw invalid_argument("Subject length bounds must satisfy 0 < min <= max.");
+    }
+    if (options_.messageMedianWords < 1.0 || options_.messageWordsSigma < 0.0) {
+        throw invalid_argument("Message median must be at least one word and its deviation not negative.");
+    }
+    if (options_.punctuatedFraction < 0.0 || options_.punctuatedFraction > 1.0 || options_.multilineFraction < 0.0 || options_.multilineFraction > 1.0) {
+        throw invalid_argument("Punctuated and multiline fractions must be between 0 and 1.");
+    }
+
+    words_.reserve(options_.vocabularySize);
+    cumulativeWeights_.reserve(options_.vocabularySize);
+    double total = 0.0;
+    for (size_t rank = 0; rank < options_.vocabularySize; ++rank) {
+        words_.push_back(makeWord(rank));
+        total += pow(static_cast<double>(rank + 1), -options_.zipfExponent);
+        cumulativeWeights_.push_back(total);
+    }
+}
+
+// Email i is spam when the running spam quota (i + 1) * ratio reaches a new whole number, so
+// any prefix of the corpus has the requested ratio.
+void SyntheticCorpus::next(Email& email) {
+    size_t i = emailIndex_++;
+    email.isSpam = static_cast<size_t>((i + 1) * options_.spamRatio) > static_cast<size_t>(i * options_.spamRatio);
+    bool punctuated = uniform() < options_.punctuatedFraction;
+    bool multiline = uniform() < options_.multilineFraction;
+
+    email.subject.clear();
+    appendWords(email.subject, uniformInteger(options_.subjectMinWords, options_.subjectMaxWords), email.isSpam, punctuated, false);
+    email.message.clear();
+    appendWords(email.message, messageLength(), email.isSpam, punctuated, multiline);
+}
+
+// Collects next() into the training data layout used by FeatureExtractor.
+vector<pair<pair<string, string>, bool>> SyntheticCorpus::generate(size_t count) {
+    vector<pair<pair<string, string>, bool>> emails;
+    emails.reserve(count);
+    Email email;
+    for (size_t i = 0; i < count; ++i) {
+        next(email);
+        emails.push_back({{email.subject, email.message}, email.isSpam});
+    }
+    return emails;
+}
+
+// Record with its terminating line break.
+void SyntheticCorpus::writeRecord(ostream& out, const Email& email) {
+    writeField(out, email.subject);
+    out << ',';
+    writeField(out, email.message);
+    out << '\n';
+}
+
+// Same header as the files in training/ and tests/.
+const char* SyntheticCorpus::header() {
+    return "subject,message";
+}
+
+// splitmix64: a full-period 64-bit sequence with well mixed output.
+uint64_t SyntheticCorpus::nextBits() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// The top 53 bits as a fraction.
+double SyntheticCorpus::uniform() {
+    return static_cast<double>(nextBits() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Modulo bias is negligible for the small ranges used here.
+size_t SyntheticCorpus::uniformInteger(size_t low, size_t high) {
+    return low + static_cast<size_t>(nextBits() % (high - low + 1));
+}
+
+// Inverse of the cumulative weights by binary search.
+size_t SyntheticCorpus::zipfRank() {
+    double target = uniform() * cumulativeWeights_.back();
+    size_t rank = upper_bound(cumulativeWeights_.begin(), cumulativeWeights_.end(), target) - cumulativeWeights_.begin();
+    return min(rank, cumulativeWeights_.size() - 1);
+}
+
+// The normal deviate is the Irwin-Hall sum of twelve uniforms (mean 6, variance 1).
+size_t SyntheticCorpus::messageLength() {
+    double normal = -6.0;
+    for (int i = 0; i < 12; ++i) {
+        normal += uniform();
+    }
+    double length = options_.messageMedianWords * exp(options_.messageWordsSigma * normal);
+    return max<size_t>(1, static_cast<size_t>(length + 0.5));
+}
+
+// Punctuated text gets a comma after about one word in eight and one quoted word; multiline
+// text ends a sentence with a line break after about one word in twelve.
+void SyntheticCorpus::appendWords(string& text, size_t count, bool spam, bool punctuated, bool multiline) {
+    size_t quotedWord = punctuated ? uniformInteger(0, count - 1) : count;
+    for (size_t i = 0; i < count; ++i) {
+        size_t rank = zipfRank();
+        if (spam) {
+            rank = (rank + options_.topicShift) % words_.size();
+        }
+        if (i == quotedWord) {
+            text += '"';
+            text += words_[rank];
+            text += '"';
+        } else {
+            text += words_[rank];
+        }
+        if (i + 1 == count) {
+            break;
+        }
+        if (multiline && nextBits() % 12 == 0) {
+            text += ".\n";
+        } else {
+            if (punctuated && nextBits() % 8 == 0) {
+                text += ',';
+            }
+            text += ' ';
+        }
+    }
+}
+
+// Consonant-vowel syllables, one per base-90 digit of rank + 90, so every word has at least two
+// syllables and distinct ranks get distinct words.
+string SyntheticCorpus::makeWord(size_t rank) {
+    static const char consonants[] = "bcdfghjklmnprstvwz";
+    static const char vowels[] = "aeiou";
+    string word;
+    for (size_t digits = rank + 90; digits > 0; digits /= 90) {
+        size_t syllable = digits % 90;
+        word += consonants[syllable / 5];
+        word += vowels[syllable % 5];
+    }
+    return word;
+}
+
+// RFC 4180 quoting.
+void SyntheticCorpus::writeField(ostream& out, const string& field) {
+    if (field.find_first_of(",\"\r\n") == string::npos) {
+        out << field;
+        return;
+    }
+    out << '"';
+    for (char c : field) {
+        if (c == '"') {
+            out << '"';
+        }
+        out << c;
+    }
+    out << '"';
+}
@@ -0,0 +1,118 @@
+#ifndef SYNTHETICCORPUS_H
+#define SYNTHETICCORPUS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Deterministic generator of synthetic labeled emails for scale testing.
+// Words come from a vocabulary of pronounceable pseudo-words drawn with a Zipf distribution
+// (rank r has weight 1 / r^s). Spam and ham use the same distribution over different
+// rankings: spam's rank r is ham's rank r + topicShift, so the most frequent spam words are
+// uncommon in ham and feature selection has something to find. Message lengths follow a
+// log-normal distribution. A fraction of the emails is punctuated with commas and embedded
+// quotes, and a fraction spans several lines, so their CSV fields must be quoted.
+// The sequence of emails depends only on the options (including the seed): the generator
+// uses its own pseudo-random arithmetic rather than the standard distributions, whose output
+// differs between standard library implementations.
+class SyntheticCorpus {
+public:
+    // Shape of the corpus.
+    struct Options {
+        // Seed of the pseudo-random sequence.
+        uint64_t seed;
+
+        // Fraction of the emails that are spam; spam and ham are interleaved evenly.
+        double spamRatio;
+
+        // Number of distinct words.
+        size_t vocabularySize;
+
+        // Zipf exponent s.
+        double zipfExponent;
+
+        // Rank offset between the spam and ham word rankings.
+        size_t topicShift;
+
+        // Subject length in words, uniform between the two bounds.
+        size_t subjectMinWords;
+        size_t subjectMaxWords;
+
+        // Message length in words: log-normal with this median and log-space deviation.
+        double messageMedianWords;
+        double messageWordsSigma;
+
+        // Fraction of emails whose text contains commas and quotes.
+        double punctuatedFraction;
+
+        // Fraction of emails whose message spans several lines.
+        double multilineFraction;
+
+        Options()
+            : seed(1), spamRatio(0.5), vocabularySize(50000), zipfExponent(1.0), topicShift(50), subjectMinWords(3),
+              subjectMaxWords(8), messageMedianWords(50.0), messageWordsSigma(0.6), punctuatedFraction(0.1), multilineFraction(0.05) {}
+    };
+
+    // One generated email.
+    struct Email {
+        string subject;
+        string message;
+        bool isSpam;
+    };
+
+    // Constructor: Builds the vocabulary and its Zipf table. Throws invalid_argument for
+    // options out of range.
+    explicit SyntheticCorpus(const Options& options = Options());
+
+    // Generates the next email into email, reusing its buffers.
+    void next(Email& email);
+
+    // Generates the next count emails as training data: (subject, message) and spam label.
+    vector<pair<pair<string, string>, bool>> generate(size_t count);
+
+    // Writes one "subject,message" CSV record. Fields are quoted (with quotes doubled) only
+    // when they contain a comma, a quote or a line break.
+    static void writeRecord(ostream& out, const Email& email);
+
+    // Header record of the dataset files.
+    static const char* header();
+
+private:
+    Options options_;
+    uint64_t state_;
+    size_t emailIndex_;
+
+    // Pseudo-words by rank, and the cumulative Zipf weights of the ranks.
+    vector<string> words_;
+    vector<double> cumulativeWeights_;
+
+    // Next 64 pseudo-random bits (splitmix64).
+    uint64_t nextBits();
+
+    // Uniform double in [0, 1).
+    double uniform();
+
+    // Random integer in [low, high].
+    size_t uniformInteger(size_t low, size_t high);
+
+    // Draws a word rank from the Zipf distribution.
+    size_t zipfRank();
+
+    // Draws a message length from the log-normal distribution.
+    size_t messageLength();
+
+    // Appends words of the spam or ham topic to text, with punctuation and line breaks if asked.
+    void appendWords(string& text, size_t count, bool spam, bool punctuated, bool multiline);
+
+    // Pronounceable pseudo-word for a rank.
+    static string makeWord(size_t rank);
+
+    // Writes one field, quoted when needed.
+    static void writeField(ostream& out, const string& field);
+};
+
+#endif // SYNTHETICCORPUS_H
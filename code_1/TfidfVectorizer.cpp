@@ -0,0 +1,272 @@
+#include "TfidfVectorizer.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// FNV-1a parameters.
+static const uint64_t hashOffset = 14695981039346656037ULL;
+static const uint64_t hashPrime = 1099511628211ULL;
+
+// Continues an FNV-1a hash over more bytes.
+static uint64_t hashBytes(uint64_t hash, string_view bytes) {
+    for (char c : bytes) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * hashPrime;
+    }
+    return hash;
+}
+
+// True for the whitespace set of isspace in the "C" locale.
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// True for punctuation trimmed from both ends of a token.
+static bool isTrimmed(char c) {
+    static const string_view trimmed = "\"'()[]{}<>,.;:!?";
+    return trimmed.find(c) != string_view::npos;
+}
+
+// Constructor: Nothing is fitted yet.
+TfidfVectorizer::TfidfVectorizer(const Options& options) : options_(options), documents_(0), fitted_(false) {
+    if (options_.bits < 8 || options_.bits > 28) {
+        throw invalid_argument("The number of TF-IDF feature bits must be between 8 and 28.");
+    }
+    if (options_.charNgramMax != 0 && (options_.charNgramMin < 1 || options_.charNgramMin > options_.charNgramMax)) {
+        throw invalid_argument("Character n-gram lengths must satisfy 1 <= min <= max.");
+    }
+}
+
+// Number of feature ids.
+size_t TfidfVectorizer::dimensions() const {
+    return size_t(1) << options_.bits;
+}
+
+// Feature ids with an idf weight.
+size_t TfidfVectorizer::keptFeatures() const {
+    return keptIds_.size();
+}
+
+// True once fit has run.
+bool TfidfVectorizer::isFitted() const {
+    return fitted_;
+}
+
+// Options in use.
+const TfidfVectorizer::Options& TfidfVectorizer::options() const {
+    return options_;
+}
+
+// High bits of a Fibonacci rehash, as in FeatureHasher::bucketOf.
+uint32_t TfidfVectorizer::featureOf(uint64_t hash) const {
+    return static_cast<uint32_t>((hash * 0x9E3779B97F4A7C15ULL) >> (64 - options_.bits));
+}
+
+// Each kind of feature hashes a different leading tag byte, so the word "win" and the
+// character trigram "win" get unrelated ids.
+void TfidfVectorizer::collectToken(const string& token, const string& previous, vector<uint32_t>& terms) const {
+    if (options_.wordUnigrams) {
+        terms.push_back(featureOf(hashBytes(hashBytes(hashOffset, "w"), token)));
+    }
+    if (options_.wordBigrams && !previous.empty()) {
+        uint64_t hash = hashBytes(hashBytes(hashOffset, "b"), previous);
+        terms.push_back(featureOf(hashBytes(hashBytes(hash, " "), token)));
+    }
+    if (options_.charNgramMax > 0) {
+        // The token padded with '^' and '$' without building the padded string.
+        size_t padded = token.size() + 2;
+        auto at = [&](size_t i) { return i == 0 ? '^' : i == padded - 1 ? '$' : token[i - 1]; };
+        for (size_t n = options_.charNgramMin; n <= static_cast<size_t>(options_.charNgramMax) && n <= padded; ++n) {
+            for (size_t start = 0; start + n <= padded; ++start) {
+                uint64_t hash = hashBytes(hashOffset, "c");
+                for (size_t i = start; i < start + n; ++i) {
+                    hash = (hash ^ static_cast<unsigned char>(at(i))) * hashPrime;
+                }
+                terms.push_back(featureOf(hash));
+            }
+        }
+    }
+}
+
+// Splits on whitespace, lowercases and trims punctuation from both ends; tokens that are only
+// punctuation are skipped and do not break the bigram chain.
+void TfidfVectorizer::collectText(string_view text, vector<uint32_t>& terms, string& token, string& previous) const {
+    previous.clear();
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && isSpace(text[i])) {
+            ++i;
+        }
+        size_t begin = i;
+        while (i < text.size() && !isSpace(text[i])) {
+            ++i;
+        }
+        size_t end = i;
+        while (begin < end && isTrimmed(text[begin])) {
+            ++begin;
+        }
+        while (end > begin && isTrimmed(text[end - 1])) {
+            --end;
+        }
+        if (begin == end) {
+            continue;
+        }
+        token.assign(text.data() + begin, end - begin);
+        for (char& c : token) {
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        collectToken(token, previous, terms);
+        swap(token, previous);
+    }
+}
+
+// Subject, then message, then one sort so equal ids are adjacent.
+void TfidfVectorizer::collectTerms(string_view subject, string_view message, vector<uint32_t>& terms, string& token, string& previous) const {
+    terms.clear();
+    collectText(subject, terms, token, previous);
+    collectText(message, terms, token, previous);
+    sort(terms.begin(), terms.end());
+}
+
+// Map step: every shard counts the distinct features of its slice of emails into hash maps,
+// one per partition of the feature ids. Reduce step: every partition is merged across shards
+// independently. Only features kept by minDocumentFrequency get a weight.
+void TfidfVectorizer::fit(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool) {
+    KNN_TIMED_SCOPE("tfidf.fit");
+    size_t workers = pool != nullptr ? pool->size() : 1;
+    size_t partitions = workers;
+    size_t shards = max<size_t>(1, min(trainingData.size(), workers));
+
+    // frequencies[shard][partition]: document frequency of each feature id seen.
+    typedef vector<unordered_map<uint32_t, uint32_t>> PartitionedCounts;
+    vector<PartitionedCounts> frequencies(shards, PartitionedCounts(partitions));
+    auto countShards = [&](size_t begin, size_t end) {
+        vector<uint32_t> terms;
+        string token, previous;
+        for (size_t shard = begin; shard < end; ++shard) {
+            size_t first = trainingData.size() * shard / shards;
+            size_t last = trainingData.size() * (shard + 1) / shards;
+            for (size_t i = first; i < last; ++i) {
+                collectTerms(trainingData[i].first.first, trainingData[i].first.second, terms, token, previous);
+                terms.erase(unique(terms.begin(), terms.end()), terms.end());
+                for (uint32_t term : terms) {
+                    ++frequencies[shard][term % partitions][term];
+                }
+            }
+        }
+    };
+    auto mergePartitions = [&](size_t begin, size_t end) {
+        for (size_t partition = begin; partition < end; ++partition) {
+            unordered_map<uint32_t, uint32_t>& total = frequencies[0][partition];
+            for (size_t shard = 1; shard < shards; ++shard) {
+                for (const auto& frequency : frequencies[shard][partition]) {
+                    total[frequency.first] += frequency.second;
+                }
+                unordered_map<uint32_t, uint32_t>().swap(frequencies[shard][partition]);
+            }
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(shards, 1, countShards);
+        pool->parallelFor(partitions, 1, mergePartitions);
+    } else {
+        countShards(0, shards);
+        mergePartitions(0, partitions);
+    }
+
+    // Partitions hold disjoint ids; the kept ones are sorted so weigh can merge against them.
+    uint32_t minimum = static_cast<uint32_t>(max(1, options_.minDocumentFrequency));
+    vector<pair<uint32_t, uint32_t>> kept;
+    for (const auto& counts : frequencies[0]) {
+        for (const auto& frequency : counts) {
+            if (frequency.second >= minimum) {
+                kept.push_back(frequency);
+            }
+        }
+    }
+    sort(kept.begin(), kept.end());
+
+    documents_ = trainingData.size();
+    keptIds_.clear();
+    keptIdf_.clear();
+    keptIds_.reserve(kept.size());
+    keptIdf_.reserve(kept.size());
+    for (const auto& frequency : kept) {
+        keptIds_.push_back(frequency.first);
+        keptIdf_.push_back(static_cast<float>(log((1.0 + documents_) / (1.0 + frequency.second)) + 1.0));
+    }
+    fitted_ = true;
+}
+
+// Run-length over the sorted ids gives each feature's term frequency; dropped features are
+// left out before normalizing. Both id lists are sorted, so each kept id is searched for only
+// past the previous one.
+SparseVector TfidfVectorizer::weigh(const vector<uint32_t>& terms) const {
+    SparseVector weighted;
+    auto kept = keptIds_.begin();
+    for (size_t i = 0; i < terms.size();) {
+        size_t run = i + 1;
+        while (run < terms.size() && terms[run] == terms[i]) {
+            ++run;
+        }
+        kept = lower_bound(kept, keptIds_.end(), terms[i]);
+        if (kept != keptIds_.end() && *kept == terms[i]) {
+            double tf = static_cast<double>(run - i);
+            double weight = options_.sublinearTf ? 1.0 + log(tf) : tf;
+            weighted.indices.push_back(terms[i]);
+            weighted.values.push_back(static_cast<float>(weight * keptIdf_[kept - keptIds_.begin()]));
+        }
+        i = run;
+    }
+    weighted.normalize();
+    return weighted;
+}
+
+// Collects the terms, then weighs them.
+SparseVector TfidfVectorizer::transform(string_view subject, string_view message) const {
+    if (!isFitted()) {
+        throw logic_error("TfidfVectorizer::transform called before fit.");
+    }
+    vector<uint32_t> terms;
+    string token, previous;
+    collectTerms(subject, message, terms, token, previous);
+    return weigh(terms);
+}
+
+// Each worker writes its own slots, reusing its working memory across its chunk.
+template <typename Fields>
+vector<SparseVector> TfidfVectorizer::transformEmails(size_t count, const Fields& fieldsOf, ThreadPool* pool) const {
+    KNN_TIMED_SCOPE("tfidf.transformBatch");
+    if (!isFitted()) {
+        throw logic_error("TfidfVectorizer::transformBatch called before fit.");
+    }
+    vector<SparseVector> vectors(count);
+    auto transformRange = [&](size_t begin, size_t end) {
+        vector<uint32_t> terms;
+        string token, previous;
+        for (size_t i = begin; i < end; ++i) {
+            const pair<string, string>& fields = fieldsOf(i);
+            collectTerms(fields.first, fields.second, terms, token, previous);
+            vectors[i] = weigh(terms);
+        }
+    };
+    if (pool != nullptr) {
+        pool->parallelFor(count, 64, transformRange);
+    } else {
+        transformRange(0, count);
+    }
+    return vectors;
+}
+
+// Transforms a list of emails.
+vector<SparseVector> TfidfVectorizer::transformBatch(const vector<pair<string, string>>& emails, ThreadPool* pool) const {
+    return transformEmails(emails.size(), [&](size_t i) -> const pair<string, string>& { return emails[i]; }, pool);
+}
+
+// Same as above for labeled training data.
+vector<SparseVector> TfidfVectorizer::transformBatch(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool) const {
+    return transformEmails(trainingData.size(), [&](size_t i) -> const pair<string, string>& { return trainingData[i].first; }, pool);
+}
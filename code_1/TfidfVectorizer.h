@@ -0,0 +1,114 @@
+#ifndef TFIDFVECTORIZER_H
+#define TFIDFVECTORIZER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include "SparseVector.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Weighted sparse features for cosine-similarity search: TF-IDF over word unigrams, word
+// bigrams and character n-grams, hashed into 2^bits feature ids so no vocabulary is stored.
+// Unlike Tokenizer, which keeps only letters, tokens are whitespace-separated runs lowercased
+// with their surrounding punctuation trimmed, so "$49.99", "50%" and "www.example.com/offer"
+// survive as tokens. Character n-grams are taken from each token padded with '^' and '$', which
+// also catches obfuscated spellings. A document's weights are (1 + log tf) * idf with the
+// smoothed idf = log((1 + n) / (1 + df)) + 1, then scaled to unit length, so the cosine of two
+// emails is their dot product. Features seen in fewer than minDocumentFrequency training emails
+// are dropped.
+class TfidfVectorizer {
+public:
+    // Which features are generated and how they are weighted.
+    struct Options {
+        // log2 of the number of feature ids.
+        int bits;
+
+        bool wordUnigrams;
+        bool wordBigrams;
+
+        // Lengths of the character n-grams (none if charNgramMax is 0).
+        int charNgramMin;
+        int charNgramMax;
+
+        // Training emails a feature must occur in to be kept.
+        int minDocumentFrequency;
+
+        // Weight repeated features by 1 + log(tf) instead of tf.
+        bool sublinearTf;
+
+        Options() : bits(20), wordUnigrams(true), wordBigrams(true), charNgramMin(3), charNgramMax(5), minDocumentFrequency(2), sublinearTf(true) {}
+    };
+
+    // Constructor: Validates the options; throws invalid_argument for bits outside 8..28 or
+    // n-gram lengths that are not 1 <= min <= max (max 0 disables them).
+    explicit TfidfVectorizer(const Options& options = Options());
+
+    // Counts the document frequency of every feature over the training emails and derives the
+    // idf weights. Must be called before transform. The frequencies are counted in hash maps
+    // and only the kept features' weights are stored, so memory follows the features that
+    // occur rather than 2^bits.
+    void fit(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool = nullptr);
+
+    // Unit-length TF-IDF vector of an email; throws logic_error before fit.
+    SparseVector transform(string_view subject, string_view message) const;
+
+    // Transforms a list of emails, in input order, on the pool when one is given.
+    vector<SparseVector> transformBatch(const vector<pair<string, string>>& emails, ThreadPool* pool = nullptr) const;
+
+    // Same as above for labeled training data; the labels are ignored.
+    vector<SparseVector> transformBatch(const vector<pair<pair<string, string>, bool>>& trainingData, ThreadPool* pool = nullptr) const;
+
+    // Number of feature ids (2^bits).
+    size_t dimensions() const;
+
+    // Feature ids kept by fit (occurring in at least minDocumentFrequency training emails).
+    size_t keptFeatures() const;
+
+    // True once fit has run.
+    bool isFitted() const;
+
+    // Options in use.
+    const Options& options() const;
+
+private:
+    Options options_;
+
+    // Number of training emails fit on.
+    size_t documents_;
+
+    // True once fit has run.
+    bool fitted_;
+
+    // Kept feature ids in increasing order and their idf weights; dropped ids are absent.
+    vector<uint32_t> keptIds_;
+    vector<float> keptIdf_;
+
+    // Replaces terms with the feature id of every feature occurrence of the email, sorted;
+    // token and previous are reused working memory.
+    void collectTerms(string_view subject, string_view message, vector<uint32_t>& terms, string& token, string& previous) const;
+
+    // Features of one text; the bigram chain is not carried from the subject into the message.
+    void collectText(string_view text, vector<uint32_t>& terms, string& token, string& previous) const;
+
+    // Features of one normalized token; previous is the token before it (empty at the start).
+    void collectToken(const string& token, const string& previous, vector<uint32_t>& terms) const;
+
+    // Feature id of an FNV-1a hash.
+    uint32_t featureOf(uint64_t hash) const;
+
+    // Builds the weighted, normalized vector from sorted terms.
+    SparseVector weigh(const vector<uint32_t>& terms) const;
+
+    // Transforms count emails in input order, on the pool when one is given; fieldsOf(i)
+    // returns the subject and message of email i. Defined in the .cpp, where every caller is.
+    template <typename Fields>
+    vector<SparseVector> transformEmails(size_t count, const Fields& fieldsOf, ThreadPool* pool) const;
+};
+
+#endif // TFIDFVECTORIZER_H
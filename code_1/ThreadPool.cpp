@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// Pool and deque index of the worker running on this thread, if any.
+thread_local const void* currentPool = nullptr;
+thread_local size_t currentWorkerQueue = 0;
+
+} // namespace
+
+// Constructor: Creates the deques and starts workerCount - 1 threads.
+ThreadPool::ThreadPool(size_t workerCount)
+    : workerCount_(workerCount == 0 ? defaultWorkerCount() : workerCount),
+      queuedTasks_(0), stopping_(false), nextQueue_(0) {
+    for (size_t i = 0; i < workerCount_; ++i) {
+        queues_.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    // The last deque belongs to whichever outside thread calls parallelFor.
+    for (size_t i = 0; i + 1 < workerCount_; ++i) {
+        threads_.push_back(thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+// Destructor: Stops and joins the worker threads.
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> guard(sleepLock_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto& worker : threads_) {
+        worker.join();
+    }
+}
+
+// Number of workers, including the calling thread.
+size_t ThreadPool::size() const {
+    return workerCount_;
+}
+
+// Number of hardware threads, or 1 if it cannot be determined.
+size_t ThreadPool::defaultWorkerCount() {
+    unsigned int count = thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+// Splits [0, count) into chunks, queues them and helps run tasks until the whole range is done.
+void ThreadPool::parallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grainSize = max<size_t>(1, grainSize);
+
+    // A single worker (or a single chunk) runs inline with no queueing at all.
+    if (workerCount_ == 1 || count <= grainSize) {
+        body(0, count);
+        return;
+    }
+
+    shared_ptr<Batch> batch = make_shared<Batch>();
+    size_t chunks = (count + grainSize - 1) / grainSize;
+    batch->remaining = chunks;
+
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t begin = c * grainSize;
+        size_t end = min(count, begin + grainSize);
+        push([batch, begin, end, &body]() {
+            try {
+                body(begin, end);
+            } catch (...) {
+                lock_guard<mutex> guard(batch->lock);
+                if (!batch->error) {
+                    batch->error = current_exception();
+                }
+            }
+            if (--batch->remaining == 0) {
+                lock_guard<mutex> guard(batch->lock);
+                batch->finished.notify_all();
+            }
+        });
+    }
+
+    // Work on queued tasks (ours or anyone's) instead of idling; once the deques are empty the
+    // remaining chunks are already running elsewhere, so wait for them to finish.
+    size_t ownQueue = currentQueue();
+    while (batch->remaining > 0) {
+        if (!tryRunTask(ownQueue)) {
+            unique_lock<mutex> guard(batch->lock);
+            batch->finished.wait(guard, [&batch]() { return batch->remaining == 0; });
+        }
+    }
+
+    if (batch->error) {
+        rethrow_exception(batch->error);
+    }
+}
+
+// Main loop of a worker thread: run tasks while there are any, otherwise sleep.
+void ThreadPool::workerLoop(size_t queueIndex) {
+    currentPool = this;
+    currentWorkerQueue = queueIndex;
+
+    while (true) {
+        if (tryRunTask(queueIndex)) {
+            continue;
+        }
+        unique_lock<mutex> guard(sleepLock_);
+        wakeUp_.wait(guard, [this]() { return stopping_ || queuedTasks_ > 0; });
+        if (stopping_ && queuedTasks_ == 0) {
+            return;
+        }
+    }
+}
+
+// Adds a task to the next deque in round-robin order and wakes a sleeping worker.
+void ThreadPool::push(function<void()> task) {
+    size_t index = nextQueue_++ % queues_.size();
+    {
+        lock_guard<mutex> guard(queues_[index]->lock);
+        queues_[index]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard<mutex> guard(sleepLock_);
+        ++queuedTasks_;
+    }
+    wakeUp_.notify_one();
+}
+
+// Runs one task: newest from our own deque, otherwise the oldest task of another deque.
+bool ThreadPool::tryRunTask(size_t preferredQueue) {
+    function<void()> task;
+    for (size_t offset = 0; offset < queues_.size() && !task; ++offset) {
+        WorkQueue& queue = *queues_[(preferredQueue + offset) % queues_.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (offset == 0) {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    {
+        lock_guard<mutex> guard(sleepLock_);
+        --queuedTasks_;
+    }
+    task();
+    return true;
+}
+
+// Deque index owned by the current thread, or the caller's deque for outside threads.
+size_t ThreadPool::currentQueue() const {
+    return currentPool == this ? currentWorkerQueue : queues_.size() - 1;
+}
@@ -0,0 +1,84 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+using namespace std;
+
+// Fixed-size work-stealing thread pool. Each worker owns a task deque: it pops its own work
+// from the back and steals from the front of the other deques when it runs dry.
+// The thread calling parallelFor works as one of the pool's workers until its loop finishes.
+class ThreadPool {
+public:
+    // Constructor: Creates a pool with the given number of workers (0 = hardware concurrency).
+    // The calling thread counts as one worker, so workerCount - 1 threads are started.
+    explicit ThreadPool(size_t workerCount = 0);
+
+    // Destructor: Stops and joins the worker threads.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of workers, including the calling thread.
+    size_t size() const;
+
+    // Runs body(begin, end) over [0, count) split into chunks of at most grainSize items and
+    // blocks until every chunk has finished. Chunks may run in any order on any worker, so
+    // bodies should write their results by index. The first exception thrown is rethrown here.
+    void parallelFor(size_t count, size_t grainSize, const function<void(size_t, size_t)>& body);
+
+    // Number of hardware threads, or 1 if it cannot be determined.
+    static size_t defaultWorkerCount();
+
+private:
+    // Task deque owned by one worker.
+    struct WorkQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    // Completion state shared by the chunks of one parallelFor call.
+    struct Batch {
+        atomic<size_t> remaining;
+        mutex lock;
+        condition_variable finished;
+        exception_ptr error;
+    };
+
+    size_t workerCount_;
+    vector<unique_ptr<WorkQueue>> queues_;
+    vector<thread> threads_;
+
+    // Sleeping workers wait here until tasks are queued or the pool stops.
+    mutex sleepLock_;
+    condition_variable wakeUp_;
+    size_t queuedTasks_;
+    bool stopping_;
+
+    // Round-robin cursor used to spread new tasks over the deques.
+    atomic<size_t> nextQueue_;
+
+    // Main loop of a worker thread.
+    void workerLoop(size_t queueIndex);
+
+    // Adds a task to the next deque in round-robin order and wakes a sleeping worker.
+    void push(function<void()> task);
+
+    // Runs one task, popping from the preferred deque first and then stealing from the others.
+    // Returns false if every deque was empty.
+    bool tryRunTask(size_t preferredQueue);
+
+    // Deque index owned by the current thread, or the caller's deque for outside threads.
+    size_t currentQueue() const;
+};
+
+#endif // THREADPOOL_H
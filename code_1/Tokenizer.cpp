@@ -0,0 +1,40 @@
+#include "Tokenizer.h"
+
+// Classifies every byte value (1 = Space, 2 = Upper, 3 = Lower, 0 = Other); whitespace is the
+// same set as isspace in the "C" locale.
+static constexpr array<unsigned char, 256> makeByteClasses() {
+    array<unsigned char, 256> classes{};
+    for (int c = 0; c < 256; ++c) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r') {
+            classes[c] = 1;
+        } else if (c >= 'A' && c <= 'Z') {
+            classes[c] = 2;
+        } else if (c >= 'a' && c <= 'z') {
+            classes[c] = 3;
+        }
+    }
+    return classes;
+}
+
+const uint64_t Tokenizer::hashOffset;
+const uint64_t Tokenizer::hashPrime;
+const array<unsigned char, 256> Tokenizer::byteClasses = makeByteClasses();
+
+// Constructor: Starts with room for tokens of up to 64 letters.
+Tokenizer::Tokenizer() : buffer_(64, '\0') {}
+
+// Collects the tokens of the text as strings.
+vector<string> Tokenizer::tokenize(string_view text) {
+    vector<string> tokens;
+    scan(text, [&](string_view token, uint64_t) { tokens.emplace_back(token); });
+    return tokens;
+}
+
+// FNV-1a over the token bytes, matching the hash computed by scan.
+uint64_t Tokenizer::hashToken(string_view token) {
+    uint64_t hash = hashOffset;
+    for (char c : token) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * hashPrime;
+    }
+    return hash;
+}
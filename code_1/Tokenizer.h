@@ -0,0 +1,78 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Single-pass email tokenizer.
+// Tokens are separated by whitespace; every byte inside a token that is not an ASCII letter is
+// dropped and letters are lowercased, so "Don't!" becomes "dont". Tokens left empty are
+// skipped. This is the same tokenization as splitting with istringstream and cleaning each
+// word, but done in one scan over the bytes: letters are lowercased into a reused buffer and
+// hashed as they are read, so no memory is allocated per token.
+class Tokenizer {
+public:
+    // Constructor: Creates a tokenizer with a small reusable token buffer.
+    Tokenizer();
+
+    // Calls onToken(token, hash) for every token of the text, in order. The token view is only
+    // valid during the call; hash equals hashToken(token).
+    template <typename Callback>
+    void scan(string_view text, Callback&& onToken);
+
+    // Returns the tokens of the text as strings.
+    vector<string> tokenize(string_view text);
+
+    // FNV-1a hash of an already cleaned (lowercase) token.
+    static uint64_t hashToken(string_view token);
+
+private:
+    // Byte classes used by the scanner.
+    enum ByteClass : unsigned char { Other, Space, Upper, Lower };
+
+    static const uint64_t hashOffset = 14695981039346656037ULL;
+    static const uint64_t hashPrime = 1099511628211ULL;
+
+    // Class of each byte value (whitespace as in the "C" locale).
+    static const array<unsigned char, 256> byteClasses;
+
+    // Lowercased letters of the current token; grows only for tokens longer than any seen.
+    string buffer_;
+};
+
+// Runs the scanner; kept in the header so the callback can be inlined.
+template <typename Callback>
+void Tokenizer::scan(string_view text, Callback&& onToken) {
+    size_t length = 0;
+    uint64_t hash = hashOffset;
+    for (char byte : text) {
+        unsigned char c = static_cast<unsigned char>(byte);
+        unsigned char byteClass = byteClasses[c];
+        if (byteClass == Space) {
+            // End of a token; tokens with no letters are skipped.
+            if (length > 0) {
+                onToken(string_view(buffer_.data(), length), hash);
+                length = 0;
+                hash = hashOffset;
+            }
+        } else if (byteClass != Other) {
+            if (length == buffer_.size()) {
+                buffer_.resize(buffer_.size() * 2);
+            }
+            char lower = static_cast<char>(byteClass == Upper ? c | 0x20 : c);
+            buffer_[length++] = lower;
+            hash = (hash ^ static_cast<unsigned char>(lower)) * hashPrime;
+        }
+    }
+    if (length > 0) {
+        onToken(string_view(buffer_.data(), length), hash);
+    }
+}
+
+#endif // TOKENIZER_H
@@ -0,0 +1,178 @@
+#include "TrainingCondenser.h"
+#include "ExactIndex.h"
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+// Input rows per prototype kept.
+double TrainingCondenser::Result::compressionRatio() const {
+    return features.empty() ? 1.0 : static_cast<double>(inputRows) / features.size();
+}
+
+// Constructor: Validates the options.
+TrainingCondenser::TrainingCondenser(const Options& options, ThreadPool* pool) : options_(options), pool_(pool) {
+    if (options_.edit && options_.editK <= 0) {
+        throw invalid_argument("The number of editing neighbors must be positive.");
+    }
+}
+
+// Deduplicate, then edit before condensing: condensation keeps the prototypes near the class
+// boundary, so noisy ones have to be gone by then.
+TrainingCondenser::Result TrainingCondenser::reduce(const vector<vector<double>>& features, const vector<bool>& labels) const {
+    KNN_TIMED_SCOPE("condenser.reduce");
+    if (features.size() != labels.size()) {
+        throw invalid_argument("Training features and labels must have the same length");
+    }
+    for (const auto& row : features) {
+        if (row.size() != features[0].size()) {
+            throw invalid_argument("Training feature vectors must all have the same length");
+        }
+    }
+
+    Result result;
+    result.inputRows = features.size();
+    deduplicate(features, labels, result);
+    result.uniqueRows = result.features.size();
+    if (options_.edit) {
+        editPrototypes(result);
+    }
+    result.editedRows = result.features.size();
+    if (options_.condense) {
+        condensePrototypes(result);
+    }
+    result.condensedRows = result.features.size();
+    return result;
+}
+
+// Rows are hashed with FNV-1a over their bytes and the label, and only rows in the same hash
+// bucket are compared in full.
+void TrainingCondenser::deduplicate(const vector<vector<double>>& features, const vector<bool>& labels, Result& result) {
+    unordered_map<uint64_t, vector<size_t>> buckets;
+    buckets.reserve(features.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        uint64_t hash = labels[i] ? 0x84222325CBF29CE4ULL : 0xCBF29CE484222325ULL;
+        for (double value : features[i]) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            hash = (hash ^ bits) * 0x100000001B3ULL;
+        }
+
+        vector<size_t>& bucket = buckets[hash];
+        auto match = find_if(bucket.begin(), bucket.end(), [&](size_t prototype) {
+            return result.labels[prototype] == labels[i] && result.features[prototype] == features[i];
+        });
+        if (match != bucket.end()) {
+            ++result.weights[*match];
+            continue;
+        }
+        bucket.push_back(result.features.size());
+        result.features.push_back(features[i]);
+        result.labels.push_back(labels[i]);
+        result.weights.push_back(1);
+        result.sourceRows.push_back(i);
+    }
+}
+
+// Each prototype is voted on by the editK nearest rows of the original training set other than
+// itself: first its own duplicates (at distance 0), then the other prototypes nearest first,
+// each counting as many rows as it stands for. It is dropped if most of those votes go to the
+// other label. All decisions are taken on the unedited set.
+void TrainingCondenser::editPrototypes(Result& result) const {
+    KNN_TIMED_SCOPE("condenser.edit");
+    ExactIndex index;
+    index.build(result.features);
+    size_t editK = static_cast<size_t>(options_.editK);
+    vector<vector<Neighbor>> neighbors = index.searchBatch(result.features, editK + 1, pool_);
+
+    vector<bool> kept(result.features.size(), true);
+    for (size_t p = 0; p < result.features.size(); ++p) {
+        size_t votes = min<size_t>(result.weights[p] - 1, editK);
+        size_t agreeing = votes;
+        for (const auto& neighbor : neighbors[p]) {
+            if (votes == editK) {
+                break;
+            }
+            size_t other = static_cast<size_t>(neighbor.second);
+            if (other == p) {
+                continue;
+            }
+            size_t count = min<size_t>(result.weights[other], editK - votes);
+            votes += count;
+            agreeing += result.labels[other] == result.labels[p] ? count : 0;
+        }
+        kept[p] = 2 * agreeing >= votes;
+    }
+    keep(result, kept);
+}
+
+// Hart's algorithm: starting from the first prototype, every prototype that the kept ones
+// misclassify by 1-NN is kept too, in passes until a pass keeps nothing new. In that last
+// pass every dropped prototype was classified correctly by its nearest kept prototype, which
+// then takes over its weight.
+void TrainingCondenser::condensePrototypes(Result& result) const {
+    KNN_TIMED_SCOPE("condenser.condense");
+    size_t count = result.features.size();
+    if (count == 0) {
+        return;
+    }
+
+    ExactIndex store;
+    vector<size_t> storePrototypes;
+    vector<bool> kept(count, false);
+    vector<size_t> nearest(count, 0);
+    store.append(result.features[0]);
+    storePrototypes.push_back(0);
+    kept[0] = true;
+
+    bool added = true;
+    while (added) {
+        added = false;
+        for (size_t p = 1; p < count; ++p) {
+            if (kept[p]) {
+                continue;
+            }
+            vector<Neighbor> closest = store.search(result.features[p], 1);
+            size_t prototype = storePrototypes[closest[0].second];
+            if (result.labels[prototype] != result.labels[p]) {
+                store.append(result.features[p]);
+                storePrototypes.push_back(p);
+                kept[p] = true;
+                added = true;
+            } else {
+                nearest[p] = prototype;
+            }
+        }
+    }
+
+    for (size_t p = 0; p < count; ++p) {
+        if (!kept[p]) {
+            result.weights[nearest[p]] += result.weights[p];
+        }
+    }
+    keep(result, kept);
+}
+
+// Compacts the prototype arrays in place.
+void TrainingCondenser::keep(Result& result, const vector<bool>& kept) {
+    size_t next = 0;
+    for (size_t p = 0; p < kept.size(); ++p) {
+        if (!kept[p]) {
+            continue;
+        }
+        if (next != p) {
+            result.features[next] = move(result.features[p]);
+            result.labels[next] = result.labels[p];
+            result.weights[next] = result.weights[p];
+            result.sourceRows[next] = result.sourceRows[p];
+        }
+        ++next;
+    }
+    result.features.resize(next);
+    result.labels.resize(next);
+    result.weights.resize(next);
+    result.sourceRows.resize(next);
+}
@@ -0,0 +1,82 @@
+#ifndef TRAININGCONDENSER_H
+#define TRAININGCONDENSER_H
+
+#include <vector>
+#include <cstddef>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Shrinks a training set before it is handed to KNNClassifier, so every query scans fewer rows.
+// Exact duplicates (same feature vector and label) always collapse into one prototype whose
+// weight is the number of rows it stands for; KNNClassifier then counts it as that many
+// neighbors, so deduplication alone only changes a vote when rows of different prototypes tie
+// at the k-th distance (which of them counted was down to row order anyway). Two optional
+// reductions run on the prototypes afterwards:
+//   edit (Wilson's Edited Nearest Neighbor): drops prototypes outvoted by their editK nearest
+//        neighbors, which removes label noise and conflicting duplicates.
+//   condense (Hart's Condensed Nearest Neighbor): keeps only the prototypes needed for the
+//        rest to be classified correctly by their nearest kept prototype; the weight of each
+//        dropped prototype moves to that nearest kept one.
+// Both change the decision boundary, so their effect on accuracy should be measured on
+// held-out emails (see tools/condense_report.cpp).
+class TrainingCondenser {
+public:
+    // Which reductions run after deduplication.
+    struct Options {
+        // Run Edited Nearest Neighbor with editK neighbors.
+        bool edit;
+        int editK;
+
+        // Run Condensed Nearest Neighbor.
+        bool condense;
+
+        Options() : edit(false), editK(3), condense(false) {}
+    };
+
+    // Reduced training set and what each stage removed.
+    struct Result {
+        // Prototype feature vectors, labels and weights (rows represented), in order of first
+        // appearance in the input.
+        vector<vector<double>> features;
+        vector<bool> labels;
+        vector<int> weights;
+
+        // Input row each prototype was taken from.
+        vector<size_t> sourceRows;
+
+        // Rows in the input, and prototypes left after each stage.
+        size_t inputRows;
+        size_t uniqueRows;
+        size_t editedRows;
+        size_t condensedRows;
+
+        // Input rows per prototype kept (1 when nothing was removed).
+        double compressionRatio() const;
+    };
+
+    // Constructor: Validates the options; searches run on the pool when one is given.
+    explicit TrainingCondenser(const Options& options = Options(), ThreadPool* pool = nullptr);
+
+    // Reduces a training set; throws invalid_argument if features and labels differ in length
+    // or the rows differ in length.
+    Result reduce(const vector<vector<double>>& features, const vector<bool>& labels) const;
+
+private:
+    Options options_;
+    ThreadPool* pool_;
+
+    // Collapses exact duplicates into weighted prototypes.
+    static void deduplicate(const vector<vector<double>>& features, const vector<bool>& labels, Result& result);
+
+    // Wilson editing of the prototypes in place.
+    void editPrototypes(Result& result) const;
+
+    // Hart condensation of the prototypes in place.
+    void condensePrototypes(Result& result) const;
+
+    // Keeps the prototypes whose flag is set.
+    static void keep(Result& result, const vector<bool>& kept);
+};
+
+#endif // TRAININGCONDENSER_H
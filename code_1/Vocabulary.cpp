@@ -0,0 +1,74 @@
+#include "Vocabulary.h"
+#include "Tokenizer.h"
+
+// Constructor: Starts with no words and an empty one-slot table.
+Vocabulary::Vocabulary() : slots_(1, Slot{0, -1}), mask_(0) {}
+
+// Constructor: Builds the table for the given words.
+Vocabulary::Vocabulary(const vector<string>& words) : Vocabulary() {
+    assign(words);
+}
+
+// Rebuilds the table with a power-of-two capacity of at least twice the word count.
+void Vocabulary::assign(const vector<string>& words) {
+    words_ = words;
+    duplicates_.assign(words.size(), -1);
+
+    size_t capacity = 1;
+    while (capacity < words.size() * 2) {
+        capacity *= 2;
+    }
+    slots_.assign(capacity, Slot{0, -1});
+    mask_ = capacity - 1;
+
+    // lastDuplicate[i] is the end of the duplicate chain starting at feature i.
+    vector<int> lastDuplicate(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        lastDuplicate[i] = static_cast<int>(i);
+        uint64_t hash = Tokenizer::hashToken(words[i]);
+        size_t position = hash & mask_;
+        while (slots_[position].index >= 0) {
+            int first = slots_[position].index;
+            if (slots_[position].hash == hash && words_[first] == words[i]) {
+                // Repeated word: chain it after the earlier occurrences.
+                duplicates_[lastDuplicate[first]] = static_cast<int>(i);
+                lastDuplicate[first] = static_cast<int>(i);
+                break;
+            }
+            position = (position + 1) & mask_;
+        }
+        if (slots_[position].index < 0) {
+            slots_[position] = Slot{hash, static_cast<int>(i)};
+        }
+    }
+}
+
+// Probes from the hash's home slot until the word or an empty slot is found.
+int Vocabulary::find(string_view word, uint64_t hash) const {
+    size_t position = hash & mask_;
+    while (true) {
+        const Slot& slot = slots_[position];
+        if (slot.index < 0) {
+            return -1;
+        }
+        if (slot.hash == hash && words_[slot.index] == word) {
+            return slot.index;
+        }
+        position = (position + 1) & mask_;
+    }
+}
+
+// Hashes the word and looks it up.
+int Vocabulary::find(string_view word) const {
+    return find(word, Tokenizer::hashToken(word));
+}
+
+// Follows the duplicate chain.
+int Vocabulary::nextDuplicate(int index) const {
+    return duplicates_[index];
+}
+
+// Returns the number of feature words.
+size_t Vocabulary::size() const {
+    return words_.size();
+}
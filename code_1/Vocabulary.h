@@ -0,0 +1,54 @@
+#ifndef VOCABULARY_H
+#define VOCABULARY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Maps the selected top feature words to their feature index.
+// An open-addressing hash table with linear probing, keyed by the same FNV-1a hash the
+// Tokenizer computes while scanning, so a token can be looked up without copying it. The
+// table is kept at most half full and stores each slot's full hash, so a miss usually costs
+// one or two probes and no string comparison.
+class Vocabulary {
+public:
+    // Constructor: Creates an empty vocabulary.
+    Vocabulary();
+
+    // Constructor: Builds the vocabulary of the given feature words.
+    explicit Vocabulary(const vector<string>& words);
+
+    // Replaces the vocabulary with the given feature words; word i gets feature index i.
+    void assign(const vector<string>& words);
+
+    // Feature index of the word, or -1 if it is not in the vocabulary. hash must be
+    // Tokenizer::hashToken(word).
+    int find(string_view word, uint64_t hash) const;
+
+    // Same as above, hashing the word first.
+    int find(string_view word) const;
+
+    // Next feature index with the same word as the given index, or -1. Only needed when the
+    // word list contains duplicates.
+    int nextDuplicate(int index) const;
+
+    // Number of feature words (including duplicates).
+    size_t size() const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        int index;
+    };
+
+    vector<string> words_;
+    vector<int> duplicates_;
+    vector<Slot> slots_;
+    size_t mask_;
+};
+
+#endif // VOCABULARY_H
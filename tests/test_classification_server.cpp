@@ -0,0 +1,143 @@
+#include "test_support.h"
+#include "../code_1/ClassificationServer.h"
+#include "../code_1/FeatureExtractor.h"
+
+#include <chrono>
+#include <future>
+#include <sstream>
+#include <unistd.h>
+
+using namespace testsupport;
+
+namespace {
+
+// A classifier trained on synthetic emails with its top features.
+struct TrainedModel {
+    vector<string> topFeatures;
+    KNNClassifier classifier;
+
+    TrainedModel() : classifier(5) {
+        vector<pair<pair<string, string>, bool>> training = syntheticEmails(300, 11);
+        FeatureExtractor extractor;
+        topFeatures = extractor.extractBalancedTopFeatures(training, 60);
+        vector<bool> labels;
+        for (const auto& email : training) {
+            labels.push_back(email.second);
+        }
+        classifier.train(extractor.extractFeaturesBatch(training, topFeatures), labels);
+    }
+};
+
+// Writes all of text to a descriptor.
+void writeText(int fd, const string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t count = ::write(fd, text.data() + written, text.size() - written);
+        ASSERT_GT(count, 0);
+        written += static_cast<size_t>(count);
+    }
+}
+
+// Reads a descriptor until end of input.
+string readAll(int fd) {
+    string text;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<size_t>(count));
+    }
+    return text;
+}
+
+// Serves the whole of input as one stream and returns the verdict lines.
+string serveAll(ClassificationServer& server, const string& input) {
+    int in[2], out[2];
+    EXPECT_EQ(::pipe(in), 0);
+    EXPECT_EQ(::pipe(out), 0);
+    writeText(in[1], input);
+    ::close(in[1]);
+    server.serveStream(in[0], out[1]);
+    ::close(in[0]);
+    ::close(out[1]);
+    string verdicts = readAll(out[0]);
+    ::close(out[0]);
+    return verdicts;
+}
+
+// CSV records of the emails, some of them quoted over several lines.
+string csvRecords(const vector<pair<pair<string, string>, bool>>& emails) {
+    ostringstream csv;
+    for (const auto& email : emails) {
+        SyntheticCorpus::writeRecord(csv, SyntheticCorpus::Email{email.first.first, email.first.second, email.second});
+    }
+    return csv.str();
+}
+
+} // namespace
+
+// Every record of a stream is answered in input order with the classifier's own verdict, a
+// record without a message is Invalid, and all of them are written before end of input
+// returns serveStream.
+TEST(ClassificationServer, AnswersStreamInOrderAndDrainsAtEnd) {
+    TrainedModel model;
+    vector<pair<pair<string, string>, bool>> emails = syntheticEmails(120, 12);
+    FeatureExtractor extractor;
+    vector<Prediction> expected = model.classifier.predictBatch(extractor.extractFeaturesBatch(emails, model.topFeatures));
+
+    ClassificationServer::Options options;
+    options.maxBatch = 16;
+    ClassificationServer server(model.classifier, model.topFeatures, nullptr, options);
+    vector<pair<pair<string, string>, bool>> first(emails.begin(), emails.begin() + 50);
+    vector<pair<pair<string, string>, bool>> rest(emails.begin() + 50, emails.end());
+    string verdicts = serveAll(server, csvRecords(first) + "no message here\n" + csvRecords(rest));
+
+    ostringstream wanted;
+    for (size_t i = 0, sequence = 1; i < emails.size(); ++i, ++sequence) {
+        if (i == 50) {
+            wanted << sequence++ << ",Invalid\n";
+        }
+        wanted << sequence << (expected[i].isSpam ? ",Spam" : ",Ham") << "\n";
+    }
+    EXPECT_EQ(verdicts, wanted.str());
+    EXPECT_EQ(server.stats().emails, emails.size() + 1);
+}
+
+// A batch that fails to classify is answered Error and the server keeps serving.
+TEST(ClassificationServer, FailedBatchIsAnsweredError) {
+    KNNClassifier classifier(1);
+    classifier.train({{0.0, 1.0}, {1.0, 0.0}}, {true, false});
+    // Three features against a classifier trained on two: every prediction throws.
+    ClassificationServer::Options options;
+    options.maxBatch = 1;
+    ClassificationServer server(classifier, vector<string>{"a", "b", "c"}, nullptr, options);
+    EXPECT_EQ(serveAll(server, "hello,world\nno message\nsecond,email\n"), "1,Error\n2,Invalid\n3,Error\n");
+}
+
+// requestStop ends a stream whose writer keeps it open, after answering what was read.
+TEST(ClassificationServer, StopEndsOpenStream) {
+    TrainedModel model;
+    ClassificationServer server(model.classifier, model.topFeatures);
+    int in[2], out[2];
+    ASSERT_EQ(::pipe(in), 0);
+    ASSERT_EQ(::pipe(out), 0);
+    future<void> serving = async(launch::async, [&] { server.serveStream(in[0], out[1]); });
+
+    writeText(in[1], "first,email\nsecond,email\n");
+    string verdicts;
+    char buffer[256];
+    while (count(verdicts.begin(), verdicts.end(), '\n') < 2) {
+        ssize_t bytes = ::read(out[0], buffer, sizeof(buffer));
+        ASSERT_GT(bytes, 0);
+        verdicts.append(buffer, static_cast<size_t>(bytes));
+    }
+    server.requestStop();
+    bool stopped = serving.wait_for(chrono::seconds(10)) == future_status::ready;
+    // Closing the input lets a server that ignored the stop return, so the test cannot hang.
+    ::close(in[1]);
+    serving.wait();
+    EXPECT_TRUE(stopped);
+    EXPECT_EQ(server.stats().emails, 2u);
+    ::close(in[0]);
+    ::close(out[0]);
+    ::close(out[1]);
+}
@@ -0,0 +1,51 @@
+#include "test_support.h"
+#include "../code_1/CrossValidator.h"
+#include "../code_1/FeatureExtractor.h"
+
+using namespace testsupport;
+
+// Every configuration of a sweep scores exactly like training and predicting it from scratch
+// in each fold: its own top features, a fresh classifier at its own k.
+TEST(CrossValidator, SweepMatchesIndependentRuns) {
+    vector<pair<pair<string, string>, bool>> data = syntheticEmails(240, 21);
+    const int folds = 3;
+    vector<int> ks = {1, 2, 3, 4, 7};
+    vector<int> ns = {10, 40, 120};
+    ThreadPool pool(3);
+    FeatureExtractor extractor;
+
+    for (KNNClassifier::Voting voting : {KNNClassifier::Majority, KNNClassifier::DistanceWeighted}) {
+        CrossValidator::Report report = CrossValidator(data, folds, &pool).sweep(ks, ns, voting);
+        ASSERT_EQ(report.results.size(), ks.size() * ns.size());
+        for (const CrossValidator::Result& result : report.results) {
+            size_t truePositives = 0, falsePositives = 0, trueNegatives = 0, falseNegatives = 0;
+            for (int fold = 0; fold < folds; ++fold) {
+                vector<pair<pair<string, string>, bool>> trainingData, heldOutData;
+                for (size_t i = 0; i < data.size(); ++i) {
+                    (i % folds == static_cast<size_t>(fold) ? heldOutData : trainingData).push_back(data[i]);
+                }
+                vector<string> topFeatures = extractor.extractBalancedTopFeatures(trainingData, result.N);
+                vector<bool> labels;
+                for (const auto& email : trainingData) {
+                    labels.push_back(email.second);
+                }
+                KNNClassifier classifier(result.k);
+                classifier.setVoting(voting);
+                classifier.train(extractor.extractFeaturesBatch(trainingData, topFeatures), labels);
+                vector<Prediction> predictions = classifier.predictBatch(extractor.extractFeaturesBatch(heldOutData, topFeatures));
+                for (size_t q = 0; q < heldOutData.size(); ++q) {
+                    bool isSpam = heldOutData[q].second;
+                    truePositives += predictions[q].isSpam && isSpam;
+                    falsePositives += predictions[q].isSpam && !isSpam;
+                    trueNegatives += !predictions[q].isSpam && !isSpam;
+                    falseNegatives += !predictions[q].isSpam && isSpam;
+                }
+            }
+            SCOPED_TRACE("voting " + to_string(voting) + ", k " + to_string(result.k) + ", N " + to_string(result.N));
+            EXPECT_EQ(result.truePositives, truePositives);
+            EXPECT_EQ(result.falsePositives, falsePositives);
+            EXPECT_EQ(result.trueNegatives, trueNegatives);
+            EXPECT_EQ(result.falseNegatives, falseNegatives);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "../code_1/CsvParser.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A document with quoted commas, escaped quotes, LF and CRLF line breaks inside quoted fields,
+// a blank line, CRLF record ends and a last record without a line break.
+const string document =
+    "subject,message\r\n"
+    "plain,text\n"
+    "\"quoted, comma\",\"line one\nline two\"\n"
+    "\"escaped \"\"quote\"\"\",x\n"
+    "\n"
+    "\"crlf\r\ninside\",\"\"\r\n"
+    "unquoted,message,with,commas\n"
+    "tail,end";
+
+const vector<vector<string>> expectedRecords = {
+    {"subject", "message"},
+    {"plain", "text"},
+    {"quoted, comma", "line one\nline two"},
+    {"escaped \"quote\"", "x"},
+    {"crlf\r\ninside", ""},
+    {"unquoted", "message", "with", "commas"},
+    {"tail", "end"},
+};
+
+// Record handler that copies every field, since the views do not outlive the call.
+struct Collector {
+    vector<vector<string>> records;
+
+    CsvParser::RecordHandler handler() {
+        return [this](const vector<string_view>& fields) {
+            records.emplace_back(fields.begin(), fields.end());
+        };
+    }
+};
+
+} // namespace
+
+// A whole document in one buffer.
+TEST(CsvParser, ParsesQuotedFieldsAndLineBreaks) {
+    CsvParser parser;
+    Collector collector;
+    parser.parse(document, collector.handler());
+    EXPECT_EQ(collector.records, expectedRecords);
+}
+
+// Split into two chunks at every position, so every state meets a chunk boundary, including a
+// "" escape, a CRLF and a quote split across chunks.
+TEST(CsvParser, ChunkBoundariesAnywhere) {
+    for (size_t split = 0; split <= document.size(); ++split) {
+        CsvParser parser;
+        Collector collector;
+        parser.feed(string_view(document).substr(0, split), collector.handler());
+        parser.feed(string_view(document).substr(split), collector.handler());
+        parser.finish(collector.handler());
+        EXPECT_EQ(collector.records, expectedRecords) << "split at " << split;
+    }
+}
+
+// Streams read in chunks of a few bytes.
+TEST(CsvParser, StreamsInSmallChunks) {
+    for (size_t chunkSize : {1u, 2u, 3u, 7u, 64u}) {
+        CsvParser parser(chunkSize);
+        Collector collector;
+        istringstream in(document);
+        parser.parse(in, collector.handler());
+        EXPECT_EQ(collector.records, expectedRecords) << "chunk size " << chunkSize;
+    }
+}
+
+// Input ending inside a quoted field is an error.
+TEST(CsvParser, RejectsUnterminatedQuote) {
+    CsvParser parser;
+    Collector collector;
+    EXPECT_THROW(parser.parse(string_view("subject,message\n\"open,field\n"), collector.handler()), runtime_error);
+}
@@ -0,0 +1,112 @@
+#include "test_support.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/InvertedIndex.h"
+
+using namespace testsupport;
+
+namespace {
+
+// Binary training rows with exact duplicates, so ties and the early exit on k duplicates are
+// exercised, and the labels.
+struct BinaryData {
+    vector<vector<double>> rows;
+    vector<bool> labels;
+    vector<vector<double>> queries;
+};
+
+BinaryData binaryData(int N) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(400, 4);
+    vector<pair<pair<string, string>, bool>> test = syntheticEmails(80, 5);
+    FeatureExtractor extractor;
+    vector<string> topFeatures = extractor.extractBalancedTopFeatures(training, N);
+    BinaryData data;
+    data.rows = extractor.extractFeaturesBatch(training, topFeatures);
+    for (const auto& email : training) {
+        data.labels.push_back(email.second);
+    }
+    for (size_t i = 0; i < 40; ++i) {
+        data.rows.push_back(data.rows[i * 7]);
+        data.labels.push_back(data.labels[i * 7]);
+    }
+    data.queries = extractor.extractFeaturesBatch(test, topFeatures);
+    data.queries.push_back(data.rows[0]);
+    data.queries.push_back(vector<double>(N, 0.0));
+    return data;
+}
+
+// Packs the rows the way ExactIndex and ModelSnapshot store them.
+vector<uint64_t> packRows(const vector<vector<double>>& rows, size_t featureCount) {
+    size_t wordsPerRow = (featureCount + 63) / 64;
+    vector<uint64_t> packed(rows.size() * wordsPerRow, 0);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        NeighborIndex::packBinaryVector(rows[i], &packed[i * wordsPerRow]);
+    }
+    return packed;
+}
+
+} // namespace
+
+// The exact dense scan, the packed scan of trainPacked and the inverted index all return the
+// brute-force neighbors, on both sides of a 64-feature word boundary.
+TEST(IndexAgreement, ExactInvertedAndPackedMatchBruteForce) {
+    for (int N : {30, 100}) {
+        BinaryData data = binaryData(N);
+        vector<uint64_t> packed = packRows(data.rows, N);
+        for (size_t k : {1u, 5u, 20u}) {
+            KNNClassifier dense(static_cast<int>(k));
+            dense.train(data.rows, data.labels);
+            KNNClassifier packedClassifier(static_cast<int>(k));
+            packedClassifier.trainPacked(packed.data(), data.rows.size(), N, data.labels);
+            KNNClassifier inverted(static_cast<int>(k));
+            inverted.setSearchMode(KNNClassifier::Sparse);
+            inverted.train(data.rows, data.labels);
+            EXPECT_TRUE(dense.usesBinaryFeatures());
+
+            for (size_t q = 0; q < data.queries.size(); ++q) {
+                vector<Neighbor> expected = bruteForceNeighbors(data.rows, data.queries[q], k);
+                EXPECT_EQ(dense.neighborIndex().search(data.queries[q], k), expected) << "N " << N << ", k " << k << ", query " << q;
+                EXPECT_EQ(packedClassifier.neighborIndex().search(data.queries[q], k), expected) << "N " << N << ", k " << k << ", query " << q;
+                EXPECT_EQ(inverted.neighborIndex().search(data.queries[q], k), expected) << "N " << N << ", k " << k << ", query " << q;
+            }
+            vector<Prediction> predictions = dense.predictBatch(data.queries);
+            expectSamePredictions(predictions, packedClassifier.predictBatch(data.queries));
+            expectSamePredictions(predictions, inverted.predictBatch(data.queries));
+        }
+    }
+}
+
+// The dense scan of weighted features also matches brute force; the values are small integers
+// so every distance is exact whatever the kernel's summation order.
+TEST(IndexAgreement, WeightedDenseScanMatchesBruteForce) {
+    BinaryData data = binaryData(70);
+    for (size_t i = 0; i < data.rows.size(); ++i) {
+        for (size_t j = 0; j < data.rows[i].size(); ++j) {
+            data.rows[i][j] *= static_cast<double>(1 + (i * 3 + j) % 4);
+        }
+    }
+    KNNClassifier classifier(5);
+    classifier.train(data.rows, data.labels);
+    EXPECT_FALSE(classifier.usesBinaryFeatures());
+    vector<vector<Neighbor>> batch = classifier.neighborIndex().searchBatch(data.queries, 5);
+    for (size_t q = 0; q < data.queries.size(); ++q) {
+        vector<Neighbor> expected = bruteForceNeighbors(data.rows, data.queries[q], 5);
+        EXPECT_EQ(classifier.neighborIndex().search(data.queries[q], 5), expected) << "query " << q;
+        EXPECT_EQ(batch[q], expected) << "query " << q;
+    }
+}
+
+// Inverted indexes of different sizes searched alternately on one thread share its scratch
+// counters, growing and reusing them, and still return the brute-force neighbors.
+TEST(IndexAgreement, InvertedIndexesShareThreadScratch) {
+    BinaryData data = binaryData(30);
+    vector<vector<double>> fewerRows(data.rows.begin(), data.rows.begin() + 50);
+    InvertedIndex small;
+    small.build(fewerRows);
+    InvertedIndex large;
+    large.build(data.rows);
+    for (size_t q = 0; q < data.queries.size(); ++q) {
+        EXPECT_EQ(small.search(data.queries[q], 5), bruteForceNeighbors(fewerRows, data.queries[q], 5)) << "query " << q;
+        EXPECT_EQ(large.search(data.queries[q], 5), bruteForceNeighbors(data.rows, data.queries[q], 5)) << "query " << q;
+    }
+    EXPECT_EQ(small.searchBatch(data.queries, 5)[0], bruteForceNeighbors(fewerRows, data.queries[0], 5));
+}
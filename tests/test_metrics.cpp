@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "../code_1/Metrics.h"
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Value a histogram reports for a duration's bucket: the duration is recorded with a far
+// larger one, so the median is that bucket's midpoint and not capped by the maximum.
+double reported(uint64_t nanoseconds) {
+    LatencyHistogram histogram;
+    histogram.record(nanoseconds);
+    histogram.record(uint64_t(1) << 60);
+    return histogram.percentileNanoseconds(0.5);
+}
+
+} // namespace
+
+// An empty histogram, new or reset, reports zeros.
+TEST(LatencyHistogram, EmptyReportsZero) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.percentileNanoseconds(0.5), 0.0);
+    EXPECT_EQ(histogram.percentileNanoseconds(1.0), 0.0);
+    histogram.record(1000);
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0u);
+    EXPECT_EQ(histogram.totalNanoseconds(), 0u);
+    EXPECT_EQ(histogram.maxNanoseconds(), 0u);
+    EXPECT_EQ(histogram.percentileNanoseconds(0.99), 0.0);
+}
+
+// Durations below 16 ns are exact; above, every power of two is split into 8 buckets.
+TEST(LatencyHistogram, BucketBoundaries) {
+    for (uint64_t nanoseconds = 0; nanoseconds < 16; ++nanoseconds) {
+        EXPECT_EQ(reported(nanoseconds), static_cast<double>(nanoseconds));
+    }
+    // [16, 18), [18, 20), ..., [30, 32), then [32, 36).
+    EXPECT_EQ(reported(16), 17.0);
+    EXPECT_EQ(reported(17), 17.0);
+    EXPECT_EQ(reported(18), 19.0);
+    EXPECT_EQ(reported(31), 31.0);
+    EXPECT_EQ(reported(32), 34.0);
+    EXPECT_EQ(reported(35), 34.0);
+    EXPECT_EQ(reported(36), 38.0);
+    // [2^20, 2^20 + 2^17) and the last bucket below 2^21.
+    EXPECT_EQ(reported(1u << 20), (1u << 20) + (1u << 16));
+    EXPECT_EQ(reported((1u << 21) - 1), (1u << 21) - (1u << 16));
+}
+
+// Every reported percentile is within 1/16 of the duration, across the whole range.
+TEST(LatencyHistogram, PercentileWithinOneSixteenth) {
+    vector<uint64_t> durations;
+    for (int exponent = 4; exponent < 60; ++exponent) {
+        uint64_t power = uint64_t(1) << exponent;
+        for (uint64_t offset : {uint64_t(0), uint64_t(1), power / 3, power / 2, power - 1}) {
+            durations.push_back(power + offset);
+        }
+    }
+    for (uint64_t nanoseconds : durations) {
+        double value = static_cast<double>(nanoseconds);
+        EXPECT_LE(fabs(reported(nanoseconds) - value), value / 16) << nanoseconds;
+    }
+}
+
+// Percentiles follow the ranks of the recorded durations and never exceed the maximum.
+TEST(LatencyHistogram, PercentilesFollowRanks) {
+    LatencyHistogram histogram;
+    for (uint64_t nanoseconds = 1; nanoseconds <= 100; ++nanoseconds) {
+        histogram.record(nanoseconds * 1000);
+    }
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_EQ(histogram.totalNanoseconds(), 5050000u);
+    EXPECT_EQ(histogram.maxNanoseconds(), 100000u);
+    EXPECT_NEAR(histogram.percentileNanoseconds(0.5), 50000.0, 50000.0 / 16);
+    EXPECT_NEAR(histogram.percentileNanoseconds(0.99), 99000.0, 99000.0 / 16);
+    EXPECT_LE(histogram.percentileNanoseconds(1.0), 100000.0);
+}
+
+// The JSON form starts with the enabled flag, as documented.
+TEST(Metrics, JsonHasEnabledFlag) {
+    Metrics metrics;
+    metrics.counter("test.counter").add(3);
+    ostringstream json;
+    metrics.writeJson(json);
+    EXPECT_EQ(json.str().rfind(string("{\"enabled\":") + (Metrics::enabled() ? "true" : "false") + ",\"counters\":{\"test.counter\":3}", 0), 0u);
+}
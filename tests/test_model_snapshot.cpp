@@ -0,0 +1,110 @@
+#include "test_support.h"
+#include "../code_1/ModelSnapshot.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace testsupport;
+
+namespace {
+
+// Binary rows over 70 features (two packed words per row) with labels and a vocabulary.
+struct Model {
+    vector<string> vocabulary;
+    vector<vector<double>> rows;
+    vector<bool> labels;
+};
+
+Model model() {
+    Model m;
+    for (int j = 0; j < 70; ++j) {
+        m.vocabulary.push_back("word" + to_string(j));
+    }
+    for (int i = 0; i < 33; ++i) {
+        vector<double> row(70, 0.0);
+        for (int j = 0; j < 70; ++j) {
+            row[j] = (i * 7 + j * 13) % 5 == 0 ? 1.0 : 0.0;
+        }
+        m.rows.push_back(row);
+        m.labels.push_back(i % 3 == 0);
+    }
+    return m;
+}
+
+string tempPath(const string& name) {
+    return ::testing::TempDir() + name;
+}
+
+string readFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void writeFile(const string& path, const string& bytes) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+} // namespace
+
+// Everything written is read back, and a classifier trained from the mapped rows predicts
+// exactly like one trained from the original vectors.
+TEST(ModelSnapshot, RoundTrip) {
+    Model m = model();
+    string path = tempPath("knn_snapshot_round_trip.bin");
+    ModelSnapshot::write(path, 3, 70, m.vocabulary, m.rows, m.labels, 0x1234abcdULL);
+
+    ModelSnapshot snapshot(path);
+    EXPECT_EQ(snapshot.k(), 3);
+    EXPECT_EQ(snapshot.N(), 70);
+    EXPECT_EQ(snapshot.sourceFingerprint(), 0x1234abcdULL);
+    EXPECT_EQ(snapshot.rowCount(), m.rows.size());
+    EXPECT_EQ(snapshot.featureCount(), 70u);
+    EXPECT_EQ(snapshot.wordsPerRow(), 2u);
+    EXPECT_EQ(snapshot.vocabulary(), m.vocabulary);
+    EXPECT_EQ(snapshot.labels(), m.labels);
+    for (size_t i = 0; i < m.rows.size(); ++i) {
+        EXPECT_EQ(NeighborIndex::unpackBinaryVector(snapshot.packedRows() + i * snapshot.wordsPerRow(), 70), m.rows[i]) << "row " << i;
+    }
+
+    KNNClassifier original(3);
+    original.train(m.rows, m.labels);
+    KNNClassifier loaded(3);
+    loaded.trainPacked(snapshot.packedRows(), snapshot.rowCount(), snapshot.featureCount(), snapshot.labels());
+    expectSamePredictions(original.predictBatch(m.rows), loaded.predictBatch(m.rows));
+    remove(path.c_str());
+}
+
+// A flipped byte anywhere after the header's checksum, a truncated file and a missing file
+// are all rejected.
+TEST(ModelSnapshot, RejectsCorruptedFiles) {
+    Model m = model();
+    string path = tempPath("knn_snapshot_corrupt.bin");
+    ModelSnapshot::write(path, 3, 70, m.vocabulary, m.rows, m.labels, 1);
+    string bytes = readFile(path);
+    ASSERT_GT(bytes.size(), 200u);
+
+    for (size_t offset : {bytes.size() / 2, bytes.size() - 1, static_cast<size_t>(200)}) {
+        string corrupted = bytes;
+        corrupted[offset] ^= 0x40;
+        writeFile(path, corrupted);
+        EXPECT_THROW(ModelSnapshot snapshot(path), runtime_error) << "byte " << offset;
+    }
+
+    writeFile(path, bytes.substr(0, bytes.size() - 8));
+    EXPECT_THROW(ModelSnapshot snapshot(path), runtime_error);
+    writeFile(path, bytes.substr(0, 16));
+    EXPECT_THROW(ModelSnapshot snapshot(path), runtime_error);
+
+    remove(path.c_str());
+    EXPECT_THROW(ModelSnapshot snapshot(path), runtime_error);
+}
+
+// Only binary rows can be written.
+TEST(ModelSnapshot, RejectsNonBinaryFeatures) {
+    Model m = model();
+    m.rows[4][2] = 0.5;
+    EXPECT_THROW(ModelSnapshot::write(tempPath("knn_snapshot_invalid.bin"), 3, 70, m.vocabulary, m.rows, m.labels, 1), invalid_argument);
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "../code_1/NeighborBuffer.h"
+#include "../code_1/KNNClassifier.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+// A buffer of size 0 must keep nothing and leave its threshold alone.
+TEST(NeighborBuffer, ZeroSizeKeepsNothing) {
+    NeighborBuffer buffer(0);
+    buffer.offer(3.0, 7);
+    buffer.offer(0.0, 1);
+    buffer.offer(numeric_limits<double>::infinity(), 2);
+    EXPECT_EQ(buffer.size(), 0u);
+    EXPECT_TRUE(buffer.neighbors().empty());
+    EXPECT_EQ(buffer.threshold(), numeric_limits<double>::infinity());
+    EXPECT_FALSE(buffer.settled());
+}
+
+// The kept neighbors are the k smallest (distance, index) pairs, whatever the offer order,
+// both for inline and for vector storage.
+TEST(NeighborBuffer, KeepsSmallestPairs) {
+    for (size_t k : {1u, 3u, 16u, 17u, 40u}) {
+        vector<Neighbor> candidates;
+        for (int i = 0; i < 100; ++i) {
+            candidates.push_back(Neighbor((i * 37) % 11, i));
+        }
+        vector<Neighbor> expected = candidates;
+        sort(expected.begin(), expected.end());
+        expected.resize(k);
+
+        NeighborBuffer buffer(k);
+        for (int i = 99; i >= 0; --i) {
+            buffer.offer(candidates[i].first, candidates[i].second);
+        }
+        EXPECT_EQ(buffer.neighbors(), expected) << "k = " << k;
+    }
+}
+
+// Ties with the farthest kept neighbor go to the lower index.
+TEST(NeighborBuffer, TiesPreferLowerIndex) {
+    NeighborBuffer buffer(2);
+    buffer.offer(1.0, 5);
+    buffer.offer(1.0, 9);
+    buffer.offer(1.0, 7);
+    buffer.offer(1.0, 2);
+    EXPECT_EQ(buffer.neighbors(), (vector<Neighbor>{Neighbor(1.0, 2), Neighbor(1.0, 5)}));
+}
+
+// A classifier with k = 0 searches with an empty buffer instead of writing before it.
+TEST(NeighborBuffer, ClassifierWithZeroK) {
+    KNNClassifier classifier(0);
+    classifier.train({{0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}}, {true, false, true});
+    EXPECT_TRUE(classifier.neighborIndex().search({1.0, 1.0}, 0).empty());
+}
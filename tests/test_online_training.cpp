@@ -0,0 +1,109 @@
+#include "test_support.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/OnlineTrainer.h"
+
+#include <stdexcept>
+
+using namespace testsupport;
+
+namespace {
+
+// Binary feature vectors and labels of synthetic emails.
+void binaryRows(size_t count, uint64_t seed, vector<vector<double>>& rows, vector<bool>& labels) {
+    vector<pair<pair<string, string>, bool>> emails = syntheticEmails(count, seed);
+    FeatureExtractor extractor;
+    rows = extractor.extractFeaturesBatch(emails, extractor.extractBalancedTopFeatures(syntheticEmails(300, 6), 50));
+    labels.clear();
+    for (const auto& email : emails) {
+        labels.push_back(email.second);
+    }
+}
+
+} // namespace
+
+// Rows appended one by one are searched exactly like rows trained in one go, and removed rows
+// are skipped while every other row keeps its index.
+TEST(OnlineTraining, AppendAndTombstones) {
+    vector<vector<double>> rows, queries;
+    vector<bool> labels, queryLabels;
+    binaryRows(300, 7, rows, labels);
+    binaryRows(40, 8, queries, queryLabels);
+
+    for (KNNClassifier::SearchMode mode : {KNNClassifier::Dense, KNNClassifier::Sparse}) {
+        KNNClassifier classifier(5);
+        classifier.setSearchMode(mode);
+        classifier.train(vector<vector<double>>(rows.begin(), rows.begin() + 150), vector<bool>(labels.begin(), labels.begin() + 150));
+        for (size_t i = 150; i < rows.size(); ++i) {
+            EXPECT_EQ(classifier.append(rows[i], labels[i]), static_cast<int>(i));
+        }
+        EXPECT_EQ(classifier.getTrainingLabels(), labels);
+
+        vector<bool> removed(rows.size(), false);
+        for (size_t i = 0; i < rows.size(); i += 4) {
+            classifier.remove(static_cast<int>(i));
+            removed[i] = true;
+        }
+        classifier.remove(0); // Removing twice changes nothing.
+        EXPECT_EQ(classifier.liveCount(), rows.size() - (rows.size() + 3) / 4);
+        EXPECT_THROW(classifier.remove(-1), out_of_range);
+        EXPECT_THROW(classifier.remove(static_cast<int>(rows.size())), out_of_range);
+
+        for (size_t q = 0; q < queries.size(); ++q) {
+            EXPECT_EQ(classifier.neighborIndex().search(queries[q], 5), bruteForceNeighbors(rows, queries[q], 5, removed)) << "query " << q;
+        }
+        // An exact copy of a removed row does not find it.
+        for (const Neighbor& neighbor : classifier.neighborIndex().search(rows[8], 5)) {
+            EXPECT_FALSE(removed[neighbor.second]);
+        }
+
+        // Appending after removals continues the numbering.
+        EXPECT_EQ(classifier.append(rows[8], labels[8]), static_cast<int>(rows.size()));
+        EXPECT_EQ(classifier.neighborIndex().search(rows[8], 1), (vector<Neighbor>{Neighbor(0.0, static_cast<int>(rows.size()))}));
+    }
+}
+
+// The trainer keeps email ids stable through removals and re-vectorizations, and its classifier
+// equals one trained from scratch on the live emails.
+TEST(OnlineTraining, TrainerIdsSurviveRevectorization) {
+    vector<pair<pair<string, string>, bool>> emails = syntheticEmails(260, 9);
+    OnlineTrainer::Policy policy;
+    policy.checkInterval = 0;
+    OnlineTrainer trainer(3, 30, policy);
+    trainer.train(vector<pair<pair<string, string>, bool>>(emails.begin(), emails.begin() + 200));
+    for (size_t i = 200; i < emails.size(); ++i) {
+        EXPECT_EQ(trainer.addEmail(emails[i].first.first, emails[i].first.second, emails[i].second), static_cast<int>(i));
+    }
+    for (int id : {0, 5, 201, 259}) {
+        trainer.removeEmail(id);
+        EXPECT_EQ(trainer.trainingIndex(id), -1);
+    }
+    EXPECT_THROW(trainer.removeEmail(5), out_of_range);
+    EXPECT_THROW(trainer.removeEmail(260), out_of_range);
+    EXPECT_EQ(trainer.liveCount(), emails.size() - 4);
+    EXPECT_EQ(trainer.classifier().liveCount(), emails.size() - 4);
+
+    size_t revectorizations = trainer.revectorizations();
+    EXPECT_TRUE(trainer.refresh(true));
+    EXPECT_EQ(trainer.revectorizations(), revectorizations + 1);
+    EXPECT_EQ(trainer.classifier().neighborIndex().size(), emails.size() - 4);
+
+    vector<vector<double>> rows;
+    vector<bool> labels;
+    for (int id = 0; id < static_cast<int>(emails.size()); ++id) {
+        int row = trainer.trainingIndex(id);
+        if (row < 0) {
+            continue;
+        }
+        EXPECT_EQ(row, static_cast<int>(rows.size()));
+        EXPECT_EQ(trainer.emailId(row), id);
+        rows.push_back(trainer.vectorize(emails[id].first.first, emails[id].first.second));
+        labels.push_back(emails[id].second);
+    }
+    KNNClassifier fresh(3);
+    fresh.train(rows, labels);
+    vector<vector<double>> queries;
+    for (const auto& email : syntheticEmails(30, 10)) {
+        queries.push_back(trainer.vectorize(email.first.first, email.first.second));
+    }
+    expectSamePredictions(fresh.predictBatch(queries), trainer.classifier().predictBatch(queries));
+}
@@ -0,0 +1,120 @@
+#include "test_support.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/CorpusStore.h"
+#include "../code_1/FeatureHasher.h"
+
+using namespace testsupport;
+
+// Feature selection and extraction on a pool give the serial results bit for bit.
+TEST(Parallel, FeatureExtractionMatchesSerial) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(600, 1);
+    vector<pair<string, string>> emails;
+    CorpusStore corpus;
+    for (const auto& email : training) {
+        emails.push_back(email.first);
+        corpus.add(email.first.first, email.first.second, email.second);
+    }
+    FeatureExtractor extractor;
+    ThreadPool pool(4);
+
+    for (int N : {10, 100}) {
+        vector<string> topFeatures = extractor.extractBalancedTopFeatures(training, N);
+        EXPECT_EQ(extractor.extractBalancedTopFeatures(training, N, &pool), topFeatures);
+        EXPECT_EQ(extractor.extractBalancedTopFeatures(corpus, N), topFeatures);
+        EXPECT_EQ(extractor.extractBalancedTopFeatures(corpus, N, &pool), topFeatures);
+
+        vector<vector<double>> features = extractor.extractFeaturesBatch(training, topFeatures);
+        ASSERT_EQ(features.size(), training.size());
+        for (size_t i = 0; i < training.size(); i += 50) {
+            EXPECT_EQ(features[i], extractor.extractFeatures(training[i].first.first, training[i].first.second, topFeatures));
+        }
+        EXPECT_EQ(extractor.extractFeaturesBatch(training, topFeatures, &pool), features);
+        EXPECT_EQ(extractor.extractFeaturesBatch(emails, topFeatures, &pool), features);
+        EXPECT_EQ(extractor.extractFeaturesBatch(corpus, topFeatures), features);
+        EXPECT_EQ(extractor.extractFeaturesBatch(corpus, topFeatures, &pool), features);
+    }
+}
+
+// predictBatch on a pool equals the serial batch, and both agree with predict, for every
+// exact backend and vote.
+TEST(Parallel, PredictBatchMatchesSerial) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(500, 2);
+    vector<pair<pair<string, string>, bool>> test = syntheticEmails(150, 3);
+    FeatureExtractor extractor;
+    vector<string> topFeatures = extractor.extractBalancedTopFeatures(training, 40);
+    vector<vector<double>> features = extractor.extractFeaturesBatch(training, topFeatures);
+    vector<vector<double>> queries = extractor.extractFeaturesBatch(test, topFeatures);
+    vector<bool> labels;
+    for (const auto& email : training) {
+        labels.push_back(email.second);
+    }
+    // Weighted copies exercise the dense (non-packed) scan.
+    vector<vector<double>> weighted = features;
+    for (size_t i = 0; i < weighted.size(); ++i) {
+        for (size_t j = 0; j < weighted[i].size(); ++j) {
+            weighted[i][j] *= static_cast<double>(1 + (i + j) % 3);
+        }
+    }
+    ThreadPool pool(4);
+
+    struct Case {
+        KNNClassifier::SearchMode mode;
+        const vector<vector<double>>* rows;
+    };
+    for (const Case& c : {Case{KNNClassifier::Dense, &features}, Case{KNNClassifier::Sparse, &features}, Case{KNNClassifier::Dense, &weighted}}) {
+        for (KNNClassifier::Voting voting : {KNNClassifier::Majority, KNNClassifier::DistanceWeighted}) {
+            for (int k : {1, 4, 7}) {
+                KNNClassifier classifier(k);
+                classifier.setSearchMode(c.mode);
+                classifier.setVoting(voting);
+                classifier.train(*c.rows, labels);
+
+                vector<Prediction> serial = classifier.predictBatch(queries);
+                expectSamePredictions(serial, classifier.predictBatch(queries, &pool));
+                for (size_t q = 0; q < queries.size(); ++q) {
+                    EXPECT_EQ(classifier.predict(queries[q]), serial[q].isSpam) << "query " << q;
+                }
+            }
+        }
+    }
+}
+
+// Hashed bucket pruning and extraction on a pool give the serial results, for both batch
+// overloads.
+TEST(Parallel, HashedPruningMatchesSerial) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(500, 3);
+    vector<pair<string, string>> emails;
+    for (const auto& email : training) {
+        emails.push_back(email.first);
+    }
+    ThreadPool pool(4);
+    for (int bits : {6, 16}) {
+        FeatureHasher serial(bits);
+        serial.pruneBalanced(training, 40);
+        FeatureHasher pooled(bits);
+        pooled.pruneBalanced(training, 40, &pool);
+        EXPECT_EQ(pooled.dimensions(), serial.dimensions()) << "bits " << bits;
+
+        vector<vector<double>> features = serial.extractBatch(training);
+        ASSERT_EQ(features.size(), training.size());
+        for (size_t i = 0; i < training.size(); i += 50) {
+            EXPECT_EQ(features[i], serial.extract(training[i].first.first, training[i].first.second));
+        }
+        EXPECT_EQ(pooled.extractBatch(training, &pool), features) << "bits " << bits;
+        EXPECT_EQ(pooled.extractBatch(emails, &pool), features) << "bits " << bits;
+    }
+}
+
+// parallelFor visits every index exactly once, whatever the grain size.
+TEST(Parallel, ParallelForCoversEveryIndex) {
+    ThreadPool pool(4);
+    for (size_t grain : {1u, 7u, 1000u}) {
+        vector<int> visits(2500, 0);
+        pool.parallelFor(visits.size(), grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                ++visits[i];
+            }
+        });
+        EXPECT_EQ(count(visits.begin(), visits.end(), 1), static_cast<long>(visits.size())) << "grain " << grain;
+    }
+}
@@ -0,0 +1,55 @@
+#include "test_support.h"
+
+using namespace testsupport;
+
+namespace {
+
+// Weighted rows with values in [0, 1).
+vector<vector<double>> weightedRows(size_t count, size_t featureCount, unsigned seed) {
+    vector<vector<double>> rows(count, vector<double>(featureCount));
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < featureCount; ++j) {
+            seed = seed * 1103515245u + 12345u;
+            rows[i][j] = ((seed >> 8) % 1000) / 1000.0;
+        }
+    }
+    return rows;
+}
+
+} // namespace
+
+// The default quantized index keeps no full-precision copy, so it is smaller than the double
+// rows; only an opt-in rerank keeps them.
+TEST(QuantizedIndex, DefaultIsSmallerThanDoubleRows) {
+    vector<vector<double>> rows = weightedRows(200, 96, 1);
+    ExactIndex exact;
+    exact.build(rows);
+    for (QuantizedIndex::Precision precision : {QuantizedIndex::Int8, QuantizedIndex::Float16}) {
+        QuantizedIndex::Parameters parameters;
+        EXPECT_EQ(parameters.rerankFactor, 0u);
+        parameters.precision = precision;
+        QuantizedIndex quantized(parameters);
+        quantized.build(rows);
+        EXPECT_LT(quantized.memoryBytes(), exact.memoryBytes());
+        EXPECT_EQ(quantized.memoryBytes(), quantized.scannedBytes());
+
+        QuantizedIndex reranking(QuantizedIndex::Parameters(precision, 4));
+        reranking.build(rows);
+        EXPECT_GT(reranking.memoryBytes(), exact.memoryBytes());
+    }
+}
+
+// A rerank that covers every row reports the exact neighbors and distances.
+TEST(QuantizedIndex, FullRerankIsExact) {
+    vector<vector<double>> rows = weightedRows(120, 40, 2);
+    vector<vector<double>> queries = weightedRows(20, 40, 3);
+    ExactIndex exact;
+    exact.build(rows);
+    for (QuantizedIndex::Precision precision : {QuantizedIndex::Int8, QuantizedIndex::Float16}) {
+        QuantizedIndex quantized(QuantizedIndex::Parameters(precision, rows.size()));
+        quantized.build(rows);
+        for (size_t q = 0; q < queries.size(); ++q) {
+            EXPECT_EQ(quantized.search(queries[q], 1), exact.search(queries[q], 1)) << "query " << q;
+        }
+    }
+}
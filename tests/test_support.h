@@ -0,0 +1,60 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <gtest/gtest.h>
+#include "../code_1/KNNClassifier.h"
+#include "../code_1/SyntheticCorpus.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Helpers shared by the test files.
+namespace testsupport {
+
+// Labeled synthetic emails over a small vocabulary, so top features repeat across emails.
+inline vector<pair<pair<string, string>, bool>> syntheticEmails(size_t count, uint64_t seed) {
+    SyntheticCorpus::Options options;
+    options.seed = seed;
+    options.vocabularySize = 2000;
+    options.messageMedianWords = 20.0;
+    return SyntheticCorpus(options).generate(count);
+}
+
+// The k nearest rows by a plain loop over every row: squared distance, ties by lower index.
+// Rows listed in removed are skipped.
+inline vector<Neighbor> bruteForceNeighbors(const vector<vector<double>>& rows, const vector<double>& query, size_t k, const vector<bool>& removed = vector<bool>()) {
+    vector<Neighbor> all;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (i < removed.size() && removed[i]) {
+            continue;
+        }
+        double distance = 0.0;
+        for (size_t j = 0; j < query.size(); ++j) {
+            distance += (query[j] - rows[i][j]) * (query[j] - rows[i][j]);
+        }
+        all.push_back(Neighbor(distance, static_cast<int>(i)));
+    }
+    sort(all.begin(), all.end());
+    all.resize(min(k, all.size()));
+    return all;
+}
+
+// Expects two prediction lists to be identical, field by field.
+inline void expectSamePredictions(const vector<Prediction>& expected, const vector<Prediction>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].isSpam, actual[i].isSpam) << "query " << i;
+        EXPECT_EQ(expected[i].neighborIndices, actual[i].neighborIndices) << "query " << i;
+        EXPECT_EQ(expected[i].neighborDistances, actual[i].neighborDistances) << "query " << i;
+        EXPECT_EQ(expected[i].spamVotes, actual[i].spamVotes) << "query " << i;
+        EXPECT_EQ(expected[i].confidence, actual[i].confidence) << "query " << i;
+    }
+}
+
+} // namespace testsupport
+
+#endif // TEST_SUPPORT_H
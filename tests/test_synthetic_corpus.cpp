@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "../code_1/SyntheticCorpus.h"
+#include "../code_1/CsvParser.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A small corpus with the given seed in which half of the emails are punctuated and half span
+// several lines, so many records need quoting.
+SyntheticCorpus::Options quotingOptions(uint64_t seed) {
+    SyntheticCorpus::Options options;
+    options.seed = seed;
+    options.vocabularySize = 1000;
+    options.messageMedianWords = 15;
+    options.punctuatedFraction = 0.5;
+    options.multilineFraction = 0.5;
+    return options;
+}
+
+} // namespace
+
+// The same options give the same emails, whether generated at once or in pieces, and the
+// sequence does not depend on the standard library: the first emails of seed 42 are pinned.
+TEST(SyntheticCorpus, SameSeedSameSequence) {
+    SyntheticCorpus::Options options;
+    options.seed = 42;
+    options.vocabularySize = 1000;
+    vector<pair<pair<string, string>, bool>> whole = SyntheticCorpus(options).generate(300);
+
+    SyntheticCorpus pieces(options);
+    vector<pair<pair<string, string>, bool>> joined = pieces.generate(120);
+    vector<pair<pair<string, string>, bool>> rest = pieces.generate(180);
+    joined.insert(joined.end(), rest.begin(), rest.end());
+    EXPECT_EQ(joined, whole);
+    EXPECT_EQ(SyntheticCorpus(options).generate(300), whole);
+
+    EXPECT_EQ(whole[0].first.first, "cebe babe dica");
+    EXPECT_FALSE(whole[0].second);
+    EXPECT_EQ(whole[1].first.first, "nebe pabe nabe lubu nobi");
+    EXPECT_TRUE(whole[1].second);
+}
+
+// Different seeds give different emails.
+TEST(SyntheticCorpus, DifferentSeedsDiffer) {
+    vector<pair<pair<string, string>, bool>> first = SyntheticCorpus(quotingOptions(1)).generate(50);
+    vector<pair<pair<string, string>, bool>> second = SyntheticCorpus(quotingOptions(2)).generate(50);
+    size_t same = 0;
+    for (size_t i = 0; i < first.size(); ++i) {
+        same += first[i].first == second[i].first;
+    }
+    EXPECT_EQ(same, 0u);
+}
+
+// A corpus written with header and writeRecord parses back into the same subjects and
+// messages, including quoted, comma-holding and multiline ones, in chunks of any size.
+TEST(SyntheticCorpus, RecordsRoundTripThroughCsvParser) {
+    SyntheticCorpus corpus(quotingOptions(3));
+    vector<SyntheticCorpus::Email> emails(200);
+    ostringstream csv;
+    csv << SyntheticCorpus::header() << "\n";
+    size_t multiline = 0, punctuated = 0;
+    for (auto& email : emails) {
+        corpus.next(email);
+        SyntheticCorpus::writeRecord(csv, email);
+        multiline += email.message.find('\n') != string::npos;
+        punctuated += email.message.find_first_of(",\"") != string::npos;
+    }
+    EXPECT_GT(multiline, 0u);
+    EXPECT_GT(punctuated, 0u);
+
+    string text = csv.str();
+    for (size_t chunk : {size_t(7), text.size()}) {
+        vector<vector<string>> records;
+        auto collect = [&](const vector<string_view>& fields) {
+            records.emplace_back(fields.begin(), fields.end());
+        };
+        CsvParser parser;
+        for (size_t offset = 0; offset < text.size(); offset += chunk) {
+            parser.feed(string_view(text).substr(offset, chunk), collect);
+        }
+        parser.finish(collect);
+
+        ASSERT_EQ(records.size(), emails.size() + 1) << "chunk " << chunk;
+        EXPECT_EQ(records[0], (vector<string>{"subject", "message"}));
+        for (size_t i = 0; i < emails.size(); ++i) {
+            EXPECT_EQ(records[i + 1], (vector<string>{emails[i].subject, emails[i].message})) << "email " << i << ", chunk " << chunk;
+        }
+    }
+}
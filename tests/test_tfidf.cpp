@@ -0,0 +1,113 @@
+#include "test_support.h"
+#include "../code_1/TfidfVectorizer.h"
+#include "../code_1/SparseCosineIndex.h"
+
+#include <cmath>
+#include <map>
+
+using namespace testsupport;
+
+namespace {
+
+// Asserts that two lists of sparse vectors are identical, weights bit for bit.
+void expectSameVectors(const vector<SparseVector>& expected, const vector<SparseVector>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].indices, actual[i].indices) << "email " << i;
+        EXPECT_EQ(expected[i].values, actual[i].values) << "email " << i;
+    }
+}
+
+// The k nearest rows by SparseVector::dot over every row: 2 - 2 cos, ties by lower index.
+vector<Neighbor> bruteForceCosine(const vector<SparseVector>& rows, const SparseVector& query, size_t k) {
+    vector<Neighbor> all;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        all.push_back(Neighbor(max(0.0, 2.0 - 2.0 * query.dot(rows[i])), static_cast<int>(i)));
+    }
+    sort(all.begin(), all.end());
+    all.resize(min(k, all.size()));
+    return all;
+}
+
+} // namespace
+
+// fit on a pool keeps the same features with the same weights as the serial fit.
+TEST(Tfidf, PooledFitMatchesSerial) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(400, 31);
+    ThreadPool pool(4);
+    TfidfVectorizer serial;
+    serial.fit(training);
+    TfidfVectorizer pooled;
+    pooled.fit(training, &pool);
+    EXPECT_EQ(pooled.keptFeatures(), serial.keptFeatures());
+
+    vector<SparseVector> vectors = serial.transformBatch(training);
+    expectSameVectors(vectors, pooled.transformBatch(training, &pool));
+    for (size_t i = 0; i < training.size(); i += 40) {
+        SparseVector single = serial.transform(training[i].first.first, training[i].first.second);
+        EXPECT_EQ(single.indices, vectors[i].indices);
+        EXPECT_EQ(single.values, vectors[i].values);
+    }
+}
+
+// Every non-empty vector has unit length, and only features in at least minDocumentFrequency
+// training emails are kept: counted independently from the vectors of an unpruned fit.
+TEST(Tfidf, UnitNormAndDocumentFrequencyPruning) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(300, 32);
+    TfidfVectorizer::Options options;
+    options.bits = 16;
+    options.minDocumentFrequency = 1;
+    TfidfVectorizer everything(options);
+    everything.fit(training);
+    map<uint32_t, int> documentFrequency;
+    for (const SparseVector& vector : everything.transformBatch(training)) {
+        for (uint32_t id : vector.indices) {
+            ++documentFrequency[id];
+        }
+    }
+    EXPECT_EQ(everything.keptFeatures(), documentFrequency.size());
+
+    options.minDocumentFrequency = 3;
+    TfidfVectorizer pruned(options);
+    pruned.fit(training);
+    size_t frequent = count_if(documentFrequency.begin(), documentFrequency.end(), [](const pair<const uint32_t, int>& id) { return id.second >= 3; });
+    EXPECT_EQ(pruned.keptFeatures(), frequent);
+    for (const SparseVector& vector : pruned.transformBatch(training)) {
+        for (uint32_t id : vector.indices) {
+            EXPECT_GE(documentFrequency[id], 3) << "feature " << id;
+        }
+        if (vector.size() > 0) {
+            EXPECT_NEAR(vector.norm(), 1.0, 1e-6);
+        }
+    }
+    EXPECT_EQ(pruned.transform("", "").size(), 0u);
+}
+
+// The index returns exactly the brute-force neighbors by SparseVector::dot, distances bit for
+// bit, with emails sharing no feature at distance 2 in index order.
+TEST(SparseCosineIndex, SearchMatchesBruteForce) {
+    vector<pair<pair<string, string>, bool>> training = syntheticEmails(300, 33);
+    vector<pair<pair<string, string>, bool>> test = syntheticEmails(40, 34);
+    TfidfVectorizer::Options options;
+    options.bits = 12;
+    TfidfVectorizer vectorizer(options);
+    vectorizer.fit(training);
+    vector<SparseVector> rows = vectorizer.transformBatch(training);
+    vector<SparseVector> queries = vectorizer.transformBatch(test);
+    queries.push_back(rows[5]);
+    queries.push_back(SparseVector());
+
+    SparseCosineIndex index;
+    index.build(rows);
+    ThreadPool pool(3);
+    for (size_t k : {1u, 5u, 30u}) {
+        vector<vector<Neighbor>> batch = index.searchBatch(queries, k, &pool);
+        for (size_t q = 0; q < queries.size(); ++q) {
+            vector<Neighbor> expected = bruteForceCosine(rows, queries[q], k);
+            EXPECT_EQ(index.search(queries[q], k), expected) << "k " << k << ", query " << q;
+            EXPECT_EQ(batch[q], expected) << "k " << k << ", query " << q;
+        }
+    }
+    vector<Neighbor> unrelated = index.search(SparseVector(), 3);
+    EXPECT_EQ(unrelated, (vector<Neighbor>{Neighbor(2.0, 0), Neighbor(2.0, 1), Neighbor(2.0, 2)}));
+}
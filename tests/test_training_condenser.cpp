@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "../code_1/TrainingCondenser.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// One-feature rows at the given positions, so squared distances are easy to work out by hand.
+vector<vector<double>> positions(const vector<double>& xs) {
+    vector<vector<double>> rows;
+    for (double x : xs) {
+        rows.push_back({x});
+    }
+    return rows;
+}
+
+} // namespace
+
+// Duplicates with the same label collapse into the first one, weighted by their count; the
+// same vector with the other label stays a prototype of its own.
+TEST(TrainingCondenser, DeduplicationWeights) {
+    vector<vector<double>> rows = positions({0, 1, 0, 0, 1, 0, 1});
+    vector<bool> labels = {true, false, true, false, false, true, false};
+    TrainingCondenser::Result result = TrainingCondenser().reduce(rows, labels);
+
+    EXPECT_EQ(result.features, positions({0, 1, 0}));
+    EXPECT_EQ(result.labels, (vector<bool>{true, false, false}));
+    EXPECT_EQ(result.weights, (vector<int>{3, 3, 1}));
+    EXPECT_EQ(result.sourceRows, (vector<size_t>{0, 1, 3}));
+    EXPECT_EQ(result.inputRows, 7u);
+    EXPECT_EQ(result.uniqueRows, 3u);
+    EXPECT_DOUBLE_EQ(result.compressionRatio(), 7.0 / 3.0);
+}
+
+// Editing with editK = 2 drops a prototype outvoted 2 to 0 and keeps one whose vote is tied;
+// a duplicate votes for its own prototype.
+TEST(TrainingCondenser, EditingKeepsTies) {
+    TrainingCondenser::Options options;
+    options.edit = true;
+    options.editK = 2;
+    TrainingCondenser condenser(options);
+
+    // 0 (spam) has only ham neighbors; 1 (ham) is voted spam by 0 and ham by 3, a tie.
+    vector<vector<double>> rows = positions({0, 1, 3, 10, 11});
+    vector<bool> labels = {true, false, false, true, true};
+    TrainingCondenser::Result result = condenser.reduce(rows, labels);
+    EXPECT_EQ(result.features, positions({1, 3, 10, 11}));
+    EXPECT_EQ(result.sourceRows, (vector<size_t>{1, 2, 3, 4}));
+    EXPECT_EQ(result.editedRows, 4u);
+
+    // With a duplicate, 0 gets one vote from it and one from 1: a tie, so it stays. Now 1 is
+    // the one outvoted, by the two rows at 0.
+    rows = positions({0, 0, 1, 3, 10, 11});
+    labels = {true, true, false, false, true, true};
+    result = condenser.reduce(rows, labels);
+    EXPECT_EQ(result.features, positions({0, 3, 10, 11}));
+    EXPECT_EQ(result.weights, (vector<int>{2, 1, 1, 1}));
+}
+
+// Condensing keeps the first prototype and every one the kept set misclassifies; each dropped
+// prototype's weight moves to its nearest kept prototype, so no input row is lost.
+TEST(TrainingCondenser, CondensingTransfersWeights) {
+    TrainingCondenser::Options options;
+    options.condense = true;
+    vector<vector<double>> rows = positions({0, 1, 10, 11, 2, 2});
+    vector<bool> labels = {true, true, false, false, true, true};
+    TrainingCondenser::Result result = TrainingCondenser(options).reduce(rows, labels);
+
+    EXPECT_EQ(result.features, positions({0, 10}));
+    EXPECT_EQ(result.labels, (vector<bool>{true, false}));
+    EXPECT_EQ(result.weights, (vector<int>{4, 2}));
+    EXPECT_EQ(result.sourceRows, (vector<size_t>{0, 2}));
+    EXPECT_EQ(result.uniqueRows, 5u);
+    EXPECT_EQ(result.condensedRows, 2u);
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+#include "../code_1/KNNClassifier.h"
+
+#include <vector>
+
+using namespace std;
+
+// A majority tie at even k is ham, whichever label the nearest neighbor has.
+TEST(Voting, MajorityTieIsHam) {
+    KNNClassifier classifier(2);
+    classifier.train({{0.0, 0.0}, {1.0, 1.0}}, {true, false});
+    Prediction spamNearest = classifier.predictBatch({{0.0, 0.0}})[0];
+    EXPECT_EQ(spamNearest.spamVotes, 1);
+    EXPECT_FALSE(spamNearest.isSpam);
+    EXPECT_DOUBLE_EQ(spamNearest.confidence, 0.5);
+    EXPECT_FALSE(classifier.predictBatch({{1.0, 1.0}})[0].isSpam);
+}
+
+// An exact weighted tie (both neighbors equally far) goes to the nearest one, the lower index.
+TEST(Voting, WeightedTieGoesToNearestNeighbor) {
+    KNNClassifier classifier(2);
+    classifier.setVoting(KNNClassifier::DistanceWeighted);
+    classifier.train({{0.0, 1.0}, {1.0, 0.0}}, {true, false});
+    EXPECT_TRUE(classifier.predictBatch({{0.0, 0.0}})[0].isSpam);
+
+    classifier.train({{0.0, 1.0}, {1.0, 0.0}}, {false, true});
+    EXPECT_FALSE(classifier.predictBatch({{0.0, 0.0}})[0].isSpam);
+
+    // Without a tie the nearer, heavier vote wins.
+    EXPECT_TRUE(classifier.predictBatch({{0.9, 0.0}})[0].isSpam);
+}
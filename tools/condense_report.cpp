@@ -0,0 +1,108 @@
+#include "../code_1/KNNClassifier.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/EmailReader.h"
+#include "../code_1/TrainingCondenser.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+// Measures what training-set reduction costs in accuracy and buys in scan time.
+// Usage: run_condense_report [k] [N] [holdout] [spam.csv] [ham.csv]
+// Every holdout-th training email (default 5, so 20%) is held out; features are selected and
+// the set is reduced on the rest only. Each reduction is compared with the full training set
+// on the held-out emails.
+int main(int argc, char* argv[]) {
+    int k = argc > 1 ? atoi(argv[1]) : 5;
+    int N = argc > 2 ? atoi(argv[2]) : 150;
+    int holdout = argc > 3 ? atoi(argv[3]) : 5;
+    string spamFilePath = argc > 4 ? argv[4] : "../training/spam.csv";
+    string hamFilePath = argc > 5 ? argv[5] : "../training/ham.csv";
+
+    if (k <= 0 || N <= 0 || holdout < 2) {
+        cerr << "k and N must be positive numbers and holdout at least 2." << endl;
+        return 1;
+    }
+
+    EmailReader reader(spamFilePath, hamFilePath, "");
+    reader.readTrainingEmails();
+    vector<pair<pair<string, string>, bool>> trainingData;
+    vector<pair<pair<string, string>, bool>> heldOutData;
+    const vector<pair<pair<string, string>, bool>>& allData = reader.getTrainingData();
+    for (size_t i = 0; i < allData.size(); ++i) {
+        (i % holdout == static_cast<size_t>(holdout) - 1 ? heldOutData : trainingData).push_back(allData[i]);
+    }
+
+    FeatureExtractor featureExtractor;
+    ThreadPool pool;
+    vector<string> topFeatures = featureExtractor.extractBalancedTopFeatures(trainingData, N, &pool);
+    vector<vector<double>> features = featureExtractor.extractFeaturesBatch(trainingData, topFeatures, &pool);
+    vector<vector<double>> queries = featureExtractor.extractFeaturesBatch(heldOutData, topFeatures, &pool);
+    vector<bool> labels;
+    for (const auto& data : trainingData) {
+        labels.push_back(data.second);
+    }
+
+    cout << "Training emails: " << features.size() << ", held out: " << queries.size() << ", k = " << k << ", N = " << N << endl << endl;
+    cout << left << setw(16) << "training set" << setw(8) << "rows" << setw(8) << "ratio" << setw(10) << "accuracy"
+         << setw(9) << "delta" << setw(12) << "train ms" << setw(10) << "us/query" << "bytes" << endl;
+
+    struct Variant {
+        const char* name;
+        bool reduce;
+        bool edit;
+        bool condense;
+    };
+    const Variant variants[] = {
+        { "full", false, false, false },
+        { "dedupe", true, false, false },
+        { "dedupe+ENN", true, true, false },
+        { "dedupe+CNN", true, false, true },
+        { "dedupe+ENN+CNN", true, true, true },
+    };
+
+    double fullAccuracy = 0.0;
+    for (const Variant& variant : variants) {
+        KNNClassifier classifier(k);
+        size_t rows = features.size();
+        double ratio = 1.0;
+        auto start = chrono::steady_clock::now();
+        if (variant.reduce) {
+            TrainingCondenser::Options options;
+            options.edit = variant.edit;
+            options.condense = variant.condense;
+            TrainingCondenser::Result reduced = TrainingCondenser(options, &pool).reduce(features, labels);
+            classifier.train(reduced.features, reduced.labels, reduced.weights);
+            rows = reduced.features.size();
+            ratio = reduced.compressionRatio();
+        } else {
+            classifier.train(features, labels);
+        }
+        double trainMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        // One query at a time, as the interactive menu and the server's small batches do.
+        start = chrono::steady_clock::now();
+        int correct = 0;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            correct += classifier.predict(queries[q]) == heldOutData[q].second;
+        }
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / max<size_t>(1, queries.size());
+        double accuracy = queries.empty() ? 1.0 : static_cast<double>(correct) / queries.size();
+        if (!variant.reduce) {
+            fullAccuracy = accuracy;
+        }
+
+        cout << left << setw(16) << variant.name << setw(8) << rows << fixed
+             << setw(8) << setprecision(2) << ratio
+             << setw(10) << setprecision(4) << accuracy
+             << setw(9) << showpos << setprecision(4) << accuracy - fullAccuracy << noshowpos
+             << setw(12) << setprecision(2) << trainMillis
+             << setw(10) << setprecision(2) << micros
+             << classifier.neighborIndex().memoryBytes() << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "../code_1/SyntheticCorpus.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace std;
+
+// Writes a synthetic "subject,message" corpus for scale testing.
+// Usage: run_generate_corpus [options] MESSAGES.csv
+//        run_generate_corpus [options] SPAM.csv HAM.csv
+// With one file every email goes into it, like tests/messages.csv; with two, spam and ham go
+// into separate training files, like training/spam.csv and training/ham.csv. Both start with
+// the "subject,message" header. The same options (including --seed) always give the same files.
+// Options (defaults in brackets):
+//   --emails N [1000]          --seed S [1]               --spam-ratio R [0.5]
+//   --vocabulary V [50000]     --zipf S [1.0]             --topic-shift T [50]
+//   --subject-min W [3]        --subject-max W [8]
+//   --median-words W [50]      --sigma S [0.6]            (log-normal message length)
+//   --punctuated F [0.1]       --multiline F [0.05]       (fractions of quoted emails)
+int main(int argc, char* argv[]) {
+    SyntheticCorpus::Options options;
+    size_t emails = 1000;
+    vector<string> outputs;
+
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (flag.compare(0, 2, "--") != 0) {
+            outputs.push_back(flag);
+        } else if (!hasValue) {
+            cerr << "Missing value for option: " << flag << endl;
+            return 1;
+        } else if (flag == "--emails") {
+            emails = static_cast<size_t>(strtod(argv[++i], nullptr));
+        } else if (flag == "--seed") {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (flag == "--spam-ratio") {
+            options.spamRatio = atof(argv[++i]);
+        } else if (flag == "--vocabulary") {
+            options.vocabularySize = static_cast<size_t>(strtod(argv[++i], nullptr));
+        } else if (flag == "--zipf") {
+            options.zipfExponent = atof(argv[++i]);
+        } else if (flag == "--topic-shift") {
+            options.topicShift = static_cast<size_t>(strtod(argv[++i], nullptr));
+        } else if (flag == "--subject-min") {
+            options.subjectMinWords = static_cast<size_t>(atoi(argv[++i]));
+        } else if (flag == "--subject-max") {
+            options.subjectMaxWords = static_cast<size_t>(atoi(argv[++i]));
+        } else if (flag == "--median-words") {
+            options.messageMedianWords = atof(argv[++i]);
+        } else if (flag == "--sigma") {
+            options.messageWordsSigma = atof(argv[++i]);
+        } else if (flag == "--punctuated") {
+            options.punctuatedFraction = atof(argv[++i]);
+        } else if (flag == "--multiline") {
+            options.multilineFraction = atof(argv[++i]);
+        } else {
+            cerr << "Unknown option: " << flag << endl;
+            return 1;
+        }
+    }
+    if (outputs.empty() || outputs.size() > 2) {
+        cerr << "Usage: run_generate_corpus [options] MESSAGES.csv | SPAM.csv HAM.csv" << endl;
+        return 1;
+    }
+
+    try {
+        SyntheticCorpus corpus(options);
+        ofstream first(outputs[0], ios::binary);
+        ofstream second;
+        if (outputs.size() == 2) {
+            second.open(outputs[1], ios::binary);
+        }
+        if (!first.is_open() || (outputs.size() == 2 && !second.is_open())) {
+            throw runtime_error("Failed to open output file.");
+        }
+        first << SyntheticCorpus::header() << '\n';
+        if (outputs.size() == 2) {
+            second << SyntheticCorpus::header() << '\n';
+        }
+
+        SyntheticCorpus::Email email;
+        size_t spam = 0;
+        for (size_t i = 0; i < emails; ++i) {
+            corpus.next(email);
+            spam += email.isSpam ? 1 : 0;
+            SyntheticCorpus::writeRecord(outputs.size() == 2 && !email.isSpam ? second : first, email);
+        }
+        first.close();
+        if (outputs.size() == 2) {
+            second.close();
+        }
+        if (first.fail() || second.fail()) {
+            throw runtime_error("Failed to write output file.");
+        }
+        cerr << "Wrote " << emails << " emails (" << spam << " spam, " << emails - spam << " ham)" << endl;
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "../code_1/KNNClassifier.h"
+#include "../code_1/EmailReader.h"
+#include "../code_1/TfidfVectorizer.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+// Measures what quantized storage of weighted features saves in memory and costs in accuracy.
+// Usage: run_quantization_report [k] [bits] [holdout] [spam.csv] [ham.csv]
+// The emails are vectorized as dense TF-IDF vectors over 2^bits hashed features (default 10,
+// so 1024 doubles per email), fitted on the training part only. Every holdout-th email
+// (default 5) is held out and classified with the double scan and with each quantized
+// backend. The memory column divides the double index's bytes by each index's memoryBytes()
+// (everything it holds, including a rerank copy); the scan column divides them by the bytes a
+// query reads. Recall@k counts a neighbor as a hit if it is no farther than the double path's
+// k-th neighbor; label agree compares the verdicts with the double path's.
+int main(int argc, char* argv[]) {
+    int k = argc > 1 ? atoi(argv[1]) : 5;
+    int bits = argc > 2 ? atoi(argv[2]) : 10;
+    int holdout = argc > 3 ? atoi(argv[3]) : 5;
+    string spamFilePath = argc > 4 ? argv[4] : "../training/spam.csv";
+    string hamFilePath = argc > 5 ? argv[5] : "../training/ham.csv";
+
+    if (k <= 0 || bits < 8 || bits > 16 || holdout < 2) {
+        cerr << "k must be positive, bits between 8 and 16 and holdout at least 2." << endl;
+        return 1;
+    }
+
+    EmailReader reader(spamFilePath, hamFilePath, "");
+    reader.readTrainingEmails();
+    vector<pair<pair<string, string>, bool>> trainingData;
+    vector<pair<pair<string, string>, bool>> heldOutData;
+    const vector<pair<pair<string, string>, bool>>& allData = reader.getTrainingData();
+    for (size_t i = 0; i < allData.size(); ++i) {
+        (i % holdout == static_cast<size_t>(holdout) - 1 ? heldOutData : trainingData).push_back(allData[i]);
+    }
+
+    // Dense TF-IDF vectors: unit length, so every feature is a small fraction.
+    ThreadPool pool;
+    TfidfVectorizer::Options options;
+    options.bits = bits;
+    TfidfVectorizer vectorizer(options);
+    vectorizer.fit(trainingData, &pool);
+    auto densify = [&](const vector<SparseVector>& rows) {
+        vector<vector<double>> dense(rows.size(), vector<double>(vectorizer.dimensions(), 0.0));
+        for (size_t i = 0; i < rows.size(); ++i) {
+            for (size_t j = 0; j < rows[i].size(); ++j) {
+                dense[i][rows[i].indices[j]] = rows[i].values[j];
+            }
+        }
+        return dense;
+    };
+    vector<vector<double>> features = densify(vectorizer.transformBatch(trainingData, &pool));
+    vector<vector<double>> queries = densify(vectorizer.transformBatch(heldOutData, &pool));
+    vector<bool> labels;
+    for (const auto& data : trainingData) {
+        labels.push_back(data.second);
+    }
+
+    cout << "Training emails: " << features.size() << ", held out: " << queries.size() << ", k = " << k
+         << ", features: " << vectorizer.dimensions() << " (TF-IDF), kernels: " << DistanceKernels::isaName(DistanceKernels::activeIsa()) << endl << endl;
+    cout << left << setw(30) << "storage" << setw(12) << "bytes" << setw(9) << "memory" << setw(12) << "scanned" << setw(9) << "scan"
+         << setw(10) << "recall@k" << setw(13) << "label agree" << setw(10) << "accuracy" << setw(9) << "delta" << "us/query" << endl;
+
+    struct Variant {
+        bool quantized;
+        QuantizedIndex::Parameters parameters;
+    };
+    const Variant variants[] = {
+        { false, QuantizedIndex::Parameters() },
+        { true, QuantizedIndex::Parameters(QuantizedIndex::Float16, 0) },
+        { true, QuantizedIndex::Parameters(QuantizedIndex::Float16, 4) },
+        { true, QuantizedIndex::Parameters(QuantizedIndex::Int8, 0) },
+        { true, QuantizedIndex::Parameters(QuantizedIndex::Int8, 2) },
+        { true, QuantizedIndex::Parameters(QuantizedIndex::Int8, 4) },
+    };
+
+    vector<Prediction> reference;
+    double referenceAccuracy = 0.0;
+    size_t referenceBytes = 0;
+    for (const Variant& variant : variants) {
+        KNNClassifier classifier(k);
+        if (variant.quantized) {
+            classifier.setSearchMode(KNNClassifier::Quantized);
+            classifier.setQuantizationParameters(variant.parameters);
+        }
+        classifier.train(features, labels);
+
+        // One query at a time, as the interactive menu and the server's small batches do.
+        auto start = chrono::steady_clock::now();
+        vector<Prediction> predictions;
+        for (const auto& query : queries) {
+            predictions.push_back(classifier.predictBatch(vector<vector<double>>(1, query))[0]);
+        }
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / max<size_t>(1, queries.size());
+
+        const NeighborIndex& index = classifier.neighborIndex();
+        size_t scanned = variant.quantized ? static_cast<const QuantizedIndex&>(index).scannedBytes() : index.memoryBytes();
+        if (!variant.quantized) {
+            reference = predictions;
+            referenceBytes = index.memoryBytes();
+        }
+
+        int correct = 0;
+        int agree = 0;
+        double hits = 0, expected = 0;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            correct += predictions[q].isSpam == heldOutData[q].second;
+            agree += predictions[q].isSpam == reference[q].isSpam;
+            // Recall against the exact distances of the returned neighbors.
+            double cutoff = reference[q].neighborDistances.empty() ? 0.0 : reference[q].neighborDistances.back();
+            for (int neighbor : predictions[q].neighborIndices) {
+                hits += sqrt(DistanceKernels::squaredDistance(queries[q].data(), features[neighbor].data(), queries[q].size())) <= cutoff;
+            }
+            expected += reference[q].neighborIndices.size();
+        }
+        double accuracy = queries.empty() ? 1.0 : static_cast<double>(correct) / queries.size();
+        if (!variant.quantized) {
+            referenceAccuracy = accuracy;
+        }
+
+        cout << left << setw(30) << (variant.quantized ? index.name() : "double (" + index.name() + ")") << setw(12) << index.memoryBytes() << fixed
+             << setw(9) << setprecision(2) << static_cast<double>(referenceBytes) / max<size_t>(1, index.memoryBytes())
+             << setw(12) << scanned
+             << setw(9) << setprecision(2) << static_cast<double>(referenceBytes) / max<size_t>(1, scanned)
+             << setw(10) << setprecision(3) << (expected > 0 ? hits / expected : 1.0)
+             << setw(13) << setprecision(3) << (queries.empty() ? 1.0 : static_cast<double>(agree) / queries.size())
+             << setw(10) << setprecision(4) << accuracy
+             << setw(9) << showpos << setprecision(4) << accuracy - referenceAccuracy << noshowpos
+             << setprecision(2) << micros << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "../code_1/KNNClassifier.h"
+#include "../code_1/FeatureExtractor.h"
+#include "../code_1/EmailReader.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// Compares the approximate LSH backend against the exact scan over a grid of parameters.
+// Usage: run_recall_report [k] [N] [spam.csv] [ham.csv] [test.csv] [holdout]
+// The queries are the test emails and every holdout-th training email (default 5, 0 holds none
+// out); the held-out emails are left out of the index and the feature selection, so no query
+// finds itself. Recall@k counts an approximate neighbor as a hit if it is no farther than the
+// exact k-th neighbor, so ties at the boundary are not counted as misses.
+int main(int argc, char* argv[]) {
+    int k = argc > 1 ? atoi(argv[1]) : 5;
+    int N = argc > 2 ? atoi(argv[2]) : 150;
+    string spamFilePath = argc > 3 ? argv[3] : "../training/spam.csv";
+    string hamFilePath = argc > 4 ? argv[4] : "../training/ham.csv";
+    string testFilePath = argc > 5 ? argv[5] : "../tests/messages.csv";
+    int holdout = argc > 6 ? atoi(argv[6]) : 5;
+
+    if (k <= 0 || N <= 0 || holdout == 1 || holdout < 0) {
+        cerr << "k and N must be positive numbers and holdout 0 or at least 2." << endl;
+        return 1;
+    }
+
+    // Build the training set the same way run_app_1 does, minus the held-out emails, which
+    // join the test emails as queries.
+    EmailReader reader(spamFilePath, hamFilePath, testFilePath);
+    reader.readTrainingEmails();
+    reader.readTestEmails();
+    vector<pair<pair<string, string>, bool>> trainingData;
+    vector<pair<string, string>> queryEmails = reader.getTestData();
+    const vector<pair<pair<string, string>, bool>>& allData = reader.getTrainingData();
+    for (size_t i = 0; i < allData.size(); ++i) {
+        if (holdout > 0 && i % holdout == static_cast<size_t>(holdout) - 1) {
+            queryEmails.push_back(allData[i].first);
+        } else {
+            trainingData.push_back(allData[i]);
+        }
+    }
+
+    FeatureExtractor featureExtractor;
+    ThreadPool pool;
+    vector<string> topFeatures = featureExtractor.extractBalancedTopFeatures(trainingData, N, &pool);
+    vector<vector<double>> features = featureExtractor.extractFeaturesBatch(trainingData, topFeatures, &pool);
+    vector<vector<double>> queries = featureExtractor.extractFeaturesBatch(queryEmails, topFeatures, &pool);
+
+    vector<bool> labels;
+    for (const auto& data : trainingData) {
+        labels.push_back(data.second);
+    }
+
+    // Exact reference results and timing.
+    KNNClassifier exact(k);
+    exact.train(features, labels);
+    auto start = chrono::steady_clock::now();
+    vector<Prediction> reference;
+    for (const auto& query : queries) {
+        reference.push_back(exact.predictBatch(vector<vector<double>>(1, query))[0]);
+    }
+    double exactMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queries.size();
+
+    cout << "Queries: " << queries.size() << ", training emails: " << features.size() << ", k = " << k << ", N = " << N << endl;
+    cout << "Exact scan: " << fixed << setprecision(2) << exactMicros << " us/query, "
+         << exact.neighborIndex().memoryBytes() << " bytes" << endl << endl;
+
+    cout << left << setw(7) << "bands" << setw(6) << "rows" << setw(11) << "recall@k" << setw(13) << "label agree"
+         << setw(13) << "candidates" << setw(10) << "us/query" << setw(9) << "speedup" << "bytes" << endl;
+
+    const int bandGrid[] = { 4, 8, 16, 32, 64 };
+    const int rowGrid[] = { 1, 2, 3, 4 };
+    for (int rows : rowGrid) {
+        for (int bands : bandGrid) {
+            LSHIndex::Parameters parameters(bands, rows);
+            KNNClassifier approximate(k);
+            approximate.setSearchMode(KNNClassifier::LSH);
+            approximate.setLSHParameters(parameters);
+            approximate.train(features, labels);
+            const LSHIndex& lsh = static_cast<const LSHIndex&>(approximate.neighborIndex());
+
+            double hits = 0, expected = 0, candidates = 0;
+            int agree = 0;
+            start = chrono::steady_clock::now();
+            vector<Prediction> results;
+            for (const auto& query : queries) {
+                results.push_back(approximate.predictBatch(vector<vector<double>>(1, query))[0]);
+            }
+            double approxMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / queries.size();
+
+            for (size_t q = 0; q < queries.size(); ++q) {
+                const Prediction& truth = reference[q];
+                double cutoff = truth.neighborDistances.empty() ? 0.0 : truth.neighborDistances.back();
+                for (double distance : results[q].neighborDistances) {
+                    hits += distance <= cutoff;
+                }
+                expected += truth.neighborIndices.size();
+                agree += results[q].isSpam == truth.isSpam;
+                candidates += lsh.candidates(queries[q]).size();
+            }
+
+            cout << left << setw(7) << bands << setw(6) << rows
+                 << setw(11) << setprecision(3) << (expected > 0 ? hits / expected : 1.0)
+                 << setw(13) << setprecision(3) << static_cast<double>(agree) / queries.size()
+                 << setw(13) << setprecision(1) << candidates / queries.size()
+                 << setw(10) << setprecision(2) << approxMicros
+                 << setw(9) << setprecision(2) << exactMicros / approxMicros
+                 << lsh.memoryBytes() << endl;
+        }
+    }
+    return 0;
+}